@@ -0,0 +1,420 @@
+/* stand-in for the closed libviperfx.so
+ *
+ * implements the viperfx_interface vtable with synthetic, deterministic
+ * processing so the wrapper can be exercised and benchmarked without
+ * the real core. nothing here sounds like viperfx.
+ *
+ * while fx processing is switched on, every buffer gets
+ *  - one FIR of VIPERFX_MOCK_TAPS taps (default 32) per enabled module,
+ *    costing taps multiply-adds per sample. half its response is the
+ *    direct sound and half a tail decaying by VIPERFX_MOCK_DECAY (0 to
+ *    1, default 0) per tap; the default is a unit impulse that leaves
+ *    the signal as it is
+ *  - a gain of out_volume percent times VIPERFX_MOCK_GAIN (default 1.0)
+ *  - a delay of VIPERFX_MOCK_DELAY frames (default 0)
+ * with processing off, buffers pass untouched.
+ *
+ * with VIPERFX_MOCK_TRACE set to a file name, every call an instance
+ * receives is appended to that file, one line each, prefixed by the
+ * instance number. refused commands are traced as such.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "viperfx_so.h"
+
+#define MOCK_DRIVER_VERSION 0x2050004
+#define MOCK_DEFAULT_TAPS 32
+#define MOCK_MAX_TAPS 4096
+
+/* the switches that count as a module */
+static const int32_t module_switches[] = {
+  PARAM_HPFX_CONV_PROCESS_ENABLED,
+  PARAM_HPFX_VHE_PROCESS_ENABLED,
+  PARAM_HPFX_VSE_PROCESS_ENABLED,
+  PARAM_HPFX_FIREQ_PROCESS_ENABLED,
+  PARAM_HPFX_COLM_PROCESS_ENABLED,
+  PARAM_HPFX_DIFFSURR_PROCESS_ENABLED,
+  PARAM_HPFX_REVB_PROCESS_ENABLED,
+  PARAM_HPFX_AGC_PROCESS_ENABLED,
+  PARAM_HPFX_VIPERBASS_PROCESS_ENABLED,
+  PARAM_HPFX_VIPERCLARITY_PROCESS_ENABLED,
+  PARAM_HPFX_CURE_PROCESS_ENABLED,
+  PARAM_HPFX_TUBE_PROCESS_ENABLED,
+  PARAM_HPFX_ANALOGX_PROCESS_ENABLED,
+  PARAM_HPFX_FETCOMP_PROCESS_ENABLED,
+};
+
+#define MOCK_MODULES (sizeof(module_switches) / sizeof(module_switches[0]))
+
+typedef struct _mock_fir {
+  /* twice the taps per channel, every sample is written to both halves
+   * so the last taps samples are always contiguous */
+  float * hist[2];
+  size_t pos;
+} mock_fir;
+
+typedef struct _mock_core {
+  viperfx_interface intf;
+  unsigned int id;
+  FILE * trace;
+
+  int32_t sample_rate;
+  int32_t enabled;
+  /* kernel upload in progress, samples announced and received */
+  int32_t kernel_samples;
+  int32_t kernel_received;
+  int32_t volume;
+  int modules[MOCK_MODULES];
+
+  size_t taps;
+  float * coeffs;
+  mock_fir fir[MOCK_MODULES];
+
+  float gain;
+  size_t delay;
+  int16_t * delay_line;
+  size_t delay_pos;
+} mock_core;
+
+static unsigned int next_id = 0;
+
+static double env_double (const char * name, double fallback)
+{
+  const char * value = getenv (name);
+
+  if (value == NULL || *value == '\0')
+    return fallback;
+  return strtod (value, NULL);
+}
+
+static void mock_trace (mock_core * core, const char * fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void mock_trace (mock_core * core, const char * fmt, ...)
+{
+  va_list args;
+
+  if (core->trace == NULL)
+    return;
+  fprintf (core->trace, "%u ", core->id);
+  va_start (args, fmt);
+  vfprintf (core->trace, fmt, args);
+  va_end (args);
+  fputc ('\n', core->trace);
+}
+
+/* a command the mock refuses, traced like the ones it takes */
+static int32_t mock_refuse (mock_core * core, uint32_t cmd_code,
+    uint32_t cmd_size, const int32_t * args)
+{
+  if (args != NULL && cmd_size >= sizeof(int32_t))
+    mock_trace (core, "refused %u %#x size %u", cmd_code, args[0], cmd_size);
+  else
+    mock_trace (core, "refused %u size %u", cmd_code, cmd_size);
+  return -1;
+}
+
+static void mock_clear (mock_core * core)
+{
+  size_t m;
+
+  for (m = 0; m < MOCK_MODULES; m++) {
+    memset (core->fir[m].hist[0], 0, 2 * core->taps * sizeof(float));
+    memset (core->fir[m].hist[1], 0, 2 * core->taps * sizeof(float));
+    core->fir[m].pos = 0;
+  }
+  if (core->delay > 0)
+    memset (core->delay_line, 0, core->delay * 2 * sizeof(int16_t));
+  core->delay_pos = 0;
+}
+
+static int32_t mock_set_samplerate (viperfx_interface * intf,
+    int32_t sample_rate)
+{
+  mock_core * core = (mock_core *) intf;
+
+  mock_trace (core, "samplerate %d", sample_rate);
+  if (sample_rate < 8000)
+    return FALSE;
+  core->sample_rate = sample_rate;
+  return TRUE;
+}
+
+static int32_t mock_set_channels (viperfx_interface * intf, int32_t channels)
+{
+  mock_core * core = (mock_core *) intf;
+
+  mock_trace (core, "channels %d", channels);
+  return channels == 2;
+}
+
+static void mock_reset (viperfx_interface * intf)
+{
+  mock_core * core = (mock_core *) intf;
+
+  mock_trace (core, "reset");
+  mock_clear (core);
+}
+
+static void mock_set_param (mock_core * core, int32_t param, int32_t value)
+{
+  size_t m;
+
+  switch (param) {
+    case PARAM_SET_DOPROCESS_STATUS:
+      core->enabled = (value != 0);
+      return;
+    case PARAM_HPFX_OUTPUT_VOLUME:
+      core->volume = value;
+      return;
+    default:
+      break;
+  }
+  for (m = 0; m < MOCK_MODULES; m++) {
+    if (module_switches[m] == param)
+      core->modules[m] = (value != 0);
+  }
+}
+
+static int32_t mock_command (viperfx_interface * intf,
+    uint32_t cmd_code, uint32_t cmd_size, void * cmd_data,
+    uint32_t * reply_size, void * reply_data)
+{
+  mock_core * core = (mock_core *) intf;
+  int32_t * args = cmd_data;
+  int32_t value;
+  uint32_t i, count;
+
+  if (cmd_data == NULL || cmd_size < sizeof(int32_t))
+    return mock_refuse (core, cmd_code, cmd_size, NULL);
+
+  if (cmd_code == COMMAND_CODE_GET) {
+    switch (args[0]) {
+      case PARAM_GET_DRIVER_VERSION:
+        value = MOCK_DRIVER_VERSION;
+        break;
+      case PARAM_GET_ENABLED:
+        value = core->enabled;
+        break;
+      case PARAM_GET_SAMPLINGRATE:
+        value = core->sample_rate;
+        break;
+      default:
+        return mock_refuse (core, cmd_code, cmd_size, args);
+    }
+    if (reply_data == NULL || reply_size == NULL ||
+        *reply_size < sizeof(int32_t))
+      return mock_refuse (core, cmd_code, cmd_size, args);
+    mock_trace (core, "get %#x = %d", args[0], value);
+    memcpy (reply_data, &value, sizeof(value));
+    *reply_size = sizeof(value);
+    return 0;
+  }
+
+  if (cmd_code != COMMAND_CODE_SET || cmd_size < 2 * sizeof(int32_t))
+    return mock_refuse (core, cmd_code, cmd_size, args);
+
+  // convolver kernel by path: length then the characters
+  if (args[0] == PARAM_HPFX_CONV_UPDATEKERNEL) {
+    if (cmd_size < 3 * sizeof(int32_t) ||
+        (uint32_t) args[2] > cmd_size - 3 * sizeof(int32_t))
+      return mock_refuse (core, cmd_code, cmd_size, args);
+    mock_trace (core, "set %#x \"%.*s\"", args[0], args[2],
+        (const char *) &args[3]);
+    return 0;
+  }
+
+  // convolver kernel by buffer, only checked for consistency
+  if (args[0] == PARAM_HPFX_CONV_SETBUFFER) {
+    if (cmd_size < 4 * sizeof(int32_t) || args[3] < 0 ||
+        (uint32_t) args[3] > (cmd_size - 4 * sizeof(int32_t)) / sizeof(float) ||
+        args[2] != core->kernel_received)
+      return mock_refuse (core, cmd_code, cmd_size, args);
+    // offset and count, the samples would flood the trace
+    mock_trace (core, "set %#x %d %d", args[0], args[2], args[3]);
+    core->kernel_received += args[3];
+    return 0;
+  }
+  if (args[0] == PARAM_HPFX_CONV_PREPAREBUFFER) {
+    if (cmd_size < 4 * sizeof(int32_t) || args[2] < 0)
+      return mock_refuse (core, cmd_code, cmd_size, args);
+    core->kernel_samples = args[2];
+    core->kernel_received = 0;
+    mock_trace (core, "set %#x %d %d", args[0], args[2], args[3]);
+    return 0;
+  }
+  if (args[0] == PARAM_HPFX_CONV_COMMITBUFFER) {
+    if (cmd_size < 5 * sizeof(int32_t) || args[2] != core->kernel_samples ||
+        core->kernel_received != core->kernel_samples)
+      return mock_refuse (core, cmd_code, cmd_size, args);
+    mock_trace (core, "set %#x %d %d %#x", args[0], args[2], args[3],
+        (uint32_t) args[4]);
+    return 0;
+  }
+
+  count = (uint32_t) args[1] / sizeof(int32_t);
+  if (count == 0 || cmd_size < (2 + count) * sizeof(int32_t))
+    return mock_refuse (core, cmd_code, cmd_size, args);
+
+  if (core->trace != NULL) {
+    fprintf (core->trace, "%u set %#x", core->id, args[0]);
+    for (i = 0; i < count; i++)
+      fprintf (core->trace, " %d", args[2 + i]);
+    fputc ('\n', core->trace);
+  }
+  mock_set_param (core, args[0], args[2]);
+  return 0;
+}
+
+static void mock_fir_run (mock_core * core, mock_fir * fir,
+    int16_t * pcm, int32_t frames)
+{
+  const size_t taps = core->taps;
+  int32_t i;
+  size_t ch, k;
+
+  for (i = 0; i < frames; i++) {
+    for (ch = 0; ch < 2; ch++) {
+      float * hist = fir->hist[ch];
+      float acc = 0.0f;
+
+      hist[fir->pos] = hist[fir->pos + taps] = pcm[2 * i + ch];
+      for (k = 0; k < taps; k++)
+        acc += core->coeffs[k] * hist[fir->pos + taps - k];
+      pcm[2 * i + ch] = (int16_t) lrintf (acc);
+    }
+    fir->pos = (fir->pos + 1) % taps;
+  }
+}
+
+static void mock_process (viperfx_interface * intf,
+    int16_t * pcm_buffer, int32_t frame_count)
+{
+  mock_core * core = (mock_core *) intf;
+  float gain = core->gain * core->volume / 100.0f;
+  int32_t i;
+  size_t m;
+
+  if (core->trace != NULL)
+    mock_trace (core, "process %d", frame_count);
+  if (!core->enabled || pcm_buffer == NULL || frame_count <= 0)
+    return;
+
+  for (m = 0; m < MOCK_MODULES; m++) {
+    if (core->modules[m])
+      mock_fir_run (core, &core->fir[m], pcm_buffer, frame_count);
+  }
+
+  for (i = 0; i < frame_count * 2; i++) {
+    float v = pcm_buffer[i] * gain;
+    v = (v > -32768.0f) ? v : -32768.0f;
+    v = (v < 32767.0f) ? v : 32767.0f;
+    pcm_buffer[i] = (int16_t) lrintf (v);
+  }
+
+  if (core->delay > 0) {
+    for (i = 0; i < frame_count; i++) {
+      int16_t * slot = core->delay_line + core->delay_pos * 2;
+      int16_t l = slot[0], r = slot[1];
+
+      slot[0] = pcm_buffer[2 * i];
+      slot[1] = pcm_buffer[2 * i + 1];
+      pcm_buffer[2 * i] = l;
+      pcm_buffer[2 * i + 1] = r;
+      core->delay_pos = (core->delay_pos + 1) % core->delay;
+    }
+  }
+}
+
+static void mock_release (viperfx_interface * intf)
+{
+  mock_core * core = (mock_core *) intf;
+  size_t m;
+
+  mock_trace (core, "release");
+  if (core->trace != NULL)
+    fclose (core->trace);
+  for (m = 0; m < MOCK_MODULES; m++) {
+    free (core->fir[m].hist[0]);
+    free (core->fir[m].hist[1]);
+  }
+  free (core->coeffs);
+  free (core->delay_line);
+  free (core);
+}
+
+viperfx_interface * viperfx_create_instance (void)
+{
+  mock_core * core;
+  const char * trace;
+  double taps, decay, sum, coeff;
+  size_t m, k;
+  int ok = TRUE;
+
+  core = calloc (1, sizeof(*core));
+  if (core == NULL)
+    return NULL;
+
+  core->intf.set_samplerate = mock_set_samplerate;
+  core->intf.set_channels = mock_set_channels;
+  core->intf.reset = mock_reset;
+  core->intf.command = mock_command;
+  core->intf.process = mock_process;
+  core->intf.release = mock_release;
+  core->intf.private_data = core;
+
+  core->id = __atomic_fetch_add (&next_id, 1, __ATOMIC_RELAXED);
+  core->sample_rate = 44100;
+  core->volume = 100;
+  core->gain = (float) env_double ("VIPERFX_MOCK_GAIN", 1.0);
+  core->delay = (size_t) env_double ("VIPERFX_MOCK_DELAY", 0.0);
+  taps = env_double ("VIPERFX_MOCK_TAPS", MOCK_DEFAULT_TAPS);
+  core->taps = (taps < 1.0) ? 1 : (taps > MOCK_MAX_TAPS) ? MOCK_MAX_TAPS :
+      (size_t) taps;
+
+  trace = getenv ("VIPERFX_MOCK_TRACE");
+  if (trace != NULL && *trace != '\0') {
+    core->trace = fopen (trace, "a");
+    if (core->trace != NULL)
+      setvbuf (core->trace, NULL, _IOLBF, 0);
+  }
+
+  core->coeffs = calloc (core->taps, sizeof(float));
+  ok = (core->coeffs != NULL);
+  for (m = 0; ok && m < MOCK_MODULES; m++) {
+    core->fir[m].hist[0] = malloc (2 * core->taps * sizeof(float));
+    core->fir[m].hist[1] = malloc (2 * core->taps * sizeof(float));
+    ok = (core->fir[m].hist[0] != NULL && core->fir[m].hist[1] != NULL);
+  }
+  if (ok && core->delay > 0) {
+    core->delay_line = malloc (core->delay * 2 * sizeof(int16_t));
+    ok = (core->delay_line != NULL);
+  }
+  if (!ok) {
+    mock_release (&core->intf);
+    return NULL;
+  }
+
+  // decay 0 is a unit impulse, the taps cost time but don't change the
+  // signal. otherwise half of it goes straight through and half into a
+  // tail the segments of a render have to rebuild
+  decay = env_double ("VIPERFX_MOCK_DECAY", 0.0);
+  decay = (decay < 0.0) ? 0.0 : (decay > 0.9999) ? 0.9999 : decay;
+  core->coeffs[0] = 1.0f;
+  if (decay > 0.0 && core->taps > 1) {
+    sum = 0.0;
+    for (k = 1, coeff = decay; k < core->taps; k++, coeff *= decay)
+      sum += coeff;
+    core->coeffs[0] = 0.5f;
+    for (k = 1, coeff = decay; k < core->taps; k++, coeff *= decay)
+      core->coeffs[k] = (float) (0.5 * coeff / sum);
+  }
+  mock_clear (core);
+  mock_trace (core, "create");
+  return &core->intf;
+}
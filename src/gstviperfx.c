@@ -13,6 +13,7 @@
 #define VERSION "1.0.0"
 
 #include <string.h>
+#include <math.h>
 #include <gst/gst.h>
 #include <gst/base/base.h>
 #include <gst/base/gstbasetransform.h>
@@ -21,6 +22,15 @@
 #include <gst/controller/controller.h>
 
 #include "gstviperfx.h"
+#include "viperfx_cmdq.h"
+#include "viperfx_params.h"
+#include "viperfx_kernels.h"
+#include "viperfx_resample.h"
+#include "viperfx_corepool.h"
+#include "viperfx_stats.h"
+#include "viperfx_rt.h"
+#include "gstviperfxtracer.h"
+#include "gstviperfxpool.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_viperfx_debug);
 #define GST_CAT_DEFAULT gst_viperfx_debug
@@ -36,113 +46,151 @@ enum
 {
   PROP_0,
 
-  /* global enable */
-  PROP_FX_ENABLE,
-  /* convolver */
-  PROP_CONV_ENABLE,
+  /* convolver impulse response */
   PROP_CONV_IR_PATH,
-  PROP_CONV_CC_LEVEL,
-  /* vhe */
-  PROP_VHE_ENABLE,
-  PROP_VHE_LEVEL,
-  /* vse */
-  PROP_VSE_ENABLE,
-  PROP_VSE_REF_BARK,
-  PROP_VSE_BARK_CONS,
-  /* equalizer */
-  PROP_EQ_ENABLE,
-  PROP_EQ_BAND1,
-  PROP_EQ_BAND2,
-  PROP_EQ_BAND3,
-  PROP_EQ_BAND4,
-  PROP_EQ_BAND5,
-  PROP_EQ_BAND6,
-  PROP_EQ_BAND7,
-  PROP_EQ_BAND8,
-  PROP_EQ_BAND9,
-  PROP_EQ_BAND10,
-  /* colorful music */
-  PROP_COLM_ENABLE,
-  PROP_COLM_WIDENING,
-  PROP_COLM_MIDIMAGE,
-  PROP_COLM_DEPTH,
-  /* diff sur */
-  PROP_DS_ENABLE,
-  PROP_DS_LEVEL,
-  /* reverb */
-  PROP_REVERB_ENABLE,
-  PROP_REVERB_ROOMSIZE,
-  PROP_REVERB_WIDTH,
-  PROP_REVERB_DAMP,
-  PROP_REVERB_WET,
-  PROP_REVERB_DRY,
-  /* agc */
-  PROP_AGC_ENABLE,
-  PROP_AGC_RATIO,
-  PROP_AGC_VOLUME,
-  PROP_AGC_MAXGAIN,
-  /* viper bass */
-  PROP_VB_ENABLE,
-  PROP_VB_MODE,
-  PROP_VB_FREQ,
-  PROP_VB_GAIN,
-  /* viper clarity */
-  PROP_VC_ENABLE,
-  PROP_VC_MODE,
-  PROP_VC_LEVEL,
-  /* cure */
-  PROP_CURE_ENABLE,
-  PROP_CURE_LEVEL,
-  /* tube */
-  PROP_TUBE_ENABLE,
-  /* analog-x */
-  PROP_AX_ENABLE,
-  PROP_AX_MODE,
-  /* fet compressor */
-  PROP_FETCOMP_ENABLE,
-  PROP_FETCOMP_THRESHOLD,
-  PROP_FETCOMP_RATIO,
-  PROP_FETCOMP_KNEEWIDTH,
-  PROP_FETCOMP_AUTOKNEE,
-  PROP_FETCOMP_GAIN,
-  PROP_FETCOMP_AUTOGAIN,
-  PROP_FETCOMP_ATTACK,
-  PROP_FETCOMP_AUTOATTACK,
-  PROP_FETCOMP_RELEASE,
-  PROP_FETCOMP_AUTORELEASE,
-  PROP_FETCOMP_META_KNEEMULTI,
-  PROP_FETCOMP_META_MAXATTACK,
-  PROP_FETCOMP_META_MAXRELEASE,
-  PROP_FETCOMP_META_CREST,
-  PROP_FETCOMP_META_ADAPT,
-  PROP_FETCOMP_NOCLIP,
-  /* output volume */
-  PROP_OUT_VOLUME,
-  /* output pan */
-  PROP_OUT_PAN,
-  /* limiter */
-  PROP_LIM_THRESHOLD
+  PROP_CONV_IR_DATA,
+  PROP_PRESET,
+  /* low rate streams */
+  PROP_RESAMPLE,
+  /* fixed size core calls */
+  PROP_BLOCK_SIZE,
+  /* deadline monitor */
+  PROP_LOAD_WARNING,
+  PROP_LOAD_CRITICAL,
+  PROP_REPORT_OVERRUNS,
+  PROP_LOAD,
+  /* shadow instance transitions */
+  PROP_CROSSFADE,
+  /* automation */
+  PROP_CONTROL_INTERVAL,
+  /* silence */
+  PROP_SILENCE_SKIP,
+  PROP_SILENCE_THRESHOLD,
+  /* realtime profile */
+  PROP_REALTIME_PROFILE,
+  PROP_REALTIME_PRIORITY,
+  PROP_REALTIME_CPU,
+  /* table driven fx parameters, see viperfx_params.c */
+  PROP_PARAM_FIRST,
+  PROP_PARAM_LAST = PROP_PARAM_FIRST + VIPERFX_PARAM_COUNT - 1
+};
+
+/* pending commands between the control threads and the streaming thread */
+#define COMMAND_QUEUE_SIZE 256
+
+/* how conv_ir_data shows up where a path would, in ir_loaded and on the bus */
+#define IR_DATA_PREFIX "sha256:"
+
+/* frames of conversion scratch allocated up front for non-s16 formats */
+#define DEFAULT_SCRATCH_FRAMES 4096
+/* buffers of the pools the element makes hold at least this much audio,
+ * and DEFAULT_SCRATCH_FRAMES */
+#define POOL_BUFFER_TIME (GST_SECOND / 10)
+
+/* lowest rate the core runs at, slower streams are resampled up to a
+ * whole multiple of their rate */
+#define CORE_MIN_RATE 44100
+
+/* largest fixed core call, one resampler round per block */
+#define MAX_BLOCK_SIZE VIPERFX_RESAMPLE_MAX_FRAMES
+
+/* rolling load time constant, in audio time */
+#define LOAD_TIME_CONSTANT (GST_SECOND / 2)
+/* load has to drop this far below a threshold to clear it, percent */
+#define LOAD_HYSTERESIS 5
+/* overruns in between are counted into the next message */
+#define OVERRUN_MESSAGE_INTERVAL GST_SECOND
+
+enum
+{
+  LOAD_LEVEL_NORMAL = 0,
+  LOAD_LEVEL_WARNING,
+  LOAD_LEVEL_CRITICAL
+};
+
+/* longest transition, ms */
+#define MAX_CROSSFADE 1000
+/* longest control interval, frames */
+#define MAX_CONTROL_INTERVAL 65536
+/* bindings added or removed while streaming are picked up this often */
+#define CONTROL_REFRESH (GST_SECOND / 10)
+
+/* silent input keeps the cores running until their output has stayed
+ * below silence_threshold this long, plus the element's own delay */
+#define SILENCE_HOLD (GST_SECOND / 5)
+#define DEFAULT_SILENCE_THRESHOLD -90
+
+/* highest cpu realtime_cpu pins to */
+#define MAX_REALTIME_CPU 1023
+
+/* steps of the realtime profile, each failure is reported once a run */
+enum
+{
+  REALTIME_DENORMALS = 1 << 0,
+  REALTIME_LOCK_LIBRARY = 1 << 1,
+  REALTIME_LOCK_BUFFERS = 1 << 2,
+  REALTIME_PRIORITY = 1 << 3,
+  REALTIME_AFFINITY = 1 << 4,
+  REALTIME_SCHED = 1 << 5
 };
 
+/* core frames the outgoing core runs at a time during a transition */
+#define FADE_CHUNK 1024
+/* frames between exact equal-power gains, linear in between */
+#define FADE_SEGMENT 64
+
+/* below this the worker wakeup costs more than running pairs in turn */
+#define PARALLEL_MIN_FRAMES 128
+
 #define ALLOWED_CAPS \
   "audio/x-raw,"                            \
-  " format=(string){"GST_AUDIO_NE(S16)"},"  \
-  " rate=(int)[44100,MAX],"                 \
-  " channels=(int)2,"                       \
+  " format=(string){"GST_AUDIO_NE(S16)","   \
+                   GST_AUDIO_NE(S32)","   \
+                   GST_AUDIO_NE(F32)"},"  \
+  " rate=(int)[8000,MAX],"                 \
+  " channels=(int)[2,64],"                       \
   " layout=(string)interleaved"
 
 #define gst_viperfx_parent_class parent_class
 G_DEFINE_TYPE (Gstviperfx, gst_viperfx, GST_TYPE_AUDIO_FILTER);
 
+/* parameters that wait for a shadow instance when crossfade is on */
+static guint crossfade_hold[VIPERFX_PARAM_DIRTY_WORDS];
+
 static void gst_viperfx_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_viperfx_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static void gst_viperfx_finalize (GObject * object);
-
+static void gst_viperfx_discard_commands (Gstviperfx *self);
+static void gst_viperfx_free_ir_set (GstviperfxIrSet *set);
+static void gst_viperfx_ir_loader (gpointer data, gpointer user_data);
+static void gst_viperfx_end_fade (Gstviperfx *self);
+static void gst_viperfx_clear_bindings (Gstviperfx *self);
+static void gst_viperfx_realtime_unlock_buffers (Gstviperfx *self);
+
+static GstStateChangeReturn gst_viperfx_change_state (GstElement * element,
+    GstStateChange transition);
 static gboolean gst_viperfx_setup (GstAudioFilter * self,
     const GstAudioInfo * info);
 static gboolean gst_viperfx_stop (GstBaseTransform * base);
+static GstFlowReturn gst_viperfx_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+static gboolean gst_viperfx_sink_event (GstBaseTransform * base,
+    GstEvent * event);
+static GstCaps *gst_viperfx_transform_caps (GstBaseTransform * base,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter);
+static void gst_viperfx_clear_out_pool (Gstviperfx *self);
+static gboolean gst_viperfx_process (Gstviperfx *self, const guint8 *in,
+    guint8 *data, guint num_frames);
+static gboolean gst_viperfx_propose_allocation (GstBaseTransform * base,
+    GstQuery * decide_query, GstQuery * query);
+static GstFlowReturn gst_viperfx_prepare_output_buffer (GstBaseTransform * base,
+    GstBuffer * inbuf, GstBuffer ** outbuf);
+static gboolean gst_viperfx_query (GstBaseTransform * base,
+    GstPadDirection direction, GstQuery * query);
+static void gst_viperfx_before_transform (GstBaseTransform * base,
+    GstBuffer * buf);
 static GstFlowReturn gst_viperfx_transform_ip (GstBaseTransform * base,
     GstBuffer * outbuf);
 
@@ -166,245 +214,95 @@ gst_viperfx_class_init (GstviperfxClass * klass)
   gobject_class->get_property = gst_viperfx_get_property;
   gobject_class->finalize = gst_viperfx_finalize;
 
-  /* global switch */
-  g_object_class_install_property (gobject_class, PROP_FX_ENABLE,
-      g_param_spec_boolean ("fx_enable", "FXEnabled", "Enable viperfx processing",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
   /* convolver */
-  g_object_class_install_property (gobject_class, PROP_CONV_ENABLE,
-      g_param_spec_boolean ("conv_enable", "ConvEnabled", "Enable convolver",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
   g_object_class_install_property (gobject_class, PROP_CONV_IR_PATH,
       g_param_spec_string ("conv_ir_path", "ConvIRPath", "Impulse response file path",
-          "", G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_CONV_CC_LEVEL,
-      g_param_spec_int ("conv_cc_level", "ConvEnabled", "Cross-channel level (percent)",
-          0, 100, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* vhe */
-  g_object_class_install_property (gobject_class, PROP_VHE_ENABLE,
-      g_param_spec_boolean ("vhe_enable", "VHEEnabled", "Enable viper headphone engine",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VHE_LEVEL,
-      g_param_spec_int ("vhe_level", "VHELevel", "VHE level",
-          0, 4, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* vse */
-  g_object_class_install_property (gobject_class, PROP_VSE_ENABLE,
-      g_param_spec_boolean ("vse_enable", "VSEEnabled", "Enable viper spectrum extend",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VSE_REF_BARK,
-      g_param_spec_int ("vse_ref_bark", "VSERefBark", "VSE reference bark frequency",
-          800, 20000, 7600, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VSE_BARK_CONS,
-      g_param_spec_int ("vse_bark_cons", "VSEBarkCons", "VSE bark reconstruct level",
-          10, 100, 10, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* equalizer */
-  g_object_class_install_property (gobject_class, PROP_EQ_ENABLE,
-      g_param_spec_boolean ("eq_enable", "EQEnable", "Enable FIR linear equalizer",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND1,
-      g_param_spec_int ("eq_band1", "EQBand1", "Gain of eq band 1",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND2,
-      g_param_spec_int ("eq_band2", "EQBand2", "Gain of eq band 2",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND3,
-      g_param_spec_int ("eq_band3", "EQBand3", "Gain of eq band 3",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND4,
-      g_param_spec_int ("eq_band4", "EQBand4", "Gain of eq band 4",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND5,
-      g_param_spec_int ("eq_band5", "EQBand5", "Gain of eq band 5",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND6,
-      g_param_spec_int ("eq_band6", "EQBand6", "Gain of eq band 6",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND7,
-      g_param_spec_int ("eq_band7", "EQBand7", "Gain of eq band 7",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND8,
-      g_param_spec_int ("eq_band8", "EQBand8", "Gain of eq band 8",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND9,
-      g_param_spec_int ("eq_band9", "EQBand9", "Gain of eq band 9",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_EQ_BAND10,
-      g_param_spec_int ("eq_band10", "EQBand10", "Gain of eq band 10",
-          -1200, 1200, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* colorful music */
-  g_object_class_install_property (gobject_class, PROP_COLM_ENABLE,
-      g_param_spec_boolean ("colm_enable", "COLMEnabled", "Enable colorful music",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_COLM_WIDENING,
-      g_param_spec_int ("colm_widening", "COLMWidening", "Widening of colorful music",
-          0, 800, 100, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_COLM_MIDIMAGE,
-      g_param_spec_int ("colm_midimage", "COLMMidImage", "Mid-image of colorful music",
-          0, 800, 100, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_COLM_DEPTH,
-      g_param_spec_int ("colm_depth", "COLMDepth", "Depth of colorful music",
-          0, 32767, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* diff sur */
-  g_object_class_install_property (gobject_class, PROP_DS_ENABLE,
-      g_param_spec_boolean ("ds_enable", "DSEnabled", "Enable diff-surround",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_DS_LEVEL,
-      g_param_spec_int ("ds_level", "DSLevel", "Diff-surround level (percent)",
-          0, 100, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* reverb */
-  g_object_class_install_property (gobject_class, PROP_REVERB_ENABLE,
-      g_param_spec_boolean ("reverb_enable", "ReverbEnabled", "Enable reverb",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_REVERB_ROOMSIZE,
-      g_param_spec_int ("reverb_roomsize", "ReverbRoomSize", "Reverb room size (percent)",
-          1, 100, 30, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_REVERB_WIDTH,
-      g_param_spec_int ("reverb_width", "ReverbWidth", "Reveb room width (percent)",
-          1, 100, 40, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_REVERB_DAMP,
-      g_param_spec_int ("reverb_damp", "ReverbDamp", "Reverb room damp (percent)",
-          1, 100, 10, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_REVERB_WET,
-      g_param_spec_int ("reverb_wet", "ReverbWet", "Reverb wet signal (percent)",
-          1, 100, 20, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_REVERB_DRY,
-      g_param_spec_int ("reverb_dry", "ReverbDry", "Reverb dry signal (percent)",
-          1, 100, 80, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* agc */
-  g_object_class_install_property (gobject_class, PROP_AGC_ENABLE,
-      g_param_spec_boolean ("agc_enable", "AGCEnabled", "Enable auto gain control",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_AGC_RATIO,
-      g_param_spec_int ("agc_ratio", "AGCRatio", "Working ratio of agc",
-          50, 500, 100, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_AGC_VOLUME,
-      g_param_spec_int ("agc_volume", "AGCVolume", "Max volume of agc",
-          0, 200, 100, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_AGC_MAXGAIN,
-      g_param_spec_int ("agc_maxgain", "AGCMaxGain", "Max gain of agc",
-          100, 800, 100, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* viper bass */
-  g_object_class_install_property (gobject_class, PROP_VB_ENABLE,
-      g_param_spec_boolean ("vb_enable", "VBEnabled", "Enable viper bass",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VB_MODE,
-      g_param_spec_int ("vb_mode", "VBMode", "ViPER bass mode",
-          0, 2, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VB_FREQ,
-      g_param_spec_int ("vb_freq", "VBFreq", "ViPER bass frequency",
-          50, 160, 76, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VB_GAIN,
-      g_param_spec_int ("vb_gain", "VBGain", "ViPER bass gain",
-          0, 800, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* viper clarity */
-  g_object_class_install_property (gobject_class, PROP_VC_ENABLE,
-      g_param_spec_boolean ("vc_enable", "VCEnabled", "Enable viper clarity",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VC_MODE,
-      g_param_spec_int ("vc_mode", "VCMode", "ViPER clarity mode",
-          0, 2, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_VC_LEVEL,
-      g_param_spec_int ("vc_level", "VCLevel", "ViPER clarity level",
-          0, 800, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* cure */
-  g_object_class_install_property (gobject_class, PROP_CURE_ENABLE,
-      g_param_spec_boolean ("cure_enable", "CureEnabled", "Enable viper cure+",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_CURE_LEVEL,
-      g_param_spec_int ("cure_level", "CureLevel", "ViPER cure+ level",
-          0, 2, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* tube */
-  g_object_class_install_property (gobject_class, PROP_TUBE_ENABLE,
-      g_param_spec_boolean ("tube_enable", "TubeEnabled", "Enable tube simiulator",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* analog-x */
-  g_object_class_install_property (gobject_class, PROP_AX_ENABLE,
-      g_param_spec_boolean ("ax_enable", "AXEnabled", "Enable viper analog-x",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_AX_MODE,
-      g_param_spec_int ("ax_mode", "AXMode", "ViPER analog-x mode",
-          0, 2, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* fet compressor */
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_ENABLE,
-      g_param_spec_boolean ("fetcomp_enable", "FETCompEnabled", "Enable fet compressor",
-          FALSE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_THRESHOLD,
-      g_param_spec_int ("fetcomp_threshold", "FETCompThreshold", "Compressor threshold (percent)",
-          0, 100, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_RATIO,
-      g_param_spec_int ("fetcomp_ratio", "FETCompRatio", "Compressor ratio (percent)",
-          0, 100, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_KNEEWIDTH,
-      g_param_spec_int ("fetcomp_kneewidth", "FETCompKneeWidth", "Compressor knee width (percent)",
-          0, 100, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_AUTOKNEE,
-      g_param_spec_boolean ("fetcomp_autoknee", "FETCompAutoKnee", "Compressor auto knee control",
-          TRUE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_GAIN,
-      g_param_spec_int ("fetcomp_gain", "FETCompGain", "Compressor makeup gain (percent)",
-          0, 100, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_AUTOGAIN,
-      g_param_spec_boolean ("fetcomp_autogain", "FETCompAutoGain", "Compressor auto gain control",
-          TRUE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_ATTACK,
-      g_param_spec_int ("fetcomp_attack", "FETCompAttack", "Compressor attack time (percent)",
-          0, 100, 51, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_AUTOATTACK,
-      g_param_spec_boolean ("fetcomp_autoattack", "FETCompAutoAttack", "Compressor auto attack control",
-          TRUE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_RELEASE,
-      g_param_spec_int ("fetcomp_release", "FETCompRelease", "Compressor release time (percent)",
-          0, 100, 38, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_AUTORELEASE,
-      g_param_spec_boolean ("fetcomp_autorelease", "FETCompAutoRelease", "Compressor auto release control",
-          TRUE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_META_KNEEMULTI,
-      g_param_spec_int ("fetcomp_meta_kneemulti", "FETCompKneeMulti", "Compressor knee width multi in auto mode (percent)",
-          0, 100, 50, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_META_MAXATTACK,
-      g_param_spec_int ("fetcomp_meta_maxattack", "FETCompMaxAttack", "Compressor max attack in auto mode (percent)",
-          0, 100, 88, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_META_MAXRELEASE,
-      g_param_spec_int ("fetcomp_meta_maxrelease", "FETCompMaxRelease", "Compressor max release in auto mode (percent)",
-          0, 100, 88, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_META_CREST,
-      g_param_spec_int ("fetcomp_meta_crest", "FETCompCrest", "Compressor crest in auto mode (percent)",
-          0, 100, 61, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_META_ADAPT,
-      g_param_spec_int ("fetcomp_meta_adapt", "FETCompAdapt", "Compressor adapt in auto mode (percent)",
-          0, 100, 66, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-  g_object_class_install_property (gobject_class, PROP_FETCOMP_NOCLIP,
-      g_param_spec_boolean ("fetcomp_noclip", "FETCompNoClip", "Compressor prevent clipping",
-          TRUE, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* output volume */
-  g_object_class_install_property (gobject_class, PROP_OUT_VOLUME,
-      g_param_spec_int ("out_volume", "OutVolume", "Master output volume (percent)",
-          0, 100, 100, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* output pan */
-  g_object_class_install_property (gobject_class, PROP_OUT_PAN,
-      g_param_spec_int ("out_pan", "OutPan", "Master output pan",
-          -100, 100, 0, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
-
-  /* limiter */
-  g_object_class_install_property (gobject_class, PROP_LIM_THRESHOLD,
-      g_param_spec_int ("lim_threshold", "LimThreshold", "Master limiter threshold (percent)",
-          1, 100, 100, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE));
+          "", G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_CONV_IR_DATA,
+      g_param_spec_boxed ("conv_ir_data", "ConvIRData",
+          "Impulse response file contents (RIFF/WAVE), instead of a path",
+          G_TYPE_BYTES, G_PARAM_WRITABLE));
+
+  /* presets */
+  g_object_class_install_property (gobject_class, PROP_PRESET,
+      g_param_spec_string ("preset", "Preset",
+          "Keyfile with a whole parameter set, applied between two buffers",
+          "", G_PARAM_WRITABLE));
+
+  /* resampling */
+  g_object_class_install_property (gobject_class, PROP_RESAMPLE,
+      g_param_spec_boolean ("resample", "Resample",
+          "Resample streams below 44.1 kHz around the core, refuse them otherwise",
+          TRUE, G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_BLOCK_SIZE,
+      g_param_spec_uint ("block_size", "BlockSize",
+          "Frames per core call, adds as much latency (0 = buffer size)",
+          0, MAX_BLOCK_SIZE, 0, G_PARAM_WRITABLE));
+
+  /* deadline monitor */
+  g_object_class_install_property (gobject_class, PROP_LOAD_WARNING,
+      g_param_spec_uint ("load_warning", "LoadWarning",
+          "Rolling load posting a viperfx-load warning (percent, 0 = off)",
+          0, 1000, 80, G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_LOAD_CRITICAL,
+      g_param_spec_uint ("load_critical", "LoadCritical",
+          "Rolling load posting a viperfx-load critical (percent, 0 = off)",
+          0, 1000, 95, G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_REPORT_OVERRUNS,
+      g_param_spec_boolean ("report_overruns", "ReportOverruns",
+          "Post viperfx-overrun when a buffer takes longer than it plays",
+          TRUE, G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_LOAD,
+      g_param_spec_double ("load", "Load",
+          "Rolling processing time over audio time (percent)",
+          0.0, G_MAXDOUBLE, 0.0, G_PARAM_READABLE));
+
+  /* transitions */
+  g_object_class_install_property (gobject_class, PROP_CROSSFADE,
+      g_param_spec_uint ("crossfade", "Crossfade",
+          "Fade module switches and presets over from a second core "
+          "instance (ms, 0 = switch in place)",
+          0, MAX_CROSSFADE, 0, G_PARAM_WRITABLE));
+
+  /* automation */
+  g_object_class_install_property (gobject_class, PROP_CONTROL_INTERVAL,
+      g_param_spec_uint ("control_interval", "ControlInterval",
+          "Frames between samples of controlled parameters, buffers are "
+          "split at them (0 = once per buffer)",
+          0, MAX_CONTROL_INTERVAL, 0, G_PARAM_WRITABLE));
+
+  /* silence */
+  g_object_class_install_property (gobject_class, PROP_SILENCE_SKIP,
+      g_param_spec_boolean ("silence_skip", "SilenceSkip",
+          "Stop calling the core on silent input once its tails have "
+          "decayed, and output gap buffers until audio returns",
+          FALSE, G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_SILENCE_THRESHOLD,
+      g_param_spec_int ("silence_threshold", "SilenceThreshold",
+          "Output peak below which a tail counts as decayed (dBFS)",
+          -96, 0, DEFAULT_SILENCE_THRESHOLD, G_PARAM_WRITABLE));
+
+  /* realtime profile */
+  g_object_class_install_property (gobject_class, PROP_REALTIME_PROFILE,
+      g_param_spec_boolean ("realtime_profile", "RealtimeProfile",
+          "Flush denormals around the core, lock the core library and the "
+          "working buffers in memory and apply realtime_priority and "
+          "realtime_cpu to the streaming thread, from PLAYING on",
+          FALSE, G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_REALTIME_PRIORITY,
+      g_param_spec_int ("realtime_priority", "RealtimePriority",
+          "SCHED_FIFO priority of the streaming thread with realtime_profile "
+          "(0 = leave the scheduling alone)",
+          0, 99, 0, G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_REALTIME_CPU,
+      g_param_spec_int ("realtime_cpu", "RealtimeCpu",
+          "CPU the streaming thread is pinned to with realtime_profile "
+          "(-1 = any)",
+          -1, MAX_REALTIME_CPU, -1, G_PARAM_WRITABLE));
+
+  /* all scalar fx parameters */
+  viperfx_params_install_properties (gobject_class, PROP_PARAM_FIRST);
+  viperfx_param_crossfade_mask (crossfade_hold);
 
   gst_element_class_set_static_metadata (gstelement_class,
     "viperfx",
@@ -416,176 +314,32 @@ gst_viperfx_class_init (GstviperfxClass * klass)
   gst_audio_filter_class_add_pad_templates (GST_VIPERFX_CLASS (klass), caps);
   gst_caps_unref (caps);
 
+  gstelement_class->change_state =
+    GST_DEBUG_FUNCPTR (gst_viperfx_change_state);
   audioself_class->setup = GST_DEBUG_FUNCPTR (gst_viperfx_setup);
   basetransform_class->transform_ip =
     GST_DEBUG_FUNCPTR (gst_viperfx_transform_ip);
+  basetransform_class->before_transform =
+    GST_DEBUG_FUNCPTR (gst_viperfx_before_transform);
+  // bypassed buffers are neither mapped nor made writable
   basetransform_class->transform_ip_on_passthrough = FALSE;
   basetransform_class->stop = GST_DEBUG_FUNCPTR (gst_viperfx_stop);
+  basetransform_class->sink_event = GST_DEBUG_FUNCPTR (gst_viperfx_sink_event);
+  basetransform_class->transform_caps =
+    GST_DEBUG_FUNCPTR (gst_viperfx_transform_caps);
+  basetransform_class->query = GST_DEBUG_FUNCPTR (gst_viperfx_query);
+  basetransform_class->propose_allocation =
+    GST_DEBUG_FUNCPTR (gst_viperfx_propose_allocation);
+  basetransform_class->prepare_output_buffer =
+    GST_DEBUG_FUNCPTR (gst_viperfx_prepare_output_buffer);
 }
 
-/* sync all parameters to fx core
-*/
-static void sync_all_parameters (Gstviperfx *self)
-{
-  int32_t idx;
-
-  // convolver
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_CONV_CROSSCHANNEL, self->conv_cc_level);
-  viperfx_command_set_ir_path (self->vfx, self->conv_ir_path);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_CONV_PROCESS_ENABLED, self->conv_enabled);
-
-  // vhe
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VHE_EFFECT_LEVEL, self->vhe_level);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VHE_PROCESS_ENABLED, self->vhe_enabled);
-
-  // vse
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VSE_REFERENCE_BARK, self->vse_ref_bark);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VSE_BARK_RECONSTRUCT, self->vse_bark_cons);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VSE_PROCESS_ENABLED, self->vse_enabled);
-
-  // equalizer
-  for (idx = 0; idx < 10; idx++) {
-    viperfx_command_set_px4_vx4x2 (self->vfx,
-        PARAM_HPFX_FIREQ_BANDLEVEL, idx, self->eq_band_level[idx]);
-  }
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FIREQ_PROCESS_ENABLED, self->eq_enabled);
-
-  // colorful music
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_COLM_WIDENING, self->colm_widening);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_COLM_MIDIMAGE, self->colm_midimage);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_COLM_DEPTH, self->colm_depth);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_COLM_PROCESS_ENABLED, self->colm_enabled);
-
-  // diff surr
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_DIFFSURR_DELAYTIME, self->ds_level);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_DIFFSURR_PROCESS_ENABLED, self->ds_enabled);
-
-  // reverb
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_REVB_ROOMSIZE, self->reverb_roomsize);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_REVB_WIDTH, self->reverb_width);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_REVB_DAMP, self->reverb_damp);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_REVB_WET, self->reverb_wet);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_REVB_DRY, self->reverb_dry);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_REVB_PROCESS_ENABLED, self->reverb_enabled);
-
-  // agc
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_AGC_RATIO, self->agc_ratio);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_AGC_VOLUME, self->agc_volume);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_AGC_MAXSCALER, self->agc_maxgain);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_AGC_PROCESS_ENABLED, self->agc_enabled);
-
-  // viper bass
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VIPERBASS_MODE, self->vb_mode);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VIPERBASS_SPEAKER, self->vb_freq);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VIPERBASS_BASSGAIN, self->vb_gain);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VIPERBASS_PROCESS_ENABLED, self->vb_enabled);
-
-  // viper clarity
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VIPERCLARITY_MODE, self->vc_mode);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VIPERCLARITY_CLARITY, self->vc_level);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_VIPERCLARITY_PROCESS_ENABLED, self->vc_enabled);
-
-  // cure
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_CURE_CROSSFEED, self->cure_level);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_CURE_PROCESS_ENABLED, self->cure_enabled);
-
-  // tube
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_TUBE_PROCESS_ENABLED, self->tube_enabled);
-
-  // analog-x
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_ANALOGX_MODE, self->ax_mode);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_ANALOGX_PROCESS_ENABLED, self->ax_enabled);
-
-  // fet compressor
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FETCOMP_THRESHOLD, self->fetcomp_threshold);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FETCOMP_RATIO, self->fetcomp_ratio);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FETCOMP_KNEEWIDTH, self->fetcomp_kneewidth);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FETCOMP_AUTOKNEE_ENABLED, self->fetcomp_autoknee);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FETCOMP_GAIN, self->fetcomp_gain);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FETCOMP_AUTOGAIN_ENABLED, self->fetcomp_autogain);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_FETCOMP_ATTACK, self->fetcomp_attack);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_AUTOATTACK_ENABLED, self->fetcomp_autoattack);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_RELEASE, self->fetcomp_release);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_AUTORELEASE_ENABLED, self->fetcomp_autorelease);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_META_KNEEMULTI, self->fetcomp_meta_kneemulti);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_META_MAXATTACK, self->fetcomp_meta_maxattack);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_META_MAXRELEASE, self->fetcomp_meta_maxrelease);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_META_CREST, self->fetcomp_meta_crest);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_META_ADAPT, self->fetcomp_meta_adapt);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_META_NOCLIP_ENABLED, self->fetcomp_noclip);
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-     PARAM_HPFX_FETCOMP_PROCESS_ENABLED, self->fetcomp_enabled);
-
-  // output volume
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_OUTPUT_VOLUME, self->out_volume);
-
-  // output pan
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_OUTPUT_PAN, self->out_pan);
-
-  // limiter
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_HPFX_LIMITER_THRESHOLD, self->lim_threshold);
-
-  // global enable
-  viperfx_command_set_px4_vx4x1 (self->vfx,
-      PARAM_SET_DOPROCESS_STATUS, self->fx_enabled);
-
-  // reset
-  self->vfx->reset (self->vfx);
+/* a dBFS threshold as the s16 peak at or below it
+ */
+static gint
+gst_viperfx_silence_level (gint db)
+{
+  return (gint) (32768.0 * pow (10.0, db / 20.0));
 }
 
 /* initialize the new element
@@ -594,118 +348,106 @@ static void sync_all_parameters (Gstviperfx *self)
 static void
 gst_viperfx_init (Gstviperfx *self)
 {
-  gint32 idx;
-
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (self), TRUE);
   gst_base_transform_set_gap_aware (GST_BASE_TRANSFORM (self), TRUE);
 
   /* initialize properties */
-  self->fx_enabled = FALSE;
-  // convolver
-  self->conv_enabled = FALSE;
   memset (self->conv_ir_path, 0,
       sizeof(self->conv_ir_path));
-  self->conv_cc_level = 0;
-  // vhe
-  self->vhe_enabled = FALSE;
-  self->vhe_level = 0;
-  // vse
-  self->vse_enabled = FALSE;
-  self->vse_ref_bark = 7600;
-  self->vse_bark_cons = 10;
-  // equalizer
-  self->eq_enabled = FALSE;
-  for (idx = 0; idx < 10; idx++)
-    self->eq_band_level[idx] = 0;
-  // colorful music
-  self->colm_enabled = FALSE;
-  self->colm_widening = 100;
-  self->colm_midimage = 100;
-  self->colm_depth = 200;
-  // diff surr
-  self->ds_enabled = FALSE;
-  self->ds_level = 0;
-  // reverb
-  self->reverb_enabled = FALSE;
-  self->reverb_roomsize = 30;
-  self->reverb_width = 40;
-  self->reverb_damp = 10;
-  self->reverb_wet = 20;
-  self->reverb_dry = 80;
-  // agc
-  self->agc_enabled = FALSE;
-  self->agc_ratio = 100;
-  self->agc_volume = 100;
-  self->agc_maxgain = 100;
-  // viper bass
-  self->vb_enabled = FALSE;
-  self->vb_mode = 0;
-  self->vb_freq = 76;
-  self->vb_gain = 0;
-  // viper clarity
-  self->vc_enabled = FALSE;
-  self->vc_mode = 0;
-  self->vc_level = 0;
-  // cure
-  self->cure_enabled = FALSE;
-  self->cure_level = 0;
-  // tube
-  self->tube_enabled = FALSE;
-  // analog-x
-  self->ax_enabled = FALSE;
-  self->ax_mode = 0;
-  // fet compressor
-  self->fetcomp_enabled = FALSE;
-  self->fetcomp_threshold = 0;
-  self->fetcomp_ratio = 0;
-  self->fetcomp_kneewidth = 0;
-  self->fetcomp_autoknee = TRUE;
-  self->fetcomp_gain = 0;
-  self->fetcomp_autogain = TRUE;
-  self->fetcomp_attack = 51;
-  self->fetcomp_autoattack = TRUE;
-  self->fetcomp_release = 38;
-  self->fetcomp_autorelease = TRUE;
-  self->fetcomp_meta_kneemulti = 50;
-  self->fetcomp_meta_maxattack = 88;
-  self->fetcomp_meta_maxrelease = 88;
-  self->fetcomp_meta_crest = 61;
-  self->fetcomp_meta_adapt = 66;
-  self->fetcomp_noclip = TRUE;
-  // output volume
-  self->out_volume = 100;
-  // output pan
-  self->out_pan = 0;
-  // limiter
-  self->lim_threshold = 100;
+  self->conv_ir_data = NULL;
+  memset (self->conv_ir_digest, 0, sizeof(self->conv_ir_digest));
+  viperfx_param_store_init (&self->params);
 
   /* initialize private resources */
-  self->vfx = NULL;
-  self->so_handle = viperfx_load_library (NULL);
-  if (self->so_handle == NULL) {
-    self->so_entrypoint = NULL;
-  } else {
-    self->so_entrypoint = query_viperfx_entrypoint (
-        self->so_handle);
-    if (self->so_entrypoint == NULL) {
-      viperfx_unload_library (
-          self->so_handle);
-      self->so_handle = NULL;
-    } else {
-      self->vfx = self->so_entrypoint ();
-      if (self->vfx == NULL) {
-        viperfx_unload_library (
-            self->so_handle);
-        self->so_handle = NULL;
-        self->so_entrypoint = NULL;
-      }
-    }
-  }
-
-  if (self->vfx != NULL)
-    sync_all_parameters (self);
+  self->kernels = viperfx_kernels_best ();
+  self->scratch = NULL;
+  self->scratch_samples = 0;
+  memset (self->cores, 0, sizeof(self->cores));
+  memset (self->pairs, 0, sizeof(self->pairs));
+  self->n_cores = 0;
+  self->n_pairs = 0;
+  self->stereo = TRUE;
+  self->resample = TRUE;
+  self->resample_factor = 1;
+  self->block_size = 0;
+  self->load_warning = 80;
+  self->load_critical = 95;
+  self->report_overruns = TRUE;
+  self->crossfade = 0;
+  self->load = 0.0;
+  self->load_permille = 0;
+  self->load_level = LOAD_LEVEL_NORMAL;
+  self->overruns = 0;
+  self->overrun_posted = GST_CLOCK_TIME_NONE;
+  self->block_frames = 0;
+  self->latency = 0;
+  self->workers = NULL;
+  self->pending = 0;
+  self->job_in = NULL;
+  self->job_data = NULL;
+  self->job_frames = 0;
+  self->stats = NULL;
+  // pooled cores come reset and at the defaults params starts out with
+  self->cores[0] = viperfx_corepool_acquire ();
+  if (self->cores[0] != NULL)
+    self->n_cores = 1;
 
   g_mutex_init (&self->lock);
+  g_mutex_init (&self->done_lock);
+  g_cond_init (&self->done_cond);
+  viperfx_cmdq_init (&self->cmdq, COMMAND_QUEUE_SIZE);
+  self->resync = 0;
+  self->preset = NULL;
+  self->preset_serial = 0;
+  self->preset_applied = 0;
+  // one at a time, a newer path supersedes whatever is still queued
+  self->ir_loader = g_thread_pool_new (gst_viperfx_ir_loader, self,
+      1, FALSE, NULL);
+  self->ir_serial = 0;
+  self->core_rate = 0;
+  self->core_count = 0;
+  self->core_generation = 0;
+  self->ir_prepared = NULL;
+  self->ir_swap = 0;
+  memset (self->ir_loaded, 0, sizeof(self->ir_loaded));
+  memset (self->fading, 0, sizeof(self->fading));
+  self->fade_frames = 0;
+  self->shadow_requested = FALSE;
+  self->shadow_failed = FALSE;
+  self->bypass = FALSE;
+  self->control_interval = 0;
+  memset (self->bindings, 0, sizeof(self->bindings));
+  self->n_bound = 0;
+  self->control_refresh = GST_CLOCK_TIME_NONE;
+  self->silence_skip = FALSE;
+  self->silence_level = gst_viperfx_silence_level (DEFAULT_SILENCE_THRESHOLD);
+  self->silence_hold = 0;
+  self->quiet_frames = 0;
+  self->measure_peak = FALSE;
+  self->realtime_profile = FALSE;
+  self->realtime_priority = 0;
+  self->realtime_cpu = -1;
+  self->realtime_pending = 0;
+  self->realtime_locked = FALSE;
+  self->realtime_reported = 0;
+  self->realtime_applied = FALSE;
+  self->realtime_leaving = 0;
+  // runs the rest of the realtime profile's run, see gst_viperfx_chain
+  self->sink_chain =
+      GST_PAD_CHAINFUNC (GST_BASE_TRANSFORM_SINK_PAD (self));
+  gst_pad_set_chain_function (GST_BASE_TRANSFORM_SINK_PAD (self),
+      GST_DEBUG_FUNCPTR (gst_viperfx_chain));
+  self->denormals_off = FALSE;
+  self->input = NULL;
+  self->out_pool = NULL;
+  self->out_pool_size = 0;
+  self->delay_line = NULL;
+  self->delay_frames = 0;
+  self->delay_pos = 0;
+  self->delay_width = 0;
+  self->n_unpaired = 0;
+  self->next_pts = GST_CLOCK_TIME_NONE;
+  self->drain_pending = FALSE;
 }
 
 /* free private resources
@@ -714,50 +456,473 @@ static void
 gst_viperfx_finalize (GObject * object)
 {
   Gstviperfx *self = GST_VIPERFX (object);
+  guint i;
 
-  if (self->vfx != NULL) {
-    self->vfx->release (self->vfx);
-    self->vfx = NULL;
+  if (self->workers != NULL) {
+    g_thread_pool_free (self->workers, FALSE, TRUE);
+    self->workers = NULL;
+  }
+  // drop queued loads and wait for the one running, if any
+  if (self->ir_loader != NULL) {
+    g_thread_pool_free (self->ir_loader, TRUE, TRUE);
+    self->ir_loader = NULL;
+  }
+  gst_viperfx_free_ir_set (self->ir_prepared);
+  self->ir_prepared = NULL;
+  if (self->conv_ir_data != NULL) {
+    g_bytes_unref (self->conv_ir_data);
+    self->conv_ir_data = NULL;
+  }
+  gst_viperfx_end_fade (self);
+  gst_viperfx_clear_bindings (self);
+  for (i = 0; i < self->n_cores; i++) {
+    viperfx_corepool_release (self->cores[i]);
+    self->cores[i] = NULL;
   }
-  if (self->so_handle != NULL) {
-    viperfx_unload_library (
-        self->so_handle);
-    self->so_handle = NULL;
+  self->n_cores = 0;
+  // never stopped while locked
+  gst_viperfx_realtime_unlock_buffers (self);
+  for (i = 0; i < GST_VIPERFX_MAX_PAIRS; i++) {
+    viperfx_aligned_free (self->pairs[i].raw);
+    viperfx_aligned_free (self->pairs[i].pcm);
+    viperfx_resampler_free (self->pairs[i].resampler);
+    viperfx_aligned_free (self->pairs[i].hi);
+    viperfx_aligned_free (self->pairs[i].block_in);
+    viperfx_aligned_free (self->pairs[i].block_out);
+    viperfx_aligned_free (self->pairs[i].fade);
   }
-  self->so_entrypoint = NULL;
+  memset (self->pairs, 0, sizeof(self->pairs));
+  self->n_pairs = 0;
+  viperfx_aligned_free (self->delay_line);
+  self->delay_line = NULL;
 
   g_mutex_clear (&self->lock);
+  g_mutex_clear (&self->done_lock);
+  g_cond_clear (&self->done_cond);
+  gst_viperfx_discard_commands (self);
+  viperfx_cmdq_clear (&self->cmdq);
+  viperfx_preset_unref (self->preset);
+  self->preset = NULL;
+
+  viperfx_aligned_free (self->scratch);
+  self->scratch = NULL;
+  self->scratch_samples = 0;
+  gst_viperfx_clear_out_pool (self);
+
+  g_free (self->stats);
+  self->stats = NULL;
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* hand a command over to the streaming thread
+ * called with self->lock held, never waits for the streaming thread
+ */
+static gboolean
+gst_viperfx_queue_command (Gstviperfx *self, const viperfx_cmd *cmd)
+{
+  if (!viperfx_cmdq_push (&self->cmdq, cmd)) {
+    // queue is full, let the streaming thread pick up all fields at once
+    GST_DEBUG_OBJECT (self, "command queue full, scheduling resync");
+    g_atomic_int_set (&self->resync, 1);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* where the impulse response comes from, a path or sha256:<hash> for
+ * conv_ir_data, which is then referenced into *data
+ * called with self->lock held
+ */
 static void
-gst_viperfx_set_property (GObject * object, guint prop_id,
-    const GValue * value, GParamSpec * pspec)
+gst_viperfx_ir_source (Gstviperfx *self, gchar *source, GBytes **data)
 {
-  Gstviperfx *self = GST_VIPERFX (object);
+  if (self->conv_ir_data != NULL) {
+    g_snprintf (source, 256, IR_DATA_PREFIX "%s", self->conv_ir_digest);
+    *data = g_bytes_ref (self->conv_ir_data);
+  } else {
+    g_strlcpy (source, self->conv_ir_path, 256);
+    *data = NULL;
+  }
+}
 
-  switch (prop_id) {
-    case PROP_FX_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->fx_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_SET_DOPROCESS_STATUS, self->fx_enabled);
-      g_mutex_unlock (&self->lock);
+/* the kernel at the core rate to every core, decoded once per process
+ * and cached on disk. files the cache can't decode are left to the core
+ */
+static gboolean
+gst_viperfx_send_ir (Gstviperfx *self, viperfx_interface **cores,
+    guint n_cores, const gchar *path, GBytes *data, gint rate)
+{
+  viperfx_ir *ir = NULL;
+  GError *err = NULL;
+  gboolean ok = TRUE;
+  guint i;
+
+  if (data != NULL) {
+    // the core only takes paths, bytes it can't decode have nowhere to go
+    ir = viperfx_ir_cache_get_data (path + strlen (IR_DATA_PREFIX), data,
+        rate, &err);
+    if (ir == NULL) {
+      GST_WARNING_OBJECT (self, "can't use conv_ir_data: %s",
+          err != NULL ? err->message : "unknown error");
+      g_clear_error (&err);
+      return FALSE;
+    }
+  } else if (path[0] != '\0') {
+    ir = viperfx_ir_cache_get (path, rate, &err);
+    if (ir == NULL) {
+      GST_DEBUG_OBJECT (self, "%s goes to the core by path: %s", path,
+          err != NULL ? err->message : "unknown error");
+      g_clear_error (&err);
     }
-    break;
+  }
 
-    case PROP_CONV_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->conv_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_CONV_PROCESS_ENABLED, self->conv_enabled);
+  for (i = 0; i < n_cores; i++) {
+    if (ir != NULL)
+      ok &= viperfx_ir_send (ir, cores[i]);
+    else
+      ok &= viperfx_command_set_ir_path (cores[i], path);
+  }
+  viperfx_ir_unref (ir);
+  return ok;
+}
+
+/* called with self->lock held */
+static void
+gst_viperfx_clear_ir_data (Gstviperfx *self)
+{
+  if (self->conv_ir_data != NULL) {
+    g_bytes_unref (self->conv_ir_data);
+    self->conv_ir_data = NULL;
+  }
+}
+
+static void
+gst_viperfx_free_ir_set (GstviperfxIrSet *set)
+{
+  guint i;
+
+  if (set == NULL)
+    return;
+  for (i = 0; i < set->n_cores; i++)
+    viperfx_corepool_release (set->cores[i]);
+  if (set->data != NULL)
+    g_bytes_unref (set->data);
+  g_free (set);
+}
+
+/* ir_loader task, loads the newest conv_ir_path and the current
+ * parameters into fresh cores set up like the running ones. the core
+ * reads and prepares the file inside the command, which is what must
+ * not happen on the streaming thread
+ */
+static void
+gst_viperfx_ir_loader (gpointer data, gpointer user_data)
+{
+  Gstviperfx *self = user_data;
+  guint serial = GPOINTER_TO_UINT (data);
+  GstviperfxIrSet *set;
+  gint rate;
+  guint i;
+
+  set = g_new0 (GstviperfxIrSet, 1);
+  g_mutex_lock (&self->lock);
+  // superseded, the newer request is queued behind this one
+  if (serial != self->ir_serial || self->core_rate <= 0) {
+    g_mutex_unlock (&self->lock);
+    g_free (set);
+    return;
+  }
+  gst_viperfx_ir_source (self, set->path, &set->data);
+  set->generation = self->core_generation;
+  set->n_cores = self->core_count;
+  rate = self->core_rate;
+  g_mutex_unlock (&self->lock);
+
+  // values set from here on are still dirty when the cores go in
+  viperfx_param_store_snapshot (&self->params, set->values);
+  for (i = 0; i < set->n_cores; i++) {
+    viperfx_interface *vfx = viperfx_corepool_acquire ();
+
+    set->cores[i] = vfx;
+    if (vfx == NULL || !vfx->set_samplerate (vfx, rate) ||
+        !vfx->set_channels (vfx, 2))
+      break;
+    viperfx_param_send_values (vfx, set->values);
+  }
+  if (i == set->n_cores &&
+      gst_viperfx_send_ir (self, set->cores, set->n_cores, set->path,
+          set->data, rate)) {
+    for (i = 0; i < set->n_cores; i++)
+      set->cores[i]->reset (set->cores[i]);
+  } else {
+    GST_WARNING_OBJECT (self, "failed to load impulse response %s",
+        set->path);
+    gst_viperfx_free_ir_set (set);
+    // an empty swap tells the streaming thread to stop holding back
+    g_mutex_lock (&self->lock);
+    if (serial == self->ir_serial) {
+      gst_viperfx_free_ir_set (self->ir_prepared);
+      self->ir_prepared = NULL;
+      g_atomic_int_set (&self->ir_swap, 1);
+    }
+    g_mutex_unlock (&self->lock);
+    return;
+  }
+
+  g_mutex_lock (&self->lock);
+  if (serial == self->ir_serial && set->generation == self->core_generation) {
+    gst_viperfx_free_ir_set (self->ir_prepared);
+    self->ir_prepared = set;
+    set = NULL;
+    g_atomic_int_set (&self->ir_swap, 1);
+  }
+  g_mutex_unlock (&self->lock);
+  gst_viperfx_free_ir_set (set);
+}
+
+/* have conv_ir_path and the parameters loaded into cores in the
+ * background, the running cores keep going until the new ones are
+ * swapped in
+ * called with self->lock held
+ */
+static void
+gst_viperfx_load_ir (Gstviperfx *self)
+{
+  self->ir_serial++;
+  if (self->ir_serial == 0)
+    self->ir_serial++;
+  // before the first caps there is nothing to swap, setup loads it
+  if (self->core_rate <= 0 || self->ir_loader == NULL)
+    return;
+  g_thread_pool_push (self->ir_loader, GUINT_TO_POINTER (self->ir_serial),
+      NULL);
+}
+
+/* the cores a transition faded out go back to the pool
+ * streaming thread, or once nothing streams any more
+ */
+static void
+gst_viperfx_end_fade (Gstviperfx *self)
+{
+  guint i;
+
+  for (i = 0; i < GST_VIPERFX_MAX_PAIRS; i++) {
+    viperfx_corepool_release (self->fading[i]);
+    self->fading[i] = NULL;
+  }
+}
+
+/* put prepared cores in place of the running ones, with crossfade set
+ * the running ones keep playing until they have been faded out
+ * only called from the streaming thread, never waits for the lock
+ */
+static void
+gst_viperfx_swap_ir (Gstviperfx *self)
+{
+  GstviperfxIrSet *set;
+  viperfx_interface *old;
+  guint crossfade;
+  guint i;
+
+  // one transition at a time, the next set waits for this one to end
+  if (self->fading[0] != NULL)
+    return;
+  if (!g_mutex_trylock (&self->lock))
+    return;
+  g_atomic_int_set (&self->ir_swap, 0);
+  set = self->ir_prepared;
+  self->ir_prepared = NULL;
+  g_mutex_unlock (&self->lock);
+
+  if (set == NULL) {
+    // the loader gave up, held switches go to the running cores
+    if (self->shadow_requested)
+      self->shadow_failed = TRUE;
+    self->shadow_requested = FALSE;
+    return;
+  }
+  if (set->generation != self->core_generation ||
+      set->n_cores != self->n_cores) {
+    gst_viperfx_free_ir_set (set);
+    return;
+  }
+
+  crossfade = (guint) g_atomic_int_get (&self->crossfade);
+  for (i = 0; i < set->n_cores; i++) {
+    old = self->cores[i];
+    self->cores[i] = set->cores[i];
+    if (crossfade > 0) {
+      self->fading[i] = old;
+      self->pairs[i].fade_pos = 0;
+      set->cores[i] = NULL;
+    } else {
+      set->cores[i] = old;
+    }
+  }
+  self->fade_frames = MAX (1, (guint) self->core_rate * crossfade / 1000);
+  // what the new cores were sent, anything newer follows with the flush
+  viperfx_param_store_adopt (&self->params, set->values);
+  self->shadow_requested = FALSE;
+
+  if (strcmp (self->ir_loaded, set->path) != 0) {
+    g_strlcpy (self->ir_loaded, set->path, sizeof(self->ir_loaded));
+    GST_INFO_OBJECT (self, "impulse response %s in place", set->path);
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_element (GST_OBJECT (self),
+            gst_structure_new ("viperfx-ir-loaded",
+                "path", G_TYPE_STRING, set->path, NULL)));
+  }
+  if (crossfade > 0) {
+    GST_DEBUG_OBJECT (self, "crossfading to new cores over %u frames",
+        self->fade_frames);
+  }
+
+  // the old cores go back to the pool, restored on its own thread
+  gst_viperfx_free_ir_set (set);
+}
+
+/* module switches held back for a transition, have cores prepared
+ * with them. retried on the next buffer if the lock is busy
+ * only called from the streaming thread
+ */
+static void
+gst_viperfx_request_shadow (Gstviperfx *self)
+{
+  if (!g_mutex_trylock (&self->lock))
+    return;
+  gst_viperfx_load_ir (self);
+  self->shadow_requested = TRUE;
+  g_mutex_unlock (&self->lock);
+}
+
+/* hand a whole preset over at once. its impulse response, if it has
+ * one, is loaded in the background and follows the parameters
+ * called with self->lock held
+ */
+static void
+gst_viperfx_queue_preset (Gstviperfx *self, viperfx_preset *preset)
+{
+  viperfx_cmd cmd;
+
+  if (preset->has_ir_path) {
+    g_strlcpy (self->conv_ir_path, preset->ir_path,
+        sizeof(self->conv_ir_path));
+    gst_viperfx_clear_ir_data (self);
+    gst_viperfx_load_ir (self);
+  }
+
+  viperfx_preset_unref (self->preset);
+  self->preset = viperfx_preset_ref (preset);
+  self->preset_serial++;
+
+  cmd.type = VIPERFX_CMD_PRESET;
+  cmd.data = viperfx_preset_ref (preset);
+  if (!gst_viperfx_queue_command (self, &cmd))
+    viperfx_preset_unref (cmd.data);
+}
+
+/* drop queued commands and the references they hold
+ * only called by the consumer, or once nothing streams any more
+ */
+static void
+gst_viperfx_discard_commands (Gstviperfx *self)
+{
+  viperfx_cmd *cmd;
+
+  while ((cmd = viperfx_cmdq_peek (&self->cmdq)) != NULL) {
+    if (cmd->type == VIPERFX_CMD_PRESET)
+      viperfx_preset_unref (cmd->data);
+    viperfx_cmdq_advance (&self->cmdq);
+  }
+}
+
+/* all parameters of a preset, between two process calls
+ */
+static void
+gst_viperfx_apply_preset (Gstviperfx *self, const viperfx_preset *preset)
+{
+  // the flush after the queue is drained sends the whole set
+  viperfx_preset_apply (preset, &self->params);
+}
+
+/* send the parameters that changed, at most one command each. with
+ * crossfade module switches wait for cores prepared with them instead
+ * only called from the streaming thread
+ */
+static void
+gst_viperfx_flush_params (Gstviperfx *self)
+{
+  const guint *hold = NULL;
+
+  if (g_atomic_int_get (&self->crossfade) > 0 && self->core_rate > 0 &&
+      !self->shadow_failed)
+    hold = crossfade_hold;
+  self->shadow_failed = FALSE;
+  viperfx_param_store_flush (&self->params, self->cores, self->n_cores,
+      FALSE, hold);
+  if (G_UNLIKELY (hold != NULL && !self->shadow_requested) &&
+      viperfx_param_store_pending (&self->params, hold))
+    gst_viperfx_request_shadow (self);
+}
+
+/* apply everything the control threads queued since the last buffer
+ * only called from the streaming thread
+ */
+static void
+gst_viperfx_drain_commands (Gstviperfx *self)
+{
+  viperfx_cmd *cmd;
+
+  if (G_UNLIKELY (g_atomic_int_get (&self->ir_swap)))
+    gst_viperfx_swap_ir (self);
+
+  if (G_UNLIKELY (g_atomic_int_get (&self->resync))) {
+    // producers hold the lock only for a few stores, never wait for them
+    if (g_mutex_trylock (&self->lock)) {
+      g_atomic_int_set (&self->resync, 0);
+      gst_viperfx_discard_commands (self);
+      // the latest preset stands in for any that were dropped
+      if (self->preset_applied != self->preset_serial &&
+          self->preset != NULL) {
+        gst_viperfx_apply_preset (self, self->preset);
+        self->preset_applied = self->preset_serial;
+      }
       g_mutex_unlock (&self->lock);
     }
-    break;
+  }
+
+  while ((cmd = viperfx_cmdq_peek (&self->cmdq)) != NULL) {
+    switch (cmd->type) {
+      case VIPERFX_CMD_PRESET:
+        gst_viperfx_apply_preset (self, cmd->data);
+        self->preset_applied++;
+        // normally the cache still holds it and this doesn't free
+        viperfx_preset_unref (cmd->data);
+        break;
+      default:
+        break;
+    }
+    viperfx_cmdq_advance (&self->cmdq);
+  }
+
+  gst_viperfx_flush_params (self);
+}
+
+static void
+gst_viperfx_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  Gstviperfx *self = GST_VIPERFX (object);
+
+  if (prop_id >= PROP_PARAM_FIRST && prop_id <= PROP_PARAM_LAST) {
+    // picked up by the streaming thread on the next buffer
+    viperfx_param_store_set (&self->params,
+        prop_id - PROP_PARAM_FIRST, value);
+    return;
+  }
 
+  switch (prop_id) {
     case PROP_CONV_IR_PATH:
     {
       g_mutex_lock (&self->lock);
@@ -766,739 +931,1755 @@ gst_viperfx_set_property (GObject * object, guint prop_id,
               sizeof(self->conv_ir_path));
           strcpy(self->conv_ir_path,
               g_value_get_string (value));
-          viperfx_command_set_ir_path (self->vfx, self->conv_ir_path);
+          gst_viperfx_clear_ir_data (self);
+          gst_viperfx_load_ir (self);
       }
       g_mutex_unlock (&self->lock);
     }
     break;
 
-    case PROP_CONV_CC_LEVEL:
+    case PROP_CONV_IR_DATA:
     {
-      g_mutex_lock (&self->lock);
-      self->conv_cc_level = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_CONV_CROSSCHANNEL, self->conv_cc_level);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+      GBytes *data = g_value_dup_boxed (value);
+      gchar digest[65];
 
-    case PROP_VHE_ENABLE:
-    {
+      // hash outside the lock, identical data then shares one kernel
+      if (data != NULL)
+        viperfx_ir_digest (data, digest);
       g_mutex_lock (&self->lock);
-      self->vhe_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VHE_PROCESS_ENABLED, self->vhe_enabled);
+      gst_viperfx_clear_ir_data (self);
+      if (data != NULL) {
+        self->conv_ir_data = data;
+        memcpy (self->conv_ir_digest, digest, sizeof(digest));
+        memset (self->conv_ir_path, 0, sizeof(self->conv_ir_path));
+      }
+      gst_viperfx_load_ir (self);
       g_mutex_unlock (&self->lock);
     }
     break;
 
-    case PROP_VHE_LEVEL:
+    case PROP_PRESET:
     {
-      g_mutex_lock (&self->lock);
-      self->vhe_level = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VHE_EFFECT_LEVEL, self->vhe_level);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+      const gchar *path = g_value_get_string (value);
+      viperfx_preset *preset;
+      GError *err = NULL;
 
-    case PROP_VSE_ENABLE:
-    {
+      if (path == NULL || *path == '\0')
+        break;
+      // parsed once per file version, later switches are a cache hit
+      preset = viperfx_preset_load (path, &err);
+      if (preset == NULL) {
+        GST_WARNING_OBJECT (self, "can't load preset: %s", err->message);
+        g_error_free (err);
+        break;
+      }
       g_mutex_lock (&self->lock);
-      self->vse_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VSE_PROCESS_ENABLED, self->vse_enabled);
+      gst_viperfx_queue_preset (self, preset);
       g_mutex_unlock (&self->lock);
+      viperfx_preset_unref (preset);
     }
     break;
 
-    case PROP_VSE_REF_BARK:
-    {
-      g_mutex_lock (&self->lock);
-      self->vse_ref_bark = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VSE_REFERENCE_BARK, self->vse_ref_bark);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_RESAMPLE:
+      // takes effect with the next caps, which may have to change
+      g_atomic_int_set (&self->resample, g_value_get_boolean (value));
+      gst_pad_push_event (GST_BASE_TRANSFORM_SINK_PAD (self),
+          gst_event_new_reconfigure ());
+      break;
 
-    case PROP_VSE_BARK_CONS:
-    {
-      g_mutex_lock (&self->lock);
-      self->vse_bark_cons = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VSE_BARK_RECONSTRUCT, self->vse_bark_cons);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_BLOCK_SIZE:
+      // takes effect with the next caps
+      g_atomic_int_set (&self->block_size, g_value_get_uint (value));
+      break;
 
-    case PROP_EQ_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FIREQ_PROCESS_ENABLED, self->eq_enabled);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_LOAD_WARNING:
+      g_atomic_int_set (&self->load_warning, g_value_get_uint (value));
+      break;
 
-    case PROP_EQ_BAND1:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[0] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 0, self->eq_band_level[0]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_LOAD_CRITICAL:
+      g_atomic_int_set (&self->load_critical, g_value_get_uint (value));
+      break;
 
-    case PROP_EQ_BAND2:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[1] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 1, self->eq_band_level[1]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_REPORT_OVERRUNS:
+      g_atomic_int_set (&self->report_overruns, g_value_get_boolean (value));
+      break;
 
-    case PROP_EQ_BAND3:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[2] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 2, self->eq_band_level[2]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_CROSSFADE:
+      g_atomic_int_set (&self->crossfade, g_value_get_uint (value));
+      break;
 
-    case PROP_EQ_BAND4:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[3] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 3, self->eq_band_level[3]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_CONTROL_INTERVAL:
+      // read at the start of every buffer
+      g_atomic_int_set (&self->control_interval, g_value_get_uint (value));
+      break;
 
-    case PROP_EQ_BAND5:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[4] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 4, self->eq_band_level[4]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_SILENCE_SKIP:
+      g_atomic_int_set (&self->silence_skip, g_value_get_boolean (value));
+      break;
 
-    case PROP_EQ_BAND6:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[5] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 5, self->eq_band_level[5]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_SILENCE_THRESHOLD:
+      g_atomic_int_set (&self->silence_level,
+          gst_viperfx_silence_level (g_value_get_int (value)));
+      break;
 
-    case PROP_EQ_BAND7:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[6] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 6, self->eq_band_level[6]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_REALTIME_PROFILE:
+      // takes effect at the next change to PLAYING
+      g_atomic_int_set (&self->realtime_profile, g_value_get_boolean (value));
+      break;
 
-    case PROP_EQ_BAND8:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[7] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 7, self->eq_band_level[7]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_REALTIME_PRIORITY:
+      g_atomic_int_set (&self->realtime_priority, g_value_get_int (value));
+      break;
 
-    case PROP_EQ_BAND9:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[8] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 8, self->eq_band_level[8]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    case PROP_REALTIME_CPU:
+      g_atomic_int_set (&self->realtime_cpu, g_value_get_int (value));
+      break;
 
-    case PROP_EQ_BAND10:
-    {
-      g_mutex_lock (&self->lock);
-      self->eq_band_level[9] = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x2 (self->vfx,
-          PARAM_HPFX_FIREQ_BANDLEVEL, 9, self->eq_band_level[9]);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
 
-    case PROP_COLM_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->colm_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_COLM_PROCESS_ENABLED, self->colm_enabled);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+static void
+gst_viperfx_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  Gstviperfx *self = GST_VIPERFX (object);
 
-    case PROP_COLM_WIDENING:
-    {
-      g_mutex_lock (&self->lock);
-      self->colm_widening = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_COLM_WIDENING, self->colm_widening);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  switch (prop_id) {
+    case PROP_LOAD:
+      g_value_set_double (value,
+          g_atomic_int_get (&self->load_permille) / 10.0);
+      break;
 
-    case PROP_COLM_MIDIMAGE:
-    {
-      g_mutex_lock (&self->lock);
-      self->colm_midimage = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_COLM_MIDIMAGE, self->colm_midimage);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
 
-    case PROP_COLM_DEPTH:
-    {
-      float f_depth_val = (float) g_value_get_int (value);
-      gint s_val = 0;
-      f_depth_val = (f_depth_val / 32767.00f) * 600.00f;
-      s_val = (gint) (f_depth_val + 200.0f);
-      if (s_val < 200) s_val = 200;
-      if (s_val > 800) s_val = 800;
+/* a failed step of the realtime profile goes on the bus as a warning,
+ * once per run, streaming goes on without it
+ */
+static void
+gst_viperfx_realtime_failed (Gstviperfx *self, guint step, const gchar *what,
+    gint error)
+{
+  if (self->realtime_reported & step)
+    return;
+  self->realtime_reported |= step;
+  GST_ELEMENT_WARNING (self, RESOURCE, SETTINGS,
+      ("Realtime profile: could not %s", what),
+      ("%s (%d)", g_strerror (error), error));
+}
 
-      g_mutex_lock (&self->lock);
-      self->colm_depth = s_val;
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_COLM_DEPTH, self->colm_depth);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+static void
+gst_viperfx_realtime_lock (Gstviperfx *self, gconstpointer ptr, gsize size)
+{
+  gint error = viperfx_rt_lock (ptr, size);
 
-    case PROP_DS_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->ds_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_DIFFSURR_PROCESS_ENABLED, self->ds_enabled);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  if (error != 0)
+    gst_viperfx_realtime_failed (self, REALTIME_LOCK_BUFFERS,
+        "lock the working buffers in memory", error);
+}
 
-    case PROP_DS_LEVEL:
-    {
-      g_mutex_lock (&self->lock);
-      self->ds_level = g_value_get_int (value) * 20;
-      if (self->ds_level < 0) self->ds_level = 0;
-      if (self->ds_level > 2000) self->ds_level = 2000;
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_DIFFSURR_DELAYTIME, self->ds_level);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* a working buffer about to be freed, locked pages must not go back */
+static inline void
+gst_viperfx_realtime_unlock (Gstviperfx *self, gconstpointer ptr, gsize size)
+{
+  if (G_UNLIKELY (self->realtime_locked))
+    viperfx_rt_unlock (ptr, size);
+}
 
-    case PROP_REVERB_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->reverb_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_REVB_PROCESS_ENABLED, self->reverb_enabled);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* everything process touches that the element allocated, buffers grown
+ * later are locked as they are made
+ */
+static void
+gst_viperfx_realtime_lock_buffers (Gstviperfx *self)
+{
+  guint i;
+
+  gst_viperfx_realtime_lock (self, self->scratch,
+      self->scratch_samples * sizeof(gint16));
+  for (i = 0; i < self->n_pairs; i++) {
+    GstviperfxPair *pair = &self->pairs[i];
+
+    gst_viperfx_realtime_lock (self, pair->raw,
+        pair->frames * 2 * sizeof(gint32));
+    gst_viperfx_realtime_lock (self, pair->pcm,
+        pair->frames * 2 * sizeof(gint16));
+    if (pair->hi != NULL)
+      gst_viperfx_realtime_lock (self, pair->hi, VIPERFX_RESAMPLE_MAX_FRAMES *
+          self->resample_factor * 2 * sizeof(gint16));
+    if (pair->block_in != NULL) {
+      gst_viperfx_realtime_lock (self, pair->block_in,
+          self->block_frames * 2 * sizeof(gint16));
+      gst_viperfx_realtime_lock (self, pair->block_out,
+          self->block_frames * 2 * sizeof(gint16));
+    }
+    gst_viperfx_realtime_lock (self, pair->fade,
+        FADE_CHUNK * 2 * sizeof(gint16));
+  }
+  gst_viperfx_realtime_lock (self, self->delay_line,
+      (gsize) self->delay_frames * self->n_unpaired * self->delay_width);
+}
 
-    case PROP_REVERB_ROOMSIZE:
-    {
-      g_mutex_lock (&self->lock);
-      self->reverb_roomsize = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_REVB_ROOMSIZE, self->reverb_roomsize);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* the other way around, when the buffers stop being locked */
+static void
+gst_viperfx_realtime_unlock_buffers (Gstviperfx *self)
+{
+  guint i;
+
+  if (!self->realtime_locked)
+    return;
+  viperfx_rt_unlock (self->scratch, self->scratch_samples * sizeof(gint16));
+  for (i = 0; i < GST_VIPERFX_MAX_PAIRS; i++) {
+    GstviperfxPair *pair = &self->pairs[i];
+
+    viperfx_rt_unlock (pair->raw, pair->frames * 2 * sizeof(gint32));
+    viperfx_rt_unlock (pair->pcm, pair->frames * 2 * sizeof(gint16));
+    viperfx_rt_unlock (pair->hi, pair->hi == NULL ? 0 :
+        VIPERFX_RESAMPLE_MAX_FRAMES * self->resample_factor * 2 *
+        sizeof(gint16));
+    viperfx_rt_unlock (pair->block_in,
+        self->block_frames * 2 * sizeof(gint16));
+    viperfx_rt_unlock (pair->block_out,
+        self->block_frames * 2 * sizeof(gint16));
+    viperfx_rt_unlock (pair->fade, FADE_CHUNK * 2 * sizeof(gint16));
+  }
+  viperfx_rt_unlock (self->delay_line,
+      (gsize) self->delay_frames * self->n_unpaired * self->delay_width);
+  self->realtime_locked = FALSE;
+}
 
-    case PROP_REVERB_WIDTH:
-    {
-      g_mutex_lock (&self->lock);
-      self->reverb_width = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_REVB_WIDTH, self->reverb_width);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* the first buffer after the change to PLAYING, on the streaming thread
+ * the profile is for. the thread keeps its priority and affinity until
+ * gst_viperfx_realtime_restore
+ */
+static void
+gst_viperfx_realtime_apply (Gstviperfx *self)
+{
+  gint priority = g_atomic_int_get (&self->realtime_priority);
+  gint cpu = g_atomic_int_get (&self->realtime_cpu);
+  gint error;
+
+  // a new run reports again
+  self->realtime_reported = 0;
+  // back in PLAYING before the run ended, what was saved still holds
+  if (!self->realtime_applied) {
+    error = viperfx_rt_sched_save (&self->realtime_sched);
+    if (error != 0)
+      gst_viperfx_realtime_failed (self, REALTIME_SCHED,
+          "save the streaming thread's scheduling", error);
+    self->realtime_applied = (error == 0);
+  }
+  // what can't be put back isn't changed
+  if (self->realtime_applied) {
+    error = viperfx_rt_set_fifo (priority);
+    if (error != 0)
+      gst_viperfx_realtime_failed (self, REALTIME_PRIORITY,
+          "raise the streaming thread to SCHED_FIFO", error);
+    error = viperfx_rt_set_affinity (cpu);
+    if (error != 0)
+      gst_viperfx_realtime_failed (self, REALTIME_AFFINITY,
+          "pin the streaming thread to its cpu", error);
+  }
+  error = viperfx_library_mlock ();
+  if (error != 0)
+    gst_viperfx_realtime_failed (self, REALTIME_LOCK_LIBRARY,
+        "lock the core library in memory", error);
+  gst_viperfx_realtime_lock_buffers (self);
+  self->realtime_locked = TRUE;
+
+  GST_INFO_OBJECT (self, "realtime profile applied, priority %d, cpu %d",
+      priority, cpu);
+}
 
-    case PROP_REVERB_DAMP:
-    {
-      g_mutex_lock (&self->lock);
-      self->reverb_damp = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_REVB_DAMP, self->reverb_damp);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* the end of a run, on the thread the profile was applied to. streaming
+ * threads come from a pool and go on to run other tasks
+ */
+static void
+gst_viperfx_realtime_restore (Gstviperfx *self)
+{
+  gint error;
+
+  if (!self->realtime_applied)
+    return;
+  self->realtime_applied = FALSE;
+  error = viperfx_rt_sched_restore (&self->realtime_sched);
+  if (error != 0)
+    gst_viperfx_realtime_failed (self, REALTIME_SCHED,
+        "restore the streaming thread's scheduling", error);
+  GST_INFO_OBJECT (self, "realtime profile ended");
+}
 
-    case PROP_REVERB_WET:
-    {
-      g_mutex_lock (&self->lock);
-      self->reverb_wet = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_REVB_WET, self->reverb_wet);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* make sure the s16 scratch buffer holds at least num_samples,
+ * only grows so steady streaming never allocates
+ */
+static gboolean
+gst_viperfx_ensure_scratch (Gstviperfx *self, guint num_samples)
+{
+  gint16 *scratch;
 
-    case PROP_REVERB_DRY:
-    {
-      g_mutex_lock (&self->lock);
-      self->reverb_dry = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_REVB_DRY, self->reverb_dry);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  if (G_LIKELY (num_samples <= self->scratch_samples))
+    return TRUE;
 
-    case PROP_AGC_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->agc_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_AGC_PROCESS_ENABLED, self->agc_enabled);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  scratch = viperfx_aligned_alloc (num_samples * sizeof(gint16));
+  if (scratch == NULL) {
+    GST_ERROR_OBJECT (self, "failed to allocate %u samples of scratch", num_samples);
+    return FALSE;
+  }
+  GST_DEBUG_OBJECT (self, "scratch grown to %u samples", num_samples);
+  gst_viperfx_realtime_unlock (self, self->scratch,
+      self->scratch_samples * sizeof(gint16));
+  viperfx_aligned_free (self->scratch);
+  self->scratch = scratch;
+  self->scratch_samples = num_samples;
+  if (G_UNLIKELY (self->realtime_locked))
+    gst_viperfx_realtime_lock (self, scratch, num_samples * sizeof(gint16));
+  return TRUE;
+}
 
-    case PROP_AGC_RATIO:
-    {
-      g_mutex_lock (&self->lock);
-      self->agc_ratio = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_AGC_RATIO, self->agc_ratio);
-      g_mutex_unlock (&self->lock);
+/* same for the per pair buffers, raw is sized for the widest format */
+static gboolean
+gst_viperfx_ensure_pair_buffers (Gstviperfx *self, guint num_frames)
+{
+  guint i;
+
+  for (i = 0; i < self->n_pairs; i++) {
+    GstviperfxPair *pair = &self->pairs[i];
+    gpointer raw;
+    gint16 *pcm;
+
+    if (G_LIKELY (num_frames <= pair->frames))
+      continue;
+
+    raw = viperfx_aligned_alloc (num_frames * 2 * sizeof(gint32));
+    pcm = viperfx_aligned_alloc (num_frames * 2 * sizeof(gint16));
+    if (raw == NULL || pcm == NULL) {
+      GST_ERROR_OBJECT (self, "failed to allocate %u frames for pair %u",
+          num_frames, i);
+      viperfx_aligned_free (raw);
+      viperfx_aligned_free (pcm);
+      return FALSE;
+    }
+    gst_viperfx_realtime_unlock (self, pair->raw,
+        pair->frames * 2 * sizeof(gint32));
+    gst_viperfx_realtime_unlock (self, pair->pcm,
+        pair->frames * 2 * sizeof(gint16));
+    viperfx_aligned_free (pair->raw);
+    viperfx_aligned_free (pair->pcm);
+    pair->raw = raw;
+    pair->pcm = pcm;
+    pair->frames = num_frames;
+    if (G_UNLIKELY (self->realtime_locked)) {
+      gst_viperfx_realtime_lock (self, raw, num_frames * 2 * sizeof(gint32));
+      gst_viperfx_realtime_lock (self, pcm, num_frames * 2 * sizeof(gint16));
     }
-    break;
+  }
+  return TRUE;
+}
 
-    case PROP_AGC_VOLUME:
-    {
-      g_mutex_lock (&self->lock);
-      self->agc_volume = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_AGC_VOLUME, self->agc_volume);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* positions that make up a stereo pair, in the order cores are assigned */
+static const GstAudioChannelPosition pair_positions[][2] = {
+  { GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_REAR_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT_OF_CENTER,
+    GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT_OF_CENTER },
+  { GST_AUDIO_CHANNEL_POSITION_WIDE_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_WIDE_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_SURROUND_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_SURROUND_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_TOP_FRONT_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_TOP_FRONT_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_TOP_REAR_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_TOP_REAR_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_TOP_SIDE_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_TOP_SIDE_RIGHT },
+  { GST_AUDIO_CHANNEL_POSITION_BOTTOM_FRONT_LEFT,
+    GST_AUDIO_CHANNEL_POSITION_BOTTOM_FRONT_RIGHT },
+};
 
-    case PROP_AGC_MAXGAIN:
-    {
-      g_mutex_lock (&self->lock);
-      self->agc_maxgain = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_AGC_MAXSCALER, self->agc_maxgain);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* split the layout into stereo pairs, center, lfe and anything else
+ * without a partner is left untouched. unpositioned layouts are paired
+ * in stream order
+ */
+static guint
+gst_viperfx_map_pairs (Gstviperfx *self, const GstAudioInfo *info)
+{
+  gint channels = GST_AUDIO_INFO_CHANNELS (info);
+  guint n_pairs = 0;
+  gint i, j, left, right;
 
-    case PROP_VB_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->vb_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VIPERBASS_PROCESS_ENABLED, self->vb_enabled);
-      g_mutex_unlock (&self->lock);
+  if (GST_AUDIO_INFO_IS_UNPOSITIONED (info)) {
+    for (i = 0; i + 1 < channels; i += 2) {
+      self->pairs[n_pairs].left = i;
+      self->pairs[n_pairs].right = i + 1;
+      n_pairs++;
     }
-    break;
+    return n_pairs;
+  }
 
-    case PROP_VB_MODE:
-    {
-      g_mutex_lock (&self->lock);
-      self->vb_mode = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VIPERBASS_MODE, self->vb_mode);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  for (i = 0; i < (gint) G_N_ELEMENTS (pair_positions); i++) {
+    left = right = -1;
+    for (j = 0; j < channels; j++) {
+      if (info->position[j] == pair_positions[i][0])
+        left = j;
+      else if (info->position[j] == pair_positions[i][1])
+        right = j;
+    }
+    if (left < 0 || right < 0)
+      continue;
+    self->pairs[n_pairs].left = left;
+    self->pairs[n_pairs].right = right;
+    n_pairs++;
+  }
+  return n_pairs;
+}
 
-    case PROP_VB_FREQ:
-    {
-      g_mutex_lock (&self->lock);
-      self->vb_freq = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VIPERBASS_SPEAKER, self->vb_freq);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* a new core starts out with what the running ones have been sent,
+ * anything still queued reaches all of them with the next buffer
+ */
+static viperfx_interface *
+gst_viperfx_create_core (Gstviperfx *self)
+{
+  viperfx_interface *vfx;
 
-    case PROP_VB_GAIN:
-    {
-      g_mutex_lock (&self->lock);
-      self->vb_gain = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VIPERBASS_BASSGAIN, self->vb_gain);
-      g_mutex_unlock (&self->lock);
+  vfx = viperfx_corepool_acquire ();
+  if (vfx == NULL)
+    return NULL;
+
+  // setup hands every core its kernel once the rate is known
+  viperfx_param_store_replay (&self->params, vfx);
+  return vfx;
+}
+
+/* equal-power mix of the pair's outgoing core output in old into the
+ * new core output in pcm, for the frames still inside the fade
+ */
+static void
+gst_viperfx_crossfade (Gstviperfx *self, GstviperfxPair *pair, gint16 *pcm,
+    const gint16 *old, guint num_frames)
+{
+  guint total = self->fade_frames;
+  guint n;
+
+  while (num_frames > 0 && pair->fade_pos < total) {
+    gdouble a0 = G_PI_2 * pair->fade_pos / total;
+    gdouble a1;
+    gfloat in0, in1, out0, out1;
+
+    n = MIN (num_frames, MIN (FADE_SEGMENT, total - pair->fade_pos));
+    a1 = G_PI_2 * (pair->fade_pos + n) / total;
+    in0 = (gfloat) sin (a0);
+    in1 = (gfloat) sin (a1);
+    out0 = (gfloat) cos (a0);
+    out1 = (gfloat) cos (a1);
+    self->kernels->xfade_s16 (pcm, old, n, in0, out0,
+        (in1 - in0) / n, (out1 - out0) / n);
+    pcm += n * 2;
+    old += n * 2;
+    num_frames -= n;
+    pair->fade_pos += n;
+  }
+}
+
+/* one call into core index at the core rate. during a transition the
+ * outgoing core gets a copy of the same input and is faded out
+ */
+static void
+gst_viperfx_call_core (Gstviperfx *self, guint index, gint16 *pcm,
+    guint num_frames)
+{
+  viperfx_interface *vfx = self->cores[index];
+  viperfx_interface *old = self->fading[index];
+  GstviperfxPair *pair = &self->pairs[index];
+  guint done, chunk;
+
+  if (G_LIKELY (old == NULL) || pair->fade_pos >= self->fade_frames) {
+    vfx->process (vfx, pcm, (int)num_frames);
+    return;
+  }
+
+  for (done = 0; done < num_frames && pair->fade_pos < self->fade_frames;
+      done += chunk) {
+    chunk = MIN (num_frames - done, FADE_CHUNK);
+    memcpy (pair->fade, pcm + done * 2, chunk * 2 * sizeof(gint16));
+    old->process (old, pair->fade, (int)chunk);
+    vfx->process (vfx, pcm + done * 2, (int)chunk);
+    gst_viperfx_crossfade (self, pair, pcm + done * 2, pair->fade, chunk);
+  }
+  if (done < num_frames)
+    vfx->process (vfx, pcm + done * 2, (int)(num_frames - done));
+}
+
+/* s16 stereo at the stream rate through core index, by way of the
+ * pair's resampler when the stream is slower than the core
+ */
+static void
+gst_viperfx_run_core (Gstviperfx *self, guint index, gint16 *pcm,
+    guint num_frames)
+{
+  GstviperfxPair *pair = &self->pairs[index];
+  guint factor = self->resample_factor;
+  guint done, chunk;
+
+  if (G_LIKELY (factor == 1)) {
+    gst_viperfx_call_core (self, index, pcm, num_frames);
+    return;
+  }
+
+  for (done = 0; done < num_frames; done += chunk) {
+    chunk = MIN (num_frames - done, VIPERFX_RESAMPLE_MAX_FRAMES);
+    viperfx_resampler_up (pair->resampler, pcm + done * 2, pair->hi, chunk);
+    gst_viperfx_call_core (self, index, pair->hi, chunk * factor);
+    viperfx_resampler_down (pair->resampler, pair->hi, pcm + done * 2, chunk);
+  }
+}
+
+/* feed a pair through its core in block_frames sized calls
+ * every frame going in swaps places with one processed a block earlier,
+ * so the output trails the input by exactly one block
+ */
+static void
+gst_viperfx_run_pair (Gstviperfx *self, guint index, gint16 *pcm,
+    guint num_frames)
+{
+  GstviperfxPair *pair = &self->pairs[index];
+  guint block = self->block_frames;
+  guint chunk;
+  gint16 *done;
+
+  if (G_LIKELY (block == 0)) {
+    gst_viperfx_run_core (self, index, pcm, num_frames);
+    return;
+  }
+
+  while (num_frames > 0) {
+    chunk = MIN (num_frames, block - pair->block_fill);
+    memcpy (pair->block_in + pair->block_fill * 2, pcm,
+        chunk * 2 * sizeof(gint16));
+    memcpy (pcm, pair->block_out + pair->block_fill * 2,
+        chunk * 2 * sizeof(gint16));
+    pair->block_fill += chunk;
+    pcm += chunk * 2;
+    num_frames -= chunk;
+
+    if (pair->block_fill == block) {
+      gst_viperfx_run_core (self, index, pair->block_in, block);
+      done = pair->block_in;
+      pair->block_in = pair->block_out;
+      pair->block_out = done;
+      pair->block_fill = 0;
     }
-    break;
+  }
+}
 
-    case PROP_VC_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->vc_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VIPERCLARITY_PROCESS_ENABLED, self->vc_enabled);
-      g_mutex_unlock (&self->lock);
+/* how loud what the core made of silent input still is
+ */
+static inline void
+gst_viperfx_pair_peak (Gstviperfx *self, GstviperfxPair *pair,
+    guint num_samples)
+{
+  if (G_UNLIKELY (self->measure_peak))
+    pair->peak = MAX (pair->peak,
+        self->kernels->peak_s16 (pair->pcm, num_samples));
+}
+
+/* run one pair of the current buffer through its core
+ * called from the streaming thread and the workers, every pair owns
+ * its core and buffers so nothing is shared but the stream itself
+ */
+static void
+gst_viperfx_process_pair (Gstviperfx *self, guint index)
+{
+  GstviperfxPair *pair = &self->pairs[index];
+  GstAudioFormat format = GST_AUDIO_FILTER_FORMAT (self);
+  gint channels = GST_AUDIO_FILTER_CHANNELS (self);
+  guint num_frames = self->job_frames;
+  guint num_samples = num_frames * 2;
+
+  if (format == GST_AUDIO_FORMAT_S16) {
+    viperfx_pair_gather (self->job_in, pair->pcm, sizeof(gint16),
+        channels, pair->left, pair->right, num_frames);
+    self->kernels->headroom_s16 (pair->pcm, pair->pcm, num_samples);
+    gst_viperfx_run_pair (self, index, pair->pcm, num_frames);
+    self->kernels->makeup_s16 (pair->pcm, pair->pcm, num_samples);
+    gst_viperfx_pair_peak (self, pair, num_samples);
+    viperfx_pair_scatter (pair->pcm, self->job_data, sizeof(gint16),
+        channels, pair->left, pair->right, num_frames);
+    return;
+  }
+
+  viperfx_pair_gather (self->job_in, pair->raw, sizeof(gint32),
+      channels, pair->left, pair->right, num_frames);
+  if (format == GST_AUDIO_FORMAT_F32) {
+    self->kernels->f32_to_s16_headroom (pair->raw, pair->pcm, num_samples);
+    gst_viperfx_run_pair (self, index, pair->pcm, num_frames);
+    self->kernels->makeup_s16 (pair->pcm, pair->pcm, num_samples);
+    gst_viperfx_pair_peak (self, pair, num_samples);
+    self->kernels->s16_to_f32 (pair->pcm, pair->raw, num_samples);
+  } else {
+    self->kernels->s32_to_s16_headroom (pair->raw, pair->pcm, num_samples);
+    gst_viperfx_run_pair (self, index, pair->pcm, num_frames);
+    self->kernels->makeup_s16 (pair->pcm, pair->pcm, num_samples);
+    gst_viperfx_pair_peak (self, pair, num_samples);
+    self->kernels->s16_to_s32 (pair->pcm, pair->raw, num_samples);
+  }
+  viperfx_pair_scatter (pair->raw, self->job_data, sizeof(gint32),
+      channels, pair->left, pair->right, num_frames);
+}
+
+static void
+gst_viperfx_pair_worker (gpointer data, gpointer user_data)
+{
+  Gstviperfx *self = GST_VIPERFX (user_data);
+  viperfx_fpu_state fpu;
+
+  // same float mode as the streaming thread for the pair's core
+  if (self->denormals_off)
+    viperfx_rt_denormals_off (&fpu);
+  gst_viperfx_process_pair (self, GPOINTER_TO_UINT (data) - 1);
+  if (self->denormals_off)
+    viperfx_rt_denormals_restore (&fpu);
+
+  if (g_atomic_int_dec_and_test (&self->pending)) {
+    g_mutex_lock (&self->done_lock);
+    g_cond_signal (&self->done_cond);
+    g_mutex_unlock (&self->done_lock);
+  }
+}
+
+/* one exclusive thread per extra pair, started here so the first
+ * buffer doesn't pay for thread creation
+ */
+static void
+gst_viperfx_setup_workers (Gstviperfx *self)
+{
+  GError *error = NULL;
+  gint wanted = (gint)self->n_pairs - 1;
+
+  if (self->workers != NULL &&
+      g_thread_pool_get_max_threads (self->workers) == wanted)
+    return;
+
+  if (self->workers != NULL) {
+    g_thread_pool_free (self->workers, FALSE, TRUE);
+    self->workers = NULL;
+  }
+  if (wanted <= 0)
+    return;
+
+  self->workers = g_thread_pool_new (gst_viperfx_pair_worker, self,
+      wanted, TRUE, &error);
+  if (self->workers == NULL) {
+    // still correct, the pairs just run one after another
+    GST_WARNING_OBJECT (self, "no pair workers: %s", error->message);
+    g_clear_error (&error);
+  }
+}
+
+/* (re)build the per pair resamplers for factor, 1 drops them
+ */
+static gboolean
+gst_viperfx_setup_resamplers (Gstviperfx *self, guint factor)
+{
+  guint i;
+
+  if (factor != self->resample_factor) {
+    for (i = 0; i < GST_VIPERFX_MAX_PAIRS; i++) {
+      viperfx_resampler_free (self->pairs[i].resampler);
+      if (self->pairs[i].hi != NULL)
+        gst_viperfx_realtime_unlock (self, self->pairs[i].hi,
+            VIPERFX_RESAMPLE_MAX_FRAMES * self->resample_factor * 2 *
+            sizeof(gint16));
+      viperfx_aligned_free (self->pairs[i].hi);
+      self->pairs[i].resampler = NULL;
+      self->pairs[i].hi = NULL;
+    }
+    self->resample_factor = factor;
+  }
+  if (factor == 1)
+    return TRUE;
+
+  for (i = 0; i < self->n_pairs; i++) {
+    GstviperfxPair *pair = &self->pairs[i];
+
+    if (pair->resampler == NULL) {
+      pair->resampler = viperfx_resampler_new (factor, self->kernels);
+      pair->hi = viperfx_aligned_alloc (
+          VIPERFX_RESAMPLE_MAX_FRAMES * factor * 2 * sizeof(gint16));
+      if (pair->resampler == NULL || pair->hi == NULL) {
+        GST_ERROR_OBJECT (self, "failed to set up resampler for pair %u", i);
+        return FALSE;
+      }
     }
-    break;
+    viperfx_resampler_reset (pair->resampler);
+  }
+  return TRUE;
+}
 
-    case PROP_VC_MODE:
-    {
-      g_mutex_lock (&self->lock);
-      self->vc_mode = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VIPERCLARITY_MODE, self->vc_mode);
-      g_mutex_unlock (&self->lock);
+/* size the block adapters of the active pairs, 0 turns them off
+ * a restart begins with a block of silence
+ */
+static gboolean
+gst_viperfx_setup_blocks (Gstviperfx *self, guint block)
+{
+  guint i;
+
+  if (block != self->block_frames) {
+    for (i = 0; i < GST_VIPERFX_MAX_PAIRS; i++) {
+      gst_viperfx_realtime_unlock (self, self->pairs[i].block_in,
+          self->block_frames * 2 * sizeof(gint16));
+      gst_viperfx_realtime_unlock (self, self->pairs[i].block_out,
+          self->block_frames * 2 * sizeof(gint16));
+      viperfx_aligned_free (self->pairs[i].block_in);
+      viperfx_aligned_free (self->pairs[i].block_out);
+      self->pairs[i].block_in = NULL;
+      self->pairs[i].block_out = NULL;
+    }
+    self->block_frames = block;
+  }
+  if (block == 0)
+    return TRUE;
+
+  for (i = 0; i < self->n_pairs; i++) {
+    GstviperfxPair *pair = &self->pairs[i];
+
+    if (pair->block_in == NULL) {
+      pair->block_in = viperfx_aligned_alloc (block * 2 * sizeof(gint16));
+      pair->block_out = viperfx_aligned_alloc (block * 2 * sizeof(gint16));
+      if (pair->block_in == NULL || pair->block_out == NULL) {
+        GST_ERROR_OBJECT (self, "failed to allocate blocks for pair %u", i);
+        return FALSE;
+      }
     }
-    break;
+    memset (pair->block_out, 0, block * 2 * sizeof(gint16));
+    pair->block_fill = 0;
+  }
+  return TRUE;
+}
 
-    case PROP_VC_LEVEL:
-    {
-      g_mutex_lock (&self->lock);
-      self->vc_level = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_VIPERCLARITY_CLARITY, self->vc_level);
-      g_mutex_unlock (&self->lock);
+/* room for the outgoing core's copy of a chunk in every active pair
+*/
+static gboolean
+gst_viperfx_setup_fades (Gstviperfx *self)
+{
+  guint i;
+
+  for (i = 0; i < self->n_pairs; i++) {
+    GstviperfxPair *pair = &self->pairs[i];
+
+    if (pair->fade == NULL) {
+      pair->fade = viperfx_aligned_alloc (FADE_CHUNK * 2 * sizeof(gint16));
+      if (pair->fade == NULL) {
+        GST_ERROR_OBJECT (self, "failed to allocate fade for pair %u", i);
+        return FALSE;
+      }
     }
-    break;
+    pair->fade_pos = 0;
+  }
+  return TRUE;
+}
 
-    case PROP_CURE_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->cure_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_CURE_PROCESS_ENABLED, self->cure_enabled);
-      g_mutex_unlock (&self->lock);
+/* frames the pairs trail their input by, on top of the core's own
+ */
+static guint
+gst_viperfx_delay_frames (Gstviperfx *self)
+{
+  guint frames = self->block_frames;
+
+  if (self->resample_factor > 1 && self->n_pairs > 0)
+    frames += viperfx_resampler_latency (self->pairs[0].resampler);
+  return frames;
+}
+
+/* channels left out of the pairs pass the cores, a delay line as long
+ * as the pairs' delay keeps them in line with the rest
+ */
+static gboolean
+gst_viperfx_setup_delay (Gstviperfx *self, const GstAudioInfo *info)
+{
+  gboolean paired[GST_VIPERFX_MAX_CHANNELS] = { FALSE, };
+  gint channels = GST_AUDIO_INFO_CHANNELS (info);
+  guint frames = gst_viperfx_delay_frames (self);
+  gsize size;
+  guint i;
+  gint ch;
+
+  gst_viperfx_realtime_unlock (self, self->delay_line,
+      (gsize) self->delay_frames * self->n_unpaired * self->delay_width);
+  viperfx_aligned_free (self->delay_line);
+  self->delay_line = NULL;
+  self->delay_frames = 0;
+  self->delay_pos = 0;
+  self->n_unpaired = 0;
+
+  for (i = 0; i < self->n_pairs; i++) {
+    paired[self->pairs[i].left] = TRUE;
+    paired[self->pairs[i].right] = TRUE;
+  }
+  for (ch = 0; ch < channels; ch++) {
+    if (!paired[ch])
+      self->unpaired[self->n_unpaired++] = ch;
+  }
+  if (frames == 0 || self->n_unpaired == 0)
+    return TRUE;
+
+  self->delay_width = GST_AUDIO_INFO_WIDTH (info) / 8;
+  size = (gsize) frames * self->n_unpaired * self->delay_width;
+  self->delay_line = viperfx_aligned_alloc (size);
+  if (self->delay_line == NULL) {
+    GST_ERROR_OBJECT (self, "failed to allocate %u frames of delay", frames);
+    return FALSE;
+  }
+  memset (self->delay_line, 0, size);
+  self->delay_frames = frames;
+  GST_DEBUG_OBJECT (self, "%u unpaired channels delayed by %u frames",
+      self->n_unpaired, frames);
+  return TRUE;
+}
+
+/* the unpaired channels of data through the delay line, in place
+ */
+static void
+gst_viperfx_delay_unpaired (Gstviperfx *self, guint8 *data, guint num_frames)
+{
+  gsize bpf = GST_AUDIO_FILTER_BPF (self);
+  guint width = self->delay_width;
+  guint n = self->n_unpaired;
+  guint i, c;
+
+  for (i = 0; i < num_frames; i++) {
+    guint8 *slot = self->delay_line + (gsize) self->delay_pos * n * width;
+    guint8 *frame = data + i * bpf;
+    guint8 held[4];
+
+    for (c = 0; c < n; c++) {
+      guint8 *sample = frame + self->unpaired[c] * width;
+
+      memcpy (held, slot + c * width, width);
+      memcpy (slot + c * width, sample, width);
+      memcpy (sample, held, width);
     }
-    break;
+    if (++self->delay_pos == self->delay_frames)
+      self->delay_pos = 0;
+  }
+}
+
+/* delay the element adds on top of the core, posts a latency message
+ * when it changed so the pipeline asks again
+ */
+static void
+gst_viperfx_update_latency (Gstviperfx *self, gint sample_rate)
+{
+  GstClockTime latency = 0;
+  guint frames = gst_viperfx_delay_frames (self);
+  gboolean changed;
+
+  if (self->n_pairs > 0)
+    latency = gst_util_uint64_scale_int (frames, GST_SECOND, sample_rate);
+  // delayed output of the last audio has to be out before skipping
+  self->silence_hold = gst_util_uint64_scale_int (SILENCE_HOLD, sample_rate,
+      GST_SECOND) + frames;
+  self->quiet_frames = 0;
+
+  GST_OBJECT_LOCK (self);
+  changed = (latency != self->latency);
+  self->latency = latency;
+  GST_OBJECT_UNLOCK (self);
+
+  if (changed) {
+    GST_DEBUG_OBJECT (self, "latency now %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (latency));
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_latency (GST_OBJECT (self)));
+  }
+}
+
+/* GstBaseTransform vmethod implementations */
+
+static gboolean
+gst_viperfx_setup (GstAudioFilter * base, const GstAudioInfo * info)
+{
+  Gstviperfx *self = GST_VIPERFX (base);
+  gint sample_rate = 0;
+  guint i, n_pairs, factor;
+  gchar ir_path[256];
+  GBytes *ir_data;
+
+  if (self->cores[0] == NULL)
+    return FALSE;
+
+  if (info == NULL)
+    info = GST_AUDIO_FILTER_INFO (self);
 
-    case PROP_CURE_LEVEL:
+  sample_rate = GST_AUDIO_INFO_RATE (info);
+  if (sample_rate <= 0)
+    return FALSE;
+
+  factor = viperfx_resample_factor (sample_rate, CORE_MIN_RATE);
+  if (factor > 1 && !g_atomic_int_get (&self->resample)) {
+    GST_WARNING_OBJECT (self, "%d Hz needs resampling, which is disabled",
+        sample_rate);
+    return FALSE;
+  }
+
+  n_pairs = gst_viperfx_map_pairs (self, info);
+  GST_DEBUG_OBJECT (self, "current sample_rate = %d, %d channels in %u pairs",
+      sample_rate, GST_AUDIO_INFO_CHANNELS (info), n_pairs);
+
+  // the cores are owned by the streaming thread, no locking needed here.
+  // a transition still running is cut short, the stream starts over
+  gst_viperfx_end_fade (self);
+  // its buffers were made for the old caps
+  gst_viperfx_clear_out_pool (self);
+  self->shadow_requested = FALSE;
+  while (self->n_cores < n_pairs) {
+    viperfx_interface *vfx = gst_viperfx_create_core (self);
+    if (vfx == NULL) {
+      GST_ERROR_OBJECT (self, "failed to create core for pair %u",
+          self->n_cores);
+      return FALSE;
+    }
+    self->cores[self->n_cores++] = vfx;
+  }
+  for (i = 0; i < self->n_cores; i++) {
+    if (!self->cores[i]->set_samplerate (self->cores[i],
+        sample_rate * factor))
+      return FALSE;
+    if (!self->cores[i]->set_channels (self->cores[i], 2))
+      return FALSE;
+    self->cores[i]->reset (self->cores[i]);
+  }
+
+  // caps negotiation, not the realtime path, waiting for the lock and
+  // loading a pending impulse response right here is fine
+  g_mutex_lock (&self->lock);
+  self->core_rate = sample_rate * factor;
+  self->core_count = self->n_cores;
+  self->core_generation++;
+  gst_viperfx_ir_source (self, ir_path, &ir_data);
+  // cores prepared for the old setup are of no use any more
+  gst_viperfx_free_ir_set (self->ir_prepared);
+  self->ir_prepared = NULL;
+  g_mutex_unlock (&self->lock);
+  // kernels are resampled to the core rate, so all cores get it again
+  if (ir_path[0] != '\0' || self->ir_loaded[0] != '\0')
+    gst_viperfx_send_ir (self, self->cores, self->n_cores, ir_path,
+        ir_data, sample_rate * factor);
+  if (ir_data != NULL)
+    g_bytes_unref (ir_data);
+  if (strcmp (ir_path, self->ir_loaded) != 0) {
+    g_strlcpy (self->ir_loaded, ir_path, sizeof(self->ir_loaded));
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_element (GST_OBJECT (self),
+            gst_structure_new ("viperfx-ir-loaded",
+                "path", G_TYPE_STRING, ir_path, NULL)));
+  }
+
+  self->n_pairs = n_pairs;
+  self->stereo = (GST_AUDIO_INFO_CHANNELS (info) == 2 && n_pairs == 1 &&
+      self->pairs[0].left == 0 && self->pairs[0].right == 1);
+
+  // preallocate conversion space for typical buffer sizes
+  if (!self->stereo) {
+    if (!gst_viperfx_ensure_pair_buffers (self, DEFAULT_SCRATCH_FRAMES))
+      return FALSE;
+  } else if (GST_AUDIO_INFO_FORMAT (info) != GST_AUDIO_FORMAT_S16) {
+    if (!gst_viperfx_ensure_scratch (self, DEFAULT_SCRATCH_FRAMES * 2))
+      return FALSE;
+  }
+
+  if (!gst_viperfx_setup_resamplers (self, factor))
+    return FALSE;
+  if (!gst_viperfx_setup_blocks (self,
+          (guint) g_atomic_int_get (&self->block_size)))
+    return FALSE;
+  if (!gst_viperfx_setup_fades (self))
+    return FALSE;
+  if (!gst_viperfx_setup_delay (self, info))
+    return FALSE;
+  if (factor > 1) {
+    GST_DEBUG_OBJECT (self, "core runs at %d Hz, resampling by %u",
+        sample_rate * factor, factor);
+  }
+  gst_viperfx_update_latency (self, sample_rate);
+
+  gst_viperfx_setup_workers (self);
+
+  // renegotiated while playing, the new buffers are locked too
+  if (self->realtime_locked)
+    gst_viperfx_realtime_lock_buffers (self);
+
+  return TRUE;
+}
+
+/* back to the start of a stream, nothing from before may come out of
+ * the cores, resamplers, block adapters or delay lines. no buffer is in
+ * flight
+ */
+static void
+gst_viperfx_reset_stream (Gstviperfx *self)
+{
+  guint i;
+
+  gst_viperfx_end_fade (self);
+  for (i = 0; i < self->n_cores; i++)
+    self->cores[i]->reset (self->cores[i]);
+  for (i = 0; i < GST_VIPERFX_MAX_PAIRS; i++) {
+    if (self->pairs[i].resampler != NULL)
+      viperfx_resampler_reset (self->pairs[i].resampler);
+  }
+  gst_viperfx_setup_blocks (self, self->block_frames);
+  if (self->delay_line != NULL) {
+    memset (self->delay_line, 0,
+        (gsize) self->delay_frames * self->n_unpaired * self->delay_width);
+    self->delay_pos = 0;
+  }
+  self->quiet_frames = 0;
+  self->next_pts = GST_CLOCK_TIME_NONE;
+  self->drain_pending = FALSE;
+}
+
+/* at EOS, silence through the cores until the last frames of the stream
+ * are out of the block adapters and resamplers, pushed ahead of the EOS
+ */
+static GstFlowReturn
+gst_viperfx_drain (Gstviperfx *self)
+{
+  guint frames = gst_viperfx_delay_frames (self);
+  gint rate = GST_AUDIO_FILTER_RATE (self);
+  guint bpf = GST_AUDIO_FILTER_BPF (self);
+  GstBuffer *buf;
+  GstMapInfo map;
+  gboolean ok;
+
+  if (!self->drain_pending || frames == 0 || rate <= 0)
+    return GST_FLOW_OK;
+  self->drain_pending = FALSE;
+
+  buf = gst_buffer_new_allocate (NULL, (gsize) frames * bpf, NULL);
+  if (buf == NULL || !gst_buffer_map (buf, &map, GST_MAP_WRITE)) {
+    if (buf != NULL)
+      gst_buffer_unref (buf);
+    GST_WARNING_OBJECT (self, "no buffer to drain %u frames into", frames);
+    return GST_FLOW_ERROR;
+  }
+  memset (map.data, 0, map.size);
+  self->measure_peak = FALSE;
+  ok = gst_viperfx_process (self, map.data, map.data, frames);
+  gst_buffer_unmap (buf, &map);
+  if (!ok) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
+  GST_BUFFER_PTS (buf) = self->next_pts;
+  GST_BUFFER_DURATION (buf) =
+      gst_util_uint64_scale_int (frames, GST_SECOND, rate);
+  GST_DEBUG_OBJECT (self, "draining %u frames at %" GST_TIME_FORMAT, frames,
+      GST_TIME_ARGS (self->next_pts));
+  return gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (self), buf);
+}
+
+static gboolean
+gst_viperfx_sink_event (GstBaseTransform * base, GstEvent * event)
+{
+  Gstviperfx *self = GST_VIPERFX (base);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      // the stream goes on somewhere else, what's held is from before
+      gst_viperfx_reset_stream (self);
+      break;
+    case GST_EVENT_EOS:
     {
-      g_mutex_lock (&self->lock);
-      self->cure_level = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_CURE_CROSSFEED, self->cure_level);
-      g_mutex_unlock (&self->lock);
+      gboolean ret;
+
+      gst_viperfx_drain (self);
+      ret = GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (base, event);
+      // nothing follows on this thread, see gst_viperfx_chain
+      gst_viperfx_realtime_restore (self);
+      return ret;
     }
-    break;
+    default:
+      break;
+  }
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (base, event);
+}
 
-    case PROP_TUBE_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->tube_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_TUBE_PROCESS_ENABLED, self->tube_enabled);
-      g_mutex_unlock (&self->lock);
+/* basetransform's chain, and the end of a realtime run after it: the
+ * profile was turned off, the element left PLAYING, or the thread goes
+ * back to its task because pushing failed. a run that stops while a
+ * push blocks ends here as the flush unblocks it
+ */
+static GstFlowReturn
+gst_viperfx_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  Gstviperfx *self = GST_VIPERFX (parent);
+  GstFlowReturn ret;
+
+  ret = self->sink_chain (pad, parent, buf);
+  if (G_UNLIKELY (self->realtime_applied) && (ret != GST_FLOW_OK ||
+          g_atomic_int_get (&self->realtime_leaving) ||
+          !g_atomic_int_get (&self->realtime_profile)))
+    gst_viperfx_realtime_restore (self);
+  return ret;
+}
+
+/* without resampling, rates below the core minimum are refused when caps
+ * are negotiated rather than by setup
+ */
+static GstCaps *
+gst_viperfx_transform_caps (GstBaseTransform * base,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+{
+  Gstviperfx *self = GST_VIPERFX (base);
+  GstCaps *result, *core_rates, *narrowed;
+
+  result = GST_BASE_TRANSFORM_CLASS (parent_class)->transform_caps (base,
+      direction, caps, filter);
+  if (result == NULL || g_atomic_int_get (&self->resample))
+    return result;
+
+  core_rates = gst_caps_new_simple ("audio/x-raw",
+      "rate", GST_TYPE_INT_RANGE, CORE_MIN_RATE, G_MAXINT, NULL);
+  narrowed = gst_caps_intersect (result, core_rates);
+  gst_caps_unref (core_rates);
+  gst_caps_unref (result);
+  return narrowed;
+}
+
+static gboolean
+gst_viperfx_stop (GstBaseTransform * base)
+{
+  Gstviperfx *self = GST_VIPERFX (base);
+
+  // streaming has stopped, nothing else touches the cores
+  gst_viperfx_reset_stream (self);
+
+  // bindings may have changed while stopped
+  gst_viperfx_clear_bindings (self);
+  gst_viperfx_realtime_unlock_buffers (self);
+  self->input = NULL;
+  gst_viperfx_clear_out_pool (self);
+
+  // the next run starts with a clean deadline monitor
+  self->load = 0.0;
+  g_atomic_int_set (&self->load_permille, 0);
+  self->load_level = LOAD_LEVEL_NORMAL;
+  self->overruns = 0;
+  self->overrun_posted = GST_CLOCK_TIME_NONE;
+
+  return TRUE;
+}
+
+/* bytes per buffer of a pool for info
+ */
+static guint
+gst_viperfx_pool_size (const GstAudioInfo * info)
+{
+  guint frames = (guint) gst_util_uint64_scale_int (POOL_BUFFER_TIME,
+      GST_AUDIO_INFO_RATE (info), GST_SECOND);
+
+  return MAX (frames, DEFAULT_SCRATCH_FRAMES) * GST_AUDIO_INFO_BPF (info);
+}
+
+/* a pool of size byte buffers aligned for the widest vector loads
+ */
+static GstBufferPool *
+gst_viperfx_new_pool (GstCaps * caps, guint size)
+{
+  GstBufferPool *pool = gst_buffer_pool_new ();
+  GstStructure *config = gst_buffer_pool_get_config (pool);
+  GstAllocationParams params;
+
+  gst_allocation_params_init (&params);
+  params.align = VIPERFX_KERNEL_ALIGN - 1;
+  gst_buffer_pool_config_set_params (config, caps, size, 0, 0);
+  gst_buffer_pool_config_set_allocator (config, NULL, &params);
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    gst_object_unref (pool);
+    return NULL;
+  }
+  return pool;
+}
+
+/* buffers still out keep the pool alive until they come back
+ */
+static void
+gst_viperfx_clear_out_pool (Gstviperfx *self)
+{
+  if (self->out_pool == NULL)
+    return;
+  gst_buffer_pool_set_active (self->out_pool, FALSE);
+  gst_object_unref (self->out_pool);
+  self->out_pool = NULL;
+  self->out_pool_size = 0;
+}
+
+/* an active out_pool with room for size bytes, made again for a bigger
+ * buffer, which only happens when upstream grows its buffers
+ */
+static gboolean
+gst_viperfx_ensure_out_pool (Gstviperfx *self, gsize size)
+{
+  GstCaps *caps;
+  guint pool_size;
+
+  if (G_LIKELY (self->out_pool != NULL && size <= self->out_pool_size))
+    return TRUE;
+
+  gst_viperfx_clear_out_pool (self);
+  pool_size = MAX ((guint) size,
+      gst_viperfx_pool_size (GST_AUDIO_FILTER_INFO (self)));
+  caps = gst_audio_info_to_caps (GST_AUDIO_FILTER_INFO (self));
+  self->out_pool = gst_viperfx_new_pool (caps, pool_size);
+  gst_caps_unref (caps);
+  if (self->out_pool == NULL ||
+      !gst_buffer_pool_set_active (self->out_pool, TRUE)) {
+    GST_WARNING_OBJECT (self, "no output pool for %u byte buffers", pool_size);
+    gst_viperfx_clear_out_pool (self);
+    return FALSE;
+  }
+  GST_DEBUG_OBJECT (self, "output pool of %u byte buffers", pool_size);
+  self->out_pool_size = pool_size;
+  return TRUE;
+}
+
+/* upstream gets downstream's answer, as from any in place transform,
+ * with the alignment raised for vector loads. without a pool from
+ * downstream it gets an aligned one sized for the caps
+ */
+static gboolean
+gst_viperfx_propose_allocation (GstBaseTransform * base,
+    GstQuery * decide_query, GstQuery * query)
+{
+  GstAllocationParams params;
+  GstAllocator *allocator;
+  GstBufferPool *pool;
+  GstAudioInfo info;
+  GstCaps *caps;
+  gboolean need_pool;
+  guint i, n, size;
+
+  // a downstream that doesn't answer is no reason to refuse
+  GST_BASE_TRANSFORM_CLASS (parent_class)->propose_allocation (base,
+      decide_query, query);
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+  if (caps == NULL || !gst_audio_info_from_caps (&info, caps))
+    return FALSE;
+
+  n = gst_query_get_n_allocation_params (query);
+  for (i = 0; i < n; i++) {
+    gst_query_parse_nth_allocation_param (query, i, &allocator, &params);
+    if (params.align < VIPERFX_KERNEL_ALIGN - 1) {
+      params.align = VIPERFX_KERNEL_ALIGN - 1;
+      gst_query_set_nth_allocation_param (query, i, allocator, &params);
     }
-    break;
+    if (allocator != NULL)
+      gst_object_unref (allocator);
+  }
+  if (n == 0) {
+    gst_allocation_params_init (&params);
+    params.align = VIPERFX_KERNEL_ALIGN - 1;
+    gst_query_add_allocation_param (query, NULL, &params);
+  }
+
+  // downstream's memory is where the audio ends up, it stays first
+  if (gst_query_get_n_allocation_pools (query) > 0)
+    return TRUE;
+
+  size = gst_viperfx_pool_size (&info);
+  pool = gst_viperfx_new_pool (caps, size);
+  if (pool == NULL)
+    return TRUE;
+  GST_DEBUG_OBJECT (base, "proposing a pool of %u byte buffers", size);
+  gst_query_add_allocation_pool (query, pool, size, 0, 0);
+  gst_object_unref (pool);
+  return TRUE;
+}
+
+/* a buffer upstream still holds, or with read-only memory, would be
+ * copied whole before transform_ip. it gets a buffer of out_pool instead
+ * and transform_ip has the cores read the input where it is
+ */
+static GstFlowReturn
+gst_viperfx_prepare_output_buffer (GstBaseTransform * base,
+    GstBuffer * inbuf, GstBuffer ** outbuf)
+{
+  Gstviperfx *self = GST_VIPERFX (base);
+  GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS (base);
+  gsize size = gst_buffer_get_size (inbuf);
+  GstFlowReturn ret;
+
+  self->input = NULL;
+  if (gst_base_transform_is_passthrough (base) ||
+      (gst_buffer_is_writable (inbuf) &&
+          gst_buffer_is_all_memory_writable (inbuf)) ||
+      !gst_viperfx_ensure_out_pool (self, size))
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->prepare_output_buffer (
+        base, inbuf, outbuf);
+
+  ret = gst_buffer_pool_acquire_buffer (self->out_pool, outbuf, NULL);
+  if (ret != GST_FLOW_OK)
+    return ret;
+  gst_buffer_set_size (*outbuf, size);
+  if (klass->copy_metadata != NULL &&
+      !klass->copy_metadata (base, inbuf, *outbuf)) {
+    GST_ELEMENT_WARNING (self, STREAM, NOT_IMPLEMENTED,
+        ("could not copy metadata"), (NULL));
+  }
+  self->input = inbuf;
+  return GST_FLOW_OK;
+}
+
+/* the realtime profile is applied by the streaming thread itself, with
+ * the first buffer once PLAYING, and put back by it once no longer
+ */
+static GstStateChangeReturn
+gst_viperfx_change_state (GstElement * element, GstStateChange transition)
+{
+  Gstviperfx *self = GST_VIPERFX (element);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_PLAYING) {
+    g_atomic_int_set (&self->realtime_leaving, 0);
+    if (g_atomic_int_get (&self->realtime_profile))
+      g_atomic_int_set (&self->realtime_pending, 1);
+  } else if (transition == GST_STATE_CHANGE_PLAYING_TO_PAUSED) {
+    // the streaming thread puts its scheduling back, see gst_viperfx_chain
+    g_atomic_int_set (&self->realtime_pending, 0);
+    g_atomic_int_set (&self->realtime_leaving, 1);
+  }
+
+  return GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+}
+
+/* add our own delay to whatever upstream reports
+ */
+static gboolean
+gst_viperfx_query (GstBaseTransform * base, GstPadDirection direction,
+    GstQuery * query)
+{
+  Gstviperfx *self = GST_VIPERFX (base);
+  gboolean live;
+  GstClockTime min, max, latency;
 
-    case PROP_AX_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->ax_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_ANALOGX_PROCESS_ENABLED, self->ax_enabled);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  if (!GST_BASE_TRANSFORM_CLASS (parent_class)->query (base, direction, query))
+    return FALSE;
 
-    case PROP_AX_MODE:
-    {
-      g_mutex_lock (&self->lock);
-      self->ax_mode = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_ANALOGX_MODE, self->ax_mode);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  if (direction == GST_PAD_SRC && GST_QUERY_TYPE (query) == GST_QUERY_LATENCY) {
+    GST_OBJECT_LOCK (self);
+    latency = self->latency;
+    GST_OBJECT_UNLOCK (self);
 
-    case PROP_FETCOMP_ENABLE:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_enabled = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_PROCESS_ENABLED, self->fetcomp_enabled);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+    gst_query_parse_latency (query, &live, &min, &max);
+    min += latency;
+    if (GST_CLOCK_TIME_IS_VALID (max))
+      max += latency;
+    gst_query_set_latency (query, live, min, max);
+  }
 
-    case PROP_FETCOMP_THRESHOLD:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_threshold = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_THRESHOLD, self->fetcomp_threshold);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  return TRUE;
+}
 
-    case PROP_FETCOMP_RATIO:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_ratio = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_RATIO, self->fetcomp_ratio);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* timestamps for the tracer, nothing to pay when nobody is timing */
+static inline GstClockTime
+gst_viperfx_now (viperfx_stats *stats)
+{
+  return G_UNLIKELY (stats != NULL) ? gst_util_get_timestamp () : 0;
+}
 
-    case PROP_FETCOMP_KNEEWIDTH:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_kneewidth = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_KNEEWIDTH, self->fetcomp_kneewidth);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* plain stereo, cores[0] processes the stream in place
+ */
+static gboolean
+gst_viperfx_process_stereo (Gstviperfx *self, const guint8 *in, guint8 *data,
+    guint num_frames)
+{
+  GstAudioFormat format = GST_AUDIO_FILTER_FORMAT (self);
+  guint num_samples = num_frames * 2;
+  viperfx_stats *stats = g_atomic_pointer_get (&self->stats);
+  GstClockTime t0, t1, t2;
+  short *pcm_data;
 
-    case PROP_FETCOMP_AUTOKNEE:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_autoknee = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_AUTOKNEE_ENABLED, self->fetcomp_autoknee);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  t0 = gst_viperfx_now (stats);
 
-    case PROP_FETCOMP_GAIN:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_gain = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_GAIN, self->fetcomp_gain);
-      g_mutex_unlock (&self->lock);
+  // bring the samples into the s16 domain of the core
+  if (format == GST_AUDIO_FORMAT_S16) {
+    pcm_data = (short *)(data);
+    self->kernels->headroom_s16 ((const short *)(in), pcm_data, num_samples);
+  } else {
+    if (!gst_viperfx_ensure_scratch (self, num_samples))
+      return FALSE;
+    pcm_data = self->scratch;
+    if (format == GST_AUDIO_FORMAT_F32) {
+      self->kernels->f32_to_s16_headroom (
+          (const float *)(in), pcm_data, num_samples);
+    } else {
+      self->kernels->s32_to_s16_headroom (
+          (const int32_t *)(in), pcm_data, num_samples);
     }
-    break;
+  }
 
-    case PROP_FETCOMP_AUTOGAIN:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_autogain = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_AUTOGAIN_ENABLED, self->fetcomp_autogain);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  t1 = gst_viperfx_now (stats);
+  gst_viperfx_run_pair (self, 0, pcm_data, num_frames);
+  t2 = gst_viperfx_now (stats);
 
-    case PROP_FETCOMP_ATTACK:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_attack = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_ATTACK, self->fetcomp_attack);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  // and back to the level of the input
+  self->kernels->makeup_s16 (pcm_data, pcm_data, num_samples);
+  if (G_UNLIKELY (self->measure_peak)) {
+    self->pairs[0].peak = MAX (self->pairs[0].peak,
+        self->kernels->peak_s16 (pcm_data, num_samples));
+  }
+  if (format == GST_AUDIO_FORMAT_F32) {
+    self->kernels->s16_to_f32 (pcm_data,
+        (float *)(data), num_samples);
+  } else if (format == GST_AUDIO_FORMAT_S32) {
+    self->kernels->s16_to_s32 (pcm_data,
+        (int32_t *)(data), num_samples);
+  }
 
-    case PROP_FETCOMP_AUTOATTACK:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_autoattack = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_AUTOATTACK_ENABLED, self->fetcomp_autoattack);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  if (G_UNLIKELY (stats != NULL)) {
+    viperfx_stats_record (stats, VIPERFX_STAT_PROCESS, t2 - t1);
+    viperfx_stats_record (stats, VIPERFX_STAT_CONVERT,
+        (t1 - t0) + (gst_viperfx_now (stats) - t2));
+  }
+  return TRUE;
+}
 
-    case PROP_FETCOMP_RELEASE:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_release = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_RELEASE, self->fetcomp_release);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* multichannel, every pair goes through its own core, the extra pairs
+ * on the workers while the streaming thread does the first one
+ */
+static gboolean
+gst_viperfx_process_pairs (Gstviperfx *self, const guint8 *in, guint8 *data,
+    guint num_frames)
+{
+  guint i;
+
+  // unpaired channels pass, into a separate output they have to be copied
+  if (in != data && self->n_pairs * 2 < (guint) GST_AUDIO_FILTER_CHANNELS (self))
+    memcpy (data, in, (gsize) num_frames * GST_AUDIO_FILTER_BPF (self));
+  if (self->delay_line != NULL)
+    gst_viperfx_delay_unpaired (self, data, num_frames);
+  if (self->n_pairs == 0)
+    return TRUE;
+  if (!gst_viperfx_ensure_pair_buffers (self, num_frames))
+    return FALSE;
 
-    case PROP_FETCOMP_AUTORELEASE:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_autorelease = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_AUTORELEASE_ENABLED, self->fetcomp_autorelease);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  self->job_in = in;
+  self->job_data = data;
+  self->job_frames = num_frames;
 
-    case PROP_FETCOMP_META_KNEEMULTI:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_meta_kneemulti = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_META_KNEEMULTI, self->fetcomp_meta_kneemulti);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  if (self->workers == NULL || num_frames < PARALLEL_MIN_FRAMES) {
+    for (i = 0; i < self->n_pairs; i++)
+      gst_viperfx_process_pair (self, i);
+    return TRUE;
+  }
 
-    case PROP_FETCOMP_META_MAXATTACK:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_meta_maxattack = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_META_MAXATTACK, self->fetcomp_meta_maxattack);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  g_atomic_int_set (&self->pending, self->n_pairs - 1);
+  for (i = 1; i < self->n_pairs; i++)
+    g_thread_pool_push (self->workers, GUINT_TO_POINTER (i + 1), NULL);
 
-    case PROP_FETCOMP_META_MAXRELEASE:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_meta_maxrelease = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_META_MAXRELEASE, self->fetcomp_meta_maxrelease);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  gst_viperfx_process_pair (self, 0);
 
-    case PROP_FETCOMP_META_CREST:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_meta_crest = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_META_CREST, self->fetcomp_meta_crest);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  g_mutex_lock (&self->done_lock);
+  while (g_atomic_int_get (&self->pending) != 0)
+    g_cond_wait (&self->done_cond, &self->done_lock);
+  g_mutex_unlock (&self->done_lock);
 
-    case PROP_FETCOMP_META_ADAPT:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_meta_adapt = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_META_ADAPT, self->fetcomp_meta_adapt);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  return TRUE;
+}
 
-    case PROP_FETCOMP_NOCLIP:
-    {
-      g_mutex_lock (&self->lock);
-      self->fetcomp_noclip = g_value_get_boolean (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_FETCOMP_META_NOCLIP_ENABLED, self->fetcomp_noclip);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+static const gchar *
+gst_viperfx_load_level_name (gint level)
+{
+  switch (level) {
+    case LOAD_LEVEL_WARNING:
+      return "warning";
+    case LOAD_LEVEL_CRITICAL:
+      return "critical";
+    default:
+      return "normal";
+  }
+}
 
-    case PROP_OUT_VOLUME:
-    {
-      g_mutex_lock (&self->lock);
-      self->out_volume = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_OUTPUT_VOLUME, self->out_volume);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* which level a load is at, levels only clear once the load has
+ * dropped LOAD_HYSTERESIS below their threshold
+ */
+static gint
+gst_viperfx_load_level (Gstviperfx *self, gdouble load)
+{
+  guint warning = (guint) g_atomic_int_get (&self->load_warning);
+  guint critical = (guint) g_atomic_int_get (&self->load_critical);
+  gint level = LOAD_LEVEL_NORMAL;
+
+  if (critical > 0) {
+    if (load >= critical || (self->load_level == LOAD_LEVEL_CRITICAL &&
+            load >= (gdouble) critical - LOAD_HYSTERESIS))
+      return LOAD_LEVEL_CRITICAL;
+  }
+  if (warning > 0) {
+    if (load >= warning || (self->load_level >= LOAD_LEVEL_WARNING &&
+            load >= (gdouble) warning - LOAD_HYSTERESIS))
+      level = LOAD_LEVEL_WARNING;
+  }
+  return level;
+}
 
-    case PROP_OUT_PAN:
-    {
-      g_mutex_lock (&self->lock);
-      self->out_pan = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_OUTPUT_PAN, self->out_pan);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+/* compare the time a buffer took with the time it plays for
+ * streaming thread only, messages are the only allocations
+ */
+static void
+gst_viperfx_monitor (Gstviperfx *self, GstClockTime start,
+    guint num_frames, GstClockTime timestamp)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  GstClockTime elapsed = now - start;
+  GstClockTime duration;
+  gdouble alpha, load;
+  gint level;
+
+  if (num_frames == 0 || GST_AUDIO_FILTER_RATE (self) <= 0)
+    return;
+  duration = gst_util_uint64_scale_int (num_frames, GST_SECOND,
+      GST_AUDIO_FILTER_RATE (self));
+
+  // weighted by audio time so the buffer size doesn't change the window
+  load = 100.0 * elapsed / duration;
+  alpha = (gdouble) duration / (duration + LOAD_TIME_CONSTANT);
+  self->load += alpha * (load - self->load);
+  g_atomic_int_set (&self->load_permille, (gint)(self->load * 10.0));
+
+  level = gst_viperfx_load_level (self, self->load);
+  if (level != self->load_level) {
+    GST_INFO_OBJECT (self, "load %.1f%%, now %s", self->load,
+        gst_viperfx_load_level_name (level));
+    self->load_level = level;
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_element (GST_OBJECT (self),
+            gst_structure_new ("viperfx-load",
+                "level", G_TYPE_STRING, gst_viperfx_load_level_name (level),
+                "load", G_TYPE_DOUBLE, self->load,
+                NULL)));
+  }
 
-    case PROP_LIM_THRESHOLD:
-    {
-      g_mutex_lock (&self->lock);
-      self->lim_threshold = g_value_get_int (value);
-      viperfx_command_set_px4_vx4x1 (self->vfx,
-          PARAM_HPFX_LIMITER_THRESHOLD, self->lim_threshold);
-      g_mutex_unlock (&self->lock);
-    }
-    break;
+  if (elapsed <= duration || !g_atomic_int_get (&self->report_overruns))
+    return;
+
+  self->overruns++;
+  if (GST_CLOCK_TIME_IS_VALID (self->overrun_posted) &&
+      now - self->overrun_posted < OVERRUN_MESSAGE_INTERVAL)
+    return;
+
+  GST_DEBUG_OBJECT (self, "buffer took %" GST_TIME_FORMAT " for %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (elapsed), GST_TIME_ARGS (duration));
+  gst_element_post_message (GST_ELEMENT (self),
+      gst_message_new_element (GST_OBJECT (self),
+          gst_structure_new ("viperfx-overrun",
+              "elapsed", G_TYPE_UINT64, elapsed,
+              "duration", G_TYPE_UINT64, duration,
+              "timestamp", G_TYPE_UINT64, timestamp,
+              "count", G_TYPE_UINT, self->overruns,
+              NULL)));
+  self->overruns = 0;
+  self->overrun_posted = now;
+}
 
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
+/* drop the bindings looked up last
+ */
+static void
+gst_viperfx_clear_bindings (Gstviperfx *self)
+{
+  guint i;
+
+  for (i = 0; i < self->n_bound; i++) {
+    gst_object_unref (self->bindings[i]);
+    self->bindings[i] = NULL;
   }
+  self->n_bound = 0;
+  self->control_refresh = GST_CLOCK_TIME_NONE;
 }
 
+/* which parameters are bound. sampling them directly skips the
+ * set_property round trip gst_object_sync_values makes for each
+ */
 static void
-gst_viperfx_get_property (GObject * object, guint prop_id,
-    GValue * value, GParamSpec * pspec)
+gst_viperfx_refresh_bindings (Gstviperfx *self)
 {
-  Gstviperfx *self = GST_VIPERFX (object);
+  guint idx;
 
-  switch (prop_id) {
+  gst_viperfx_clear_bindings (self);
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++) {
+    GstControlBinding *binding = gst_object_get_control_binding (
+        GST_OBJECT (self), viperfx_params[idx].name);
 
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
+    if (binding == NULL)
+      continue;
+    self->bindings[self->n_bound] = binding;
+    self->bound[self->n_bound++] = idx;
   }
 }
 
-/* GstBaseTransform vmethod implementations */
+/* controlled parameters at a stream time into the store, values that
+ * didn't change leave it clean
+ */
+static void
+gst_viperfx_sample_controls (Gstviperfx *self, GstClockTime timestamp)
+{
+  guint i;
+
+  for (i = 0; i < self->n_bound; i++) {
+    GValue value = G_VALUE_INIT;
+
+    if (gst_control_binding_is_disabled (self->bindings[i]))
+      continue;
+    if (gst_control_binding_get_g_value_array (self->bindings[i],
+            timestamp, 0, 1, &value))
+      viperfx_param_store_set (&self->params, self->bound[i], &value);
+    if (G_IS_VALUE (&value))
+      g_value_unset (&value);
+  }
+}
+
+/* the values at the start of a buffer, bindings looked up again when
+ * they are due
+ */
+static void
+gst_viperfx_sync_controls (Gstviperfx *self, GstClockTime stream_time)
+{
+  if (!gst_object_has_active_control_bindings (GST_OBJECT (self))) {
+    if (self->n_bound > 0)
+      gst_viperfx_clear_bindings (self);
+    return;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (self->control_refresh) ||
+      stream_time < self->control_refresh ||
+      stream_time - self->control_refresh >= CONTROL_REFRESH) {
+    gst_viperfx_refresh_bindings (self);
+    self->control_refresh = stream_time;
+  }
+  gst_viperfx_sample_controls (self, stream_time);
+}
 
+/* whether buffers can skip the element altogether. only when the cores
+ * would leave the audio alone and the element adds no delay of its own,
+ * which would otherwise be cut off or repeated at the switch. neutral
+ * processing gives the input back to the LSB, so switching on a buffer
+ * boundary needs no fade
+ */
 static gboolean
-gst_viperfx_setup (GstAudioFilter * base, const GstAudioInfo * info)
+gst_viperfx_can_bypass (Gstviperfx *self)
+{
+  return self->block_frames == 0 && self->resample_factor == 1 &&
+      self->fading[0] == NULL && viperfx_param_store_neutral (&self->params);
+}
+
+/* runs for every buffer, passthrough or not. controlled values and
+ * queued commands go to the cores here, then the buffer either takes
+ * the transform_ip path or goes by unmapped and untouched
+ */
+static void
+gst_viperfx_before_transform (GstBaseTransform * base, GstBuffer * buf)
 {
   Gstviperfx *self = GST_VIPERFX (base);
-  gint sample_rate = 0;
+  viperfx_stats *stats = g_atomic_pointer_get (&self->stats);
+  GstClockTime stream_time, t0;
+  gboolean bypass;
+  guint i;
 
-  if (self->vfx == NULL)
-    return FALSE;
+  if (G_UNLIKELY (g_atomic_int_get (&self->realtime_pending)) &&
+      g_atomic_int_compare_and_exchange (&self->realtime_pending, 1, 0))
+    gst_viperfx_realtime_apply (self);
 
-  if (info) {
-    sample_rate = GST_AUDIO_INFO_RATE (info);
-  } else {
-    sample_rate = GST_AUDIO_FILTER_RATE (self);
+  stream_time = gst_segment_to_stream_time (&base->segment, GST_FORMAT_TIME,
+      GST_BUFFER_TIMESTAMP (buf));
+  if (GST_CLOCK_TIME_IS_VALID (stream_time))
+    gst_viperfx_sync_controls (self, stream_time);
+
+  t0 = gst_viperfx_now (stats);
+  gst_viperfx_drain_commands (self);
+  if (G_UNLIKELY (stats != NULL)) {
+    viperfx_stats_record (stats, VIPERFX_STAT_COMMANDS,
+        gst_viperfx_now (stats) - t0);
   }
-  if (sample_rate <= 0)
-    return FALSE;
 
-  GST_DEBUG_OBJECT (self, "current sample_rate = %d", sample_rate);
+  bypass = gst_viperfx_can_bypass (self);
+  if (G_LIKELY (bypass == self->bypass))
+    return;
 
-  g_mutex_lock (&self->lock);
-  if (!self->vfx->set_samplerate (self->vfx, sample_rate)) {
-    g_mutex_unlock (&self->lock);
-    return FALSE;
-  }
-  if (!self->vfx->set_channels (self->vfx, 2)) {
-    g_mutex_unlock (&self->lock);
-    return FALSE;
+  // the cores have not seen the bypassed audio, nothing of what they
+  // still hold from before belongs after it
+  if (!bypass) {
+    for (i = 0; i < self->n_cores; i++)
+      self->cores[i]->reset (self->cores[i]);
   }
-  self->vfx->reset (self->vfx);
-  g_mutex_unlock (&self->lock);
-
-  return TRUE;
+  GST_DEBUG_OBJECT (self, "%s at %" GST_TIME_FORMAT,
+      bypass ? "bypassing" : "processing",
+      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
+  self->bypass = bypass;
+  gst_base_transform_set_passthrough (base, bypass);
 }
 
+/* one run of frames through the cores, stereo or pair by pair, from in
+ * to data which may be the same memory
+ */
 static gboolean
-gst_viperfx_stop (GstBaseTransform * base)
+gst_viperfx_process (Gstviperfx *self, const guint8 *in, guint8 *data,
+    guint num_frames)
 {
-  Gstviperfx *self = GST_VIPERFX (base);
-
-  if (self->vfx == NULL)
-    return TRUE;
-  g_mutex_lock (&self->lock);
-  self->vfx->reset (self->vfx);
-  g_mutex_unlock (&self->lock);
+  viperfx_stats *stats = g_atomic_pointer_get (&self->stats);
+  GstClockTime t0;
+  gboolean ok;
+
+  if (self->stereo)
+    return gst_viperfx_process_stereo (self, in, data, num_frames);
+
+  // conversion happens inside the pair jobs and is timed with them
+  t0 = gst_viperfx_now (stats);
+  ok = gst_viperfx_process_pairs (self, in, data, num_frames);
+  if (G_UNLIKELY (stats != NULL)) {
+    viperfx_stats_record (stats, VIPERFX_STAT_PROCESS,
+        gst_viperfx_now (stats) - t0);
+  }
+  return ok;
+}
 
-  return TRUE;
+/* a buffer split at its control points, every multiple of interval in
+ * stream frames, so automation doesn't depend on the buffer size.
+ * the start of the buffer was sampled before the transform
+ */
+static gboolean
+gst_viperfx_process_controlled (Gstviperfx *self, const guint8 *in,
+    guint8 *data, guint num_frames, GstClockTime stream_time, guint interval)
+{
+  gint rate = GST_AUDIO_FILTER_RATE (self);
+  guint bpf = GST_AUDIO_FILTER_BPF (self);
+  guint64 pos = gst_util_uint64_scale_int (stream_time, rate, GST_SECOND);
+  guint done = 0, chunk;
+  gboolean ok = TRUE;
+
+  while (done < num_frames) {
+    chunk = (guint) MIN ((guint64) (num_frames - done),
+        interval - pos % interval);
+    if (done > 0) {
+      gst_viperfx_sample_controls (self,
+          gst_util_uint64_scale_int (pos, GST_SECOND, rate));
+      gst_viperfx_flush_params (self);
+    }
+    ok = gst_viperfx_process (self, in + (gsize) done * bpf,
+        data + (gsize) done * bpf, chunk) && ok;
+    done += chunk;
+    pos += chunk;
+  }
+  return ok;
 }
 
 /* this function does the actual processing
@@ -1507,35 +2688,142 @@ static GstFlowReturn
 gst_viperfx_transform_ip (GstBaseTransform * base, GstBuffer * buf)
 {
   Gstviperfx *filter = GST_VIPERFX (base);
-  guint idx, num_samples;
-  short *pcm_data;
-  GstClockTime timestamp, stream_time;
-  GstMapInfo map;
-
+  guint num_frames, interval, i;
+  gboolean ok, gap, skip, silent;
+  GstClockTime timestamp, stream_time, start;
+  GstBuffer *input;
+  GstMapInfo map, in_map;
+  const guint8 *in;
+  viperfx_fpu_state fpu;
+
+  start = gst_util_get_timestamp ();
   timestamp = GST_BUFFER_TIMESTAMP (buf);
-  stream_time =
-      gst_segment_to_stream_time (&base->segment, GST_FORMAT_TIME, timestamp);
 
-  if (GST_CLOCK_TIME_IS_VALID (stream_time))
-    gst_object_sync_values (GST_OBJECT (filter), stream_time);
+  gap = GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP);
+  skip = g_atomic_int_get (&filter->silence_skip);
 
-  if (G_UNLIKELY (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP)))
+  // buf is a pooled output for a read-only input, the cores read the
+  // input where it is and write buf, see prepare_output_buffer
+  input = filter->input;
+  filter->input = NULL;
+  if (G_UNLIKELY (input != NULL)) {
+    ok = gst_buffer_map (input, &in_map, GST_MAP_READ);
+    if (ok && !gst_buffer_map (buf, &map, GST_MAP_WRITE)) {
+      gst_buffer_unmap (input, &in_map);
+      ok = FALSE;
+    }
+  } else {
+    ok = gst_buffer_map (buf, &map, GST_MAP_READWRITE);
+  }
+  if (G_UNLIKELY (!ok)) {
+    GST_ELEMENT_ERROR (filter, STREAM, FAILED, (NULL),
+        ("can't map buffer"));
+    return GST_FLOW_ERROR;
+  }
+  in = input != NULL ? in_map.data : map.data;
+  num_frames = map.size / GST_AUDIO_FILTER_BPF (filter);
+  if (GST_CLOCK_TIME_IS_VALID (timestamp))
+    filter->next_pts = timestamp + gst_util_uint64_scale_int (num_frames,
+        GST_SECOND, GST_AUDIO_FILTER_RATE (filter));
+
+  silent = gap || (skip && filter->kernels->is_zero (in, map.size));
+  if (!silent || !skip) {
+    filter->quiet_frames = 0;
+  } else if (filter->quiet_frames >= filter->silence_hold &&
+      filter->fading[0] == NULL) {
+    // the tails have rung out, nothing but silence would come out
+    if (G_UNLIKELY (input != NULL)) {
+      memset (map.data, 0, map.size);
+      gst_buffer_unmap (input, &in_map);
+    }
+    gst_buffer_unmap (buf, &map);
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_GAP);
+    filter->drain_pending = FALSE;
+    // the load falls with the time not spent in the cores
+    gst_viperfx_monitor (filter, start, num_frames, timestamp);
     return GST_FLOW_OK;
+  }
+
+  if (G_UNLIKELY (gap)) {
+    // reverb and convolver tails still have to come out of the cores
+    memset (map.data, 0, map.size);
+    in = map.data;
+    GST_BUFFER_FLAG_UNSET (buf, GST_BUFFER_FLAG_GAP);
+  }
+  filter->measure_peak = silent && skip;
+  if (G_UNLIKELY (filter->measure_peak)) {
+    for (i = 0; i < filter->n_pairs; i++)
+      filter->pairs[i].peak = 0;
+  }
+
+  // decaying tails must not drop into denormals, the workers follow this
+  filter->denormals_off = g_atomic_int_get (&filter->realtime_profile);
+  if (G_UNLIKELY (filter->denormals_off)) {
+    gint error = viperfx_rt_denormals_off (&fpu);
+
+    if (error != 0) {
+      gst_viperfx_realtime_failed (filter, REALTIME_DENORMALS,
+          "flush denormals to zero", error);
+      filter->denormals_off = FALSE;
+    }
+  }
 
-  gst_buffer_map (buf, &map, GST_MAP_READWRITE);
-  num_samples = map.size / GST_AUDIO_FILTER_BPS (filter) / 2;
-  pcm_data = (short *)(map.data);
-  for (idx = 0; idx < num_samples * 2; idx++)
-    pcm_data[idx] >>= 1;
-  if (filter->vfx != NULL) {
-    g_mutex_lock (&filter->lock);
-    filter->vfx->process (filter->vfx,
-        pcm_data, (int)num_samples);
-    g_mutex_unlock (&filter->lock);
+  interval = g_atomic_int_get (&filter->control_interval);
+  stream_time = gst_segment_to_stream_time (&base->segment, GST_FORMAT_TIME,
+      timestamp);
+  if (interval > 0 && filter->n_bound > 0 &&
+      GST_CLOCK_TIME_IS_VALID (stream_time)) {
+    ok = gst_viperfx_process_controlled (filter, in, map.data, num_frames,
+        stream_time, interval);
+  } else {
+    ok = gst_viperfx_process (filter, in, map.data, num_frames);
   }
+
+  if (G_UNLIKELY (filter->denormals_off))
+    viperfx_rt_denormals_restore (&fpu);
+
+  if (G_UNLIKELY (input != NULL))
+    gst_buffer_unmap (input, &in_map);
   gst_buffer_unmap (buf, &map);
+  filter->drain_pending = TRUE;
+
+  if (G_UNLIKELY (filter->measure_peak)) {
+    gint level = g_atomic_int_get (&filter->silence_level);
+    gint peak = 0;
+
+    for (i = 0; i < filter->n_pairs; i++)
+      peak = MAX (peak, filter->pairs[i].peak);
+    if (peak <= level)
+      filter->quiet_frames += num_frames;
+    else
+      filter->quiet_frames = 0;
+  }
 
-  return GST_FLOW_OK;
+  // every pair is through its fade once the first one is
+  if (G_UNLIKELY (filter->fading[0] != NULL) && (filter->n_pairs == 0 ||
+          filter->pairs[0].fade_pos >= filter->fade_frames))
+    gst_viperfx_end_fade (filter);
+
+  gst_viperfx_monitor (filter, start, num_frames, timestamp);
+
+  return ok ? GST_FLOW_OK : GST_FLOW_ERROR;
+}
+
+/* called by the viperfx tracer, before the element streams */
+viperfx_stats *
+gst_viperfx_enable_stats (Gstviperfx *self)
+{
+  viperfx_stats *stats = g_new0 (viperfx_stats, 1);
+
+  if (!g_atomic_pointer_compare_and_exchange (&self->stats, NULL, stats))
+    g_free (stats);
+  return g_atomic_pointer_get (&self->stats);
+}
+
+viperfx_stats *
+gst_viperfx_get_stats (Gstviperfx *self)
+{
+  return g_atomic_pointer_get (&self->stats);
 }
 
 /* entry point to initialize the plug-in
@@ -1545,6 +2833,28 @@ gst_viperfx_transform_ip (GstBaseTransform * base, GstBuffer * buf)
 static gboolean
 viperfx_init (GstPlugin * viperfx)
 {
+  fn_viperfx_ep entrypoint;
+
+  GST_DEBUG_CATEGORY_INIT (gst_viperfx_debug, "viperfx", 0, "viperfx element");
+  GST_INFO ("using %s sample kernels", viperfx_kernels_best ()->name);
+
+  // held for the life of the process, elements get cores from the pool
+  entrypoint = viperfx_library_ref ();
+  if (entrypoint == NULL) {
+    GST_WARNING ("viperfx core library unavailable: %s",
+        viperfx_library_error ());
+  }
+  viperfx_corepool_init (entrypoint);
+
+#ifndef GST_DISABLE_GST_TRACER_HOOKS
+  if (!gst_tracer_register (viperfx, "viperfx", GST_TYPE_VIPERFX_TRACER))
+    return FALSE;
+#endif
+
+  if (!gst_element_register (viperfx, "viperfxpool", GST_RANK_NONE,
+      GST_TYPE_VIPERFX_POOL))
+    return FALSE;
+
   return gst_element_register (viperfx, "viperfx", GST_RANK_NONE,
       GST_TYPE_VIPERFX);
 }
@@ -6,6 +6,14 @@
 #include <gst/audio/audio.h>
 #include <gst/audio/gstaudiofilter.h>
 #include "viperfx_so.h"
+#include "viperfx_cmdq.h"
+#include "viperfx_params.h"
+#include "viperfx_preset.h"
+#include "viperfx_ircache.h"
+#include "viperfx_kernels.h"
+#include "viperfx_resample.h"
+#include "viperfx_stats.h"
+#include "viperfx_rt.h"
 
 G_BEGIN_DECLS
 
@@ -18,94 +26,194 @@ G_BEGIN_DECLS
 
 typedef struct _Gstviperfx      Gstviperfx;
 typedef struct _GstviperfxClass GstviperfxClass;
+typedef struct _GstviperfxPair  GstviperfxPair;
+typedef struct _GstviperfxIrSet GstviperfxIrSet;
+
+/* widest layout negotiated, every stereo pair gets a core of its own */
+#define GST_VIPERFX_MAX_CHANNELS 64
+#define GST_VIPERFX_MAX_PAIRS    (GST_VIPERFX_MAX_CHANNELS / 2)
+
+/* a stereo pair of a multichannel stream, processed by cores[] at the
+ * same index. the pair is gathered into raw (native format), converted
+ * into pcm for the core and scattered back afterwards
+ */
+struct _GstviperfxPair {
+  gint left;
+  gint right;
+  gpointer raw;
+  gint16 *pcm;
+  guint frames;
+  /* only below 44.1 kHz, hi holds a resampled block for the core */
+  viperfx_resampler *resampler;
+  gint16 *hi;
+  /* fixed size calls, block_out is what comes out while block_in fills */
+  gint16 *block_in;
+  gint16 *block_out;
+  guint block_fill;
+  /* during a transition, what the outgoing core made of the same input
+   * and how far into the crossfade the pair is, in core frames */
+  gint16 *fade;
+  guint fade_pos;
+  /* output peak of the current buffer, while silent input is measured */
+  gint peak;
+};
+
+/* cores with a new impulse response or new module switches, configured
+ * off the streaming thread for the stream setup generation they were
+ * made for
+ */
+struct _GstviperfxIrSet {
+  guint generation;
+  guint n_cores;
+  viperfx_interface *cores[GST_VIPERFX_MAX_PAIRS];
+  /* a path, or sha256:<hash> with the bytes in data */
+  gchar path[256];
+  GBytes *data;
+  /* parameter values the cores were sent */
+  gint32 values[VIPERFX_PARAM_COUNT];
+};
 
 struct _Gstviperfx {
   GstAudioFilter audiofilter;
 
   /* properties */
-  // global enable
-  gboolean fx_enabled;
-  // convolver
-  gboolean conv_enabled;
+  // convolver impulse response, guarded by lock. a file path, or the
+  // file itself with its sha256, whichever was set last
   gchar conv_ir_path[256];
-  gint32 conv_cc_level;
-  // vhe
-  gboolean vhe_enabled;
-  gint32 vhe_level;
-  // vse
-  gboolean vse_enabled;
-  gint32 vse_ref_bark;
-  gint32 vse_bark_cons;
-  // equalizer
-  gboolean eq_enabled;
-  gint32 eq_band_level[10];
-  // colorful music
-  gboolean colm_enabled;
-  gint32 colm_widening;
-  gint32 colm_midimage;
-  gint32 colm_depth;
-  // diff surr
-  gboolean ds_enabled;
-  gint32 ds_level;
-  // reverb
-  gboolean reverb_enabled;
-  gint32 reverb_roomsize;
-  gint32 reverb_width;
-  gint32 reverb_damp;
-  gint32 reverb_wet;
-  gint32 reverb_dry;
-  // agc
-  gboolean agc_enabled;
-  gint32 agc_ratio;
-  gint32 agc_volume;
-  gint32 agc_maxgain;
-  // viper bass
-  gboolean vb_enabled;
-  gint32 vb_mode;
-  gint32 vb_freq;
-  gint32 vb_gain;
-  // viper clarity
-  gboolean vc_enabled;
-  gint32 vc_mode;
-  gint32 vc_level;
-  // cure
-  gboolean cure_enabled;
-  gint32 cure_level;
-  // tube
-  gboolean tube_enabled;
-  // analog-x
-  gboolean ax_enabled;
-  gint32 ax_mode;
-  // fet compressor
-  gboolean fetcomp_enabled;
-  gint32 fetcomp_threshold;
-  gint32 fetcomp_ratio;
-  gint32 fetcomp_kneewidth;
-  gboolean fetcomp_autoknee;
-  gint32 fetcomp_gain;
-  gboolean fetcomp_autogain;
-  gint32 fetcomp_attack;
-  gboolean fetcomp_autoattack;
-  gint32 fetcomp_release;
-  gboolean fetcomp_autorelease;
-  gint32 fetcomp_meta_kneemulti;
-  gint32 fetcomp_meta_maxattack;
-  gint32 fetcomp_meta_maxrelease;
-  gint32 fetcomp_meta_crest;
-  gint32 fetcomp_meta_adapt;
-  gboolean fetcomp_noclip;
-  // output volume
-  gint32 out_volume;
-  // output pan
-  gint32 out_pan;
-  // limiter
-  gint32 lim_threshold;
+  GBytes *conv_ir_data;
+  gchar conv_ir_digest[65];
+  // every scalar fx parameter, see viperfx_params.h
+  viperfx_param_store params;
+  // resample low rate streams, read at setup
+  volatile gint resample;
+  // frames per core call or 0, read at setup
+  volatile gint block_size;
+  // deadline monitor thresholds, percent of real time
+  volatile gint load_warning;
+  volatile gint load_critical;
+  volatile gint report_overruns;
+  // transition length in ms, 0 switches modules on the running cores
+  volatile gint crossfade;
+  // frames between samples of controlled parameters, 0 once per buffer
+  volatile gint control_interval;
+  // skip the cores on decayed silence, and the s16 peak that counts as it
+  volatile gint silence_skip;
+  volatile gint silence_level;
+  // realtime profile, read at the change to PLAYING and every buffer
+  volatile gint realtime_profile;
+  volatile gint realtime_priority;
+  volatile gint realtime_cpu;
 
   /* < private > */
-  void *so_handle;
-  fn_viperfx_ep so_entrypoint;
-  viperfx_interface *vfx;
+  /* from the plugin-wide pool, cores[0] is taken in init, the others
+   * by setup and all go back in finalize, they see the same commands */
+  viperfx_interface *cores[GST_VIPERFX_MAX_PAIRS];
+  guint n_cores;
+  /* channel pairs of the negotiated layout, unpaired channels pass */
+  GstviperfxPair pairs[GST_VIPERFX_MAX_PAIRS];
+  guint n_pairs;
+  /* plain stereo, cores[0] works on the stream directly */
+  gboolean stereo;
+  /* core rate / stream rate */
+  guint resample_factor;
+  /* block_size in effect */
+  guint block_frames;
+  /* delay added by the element, object lock */
+  GstClockTime latency;
+  const viperfx_kernels *kernels;
+  /* s16 working buffer for formats the core can't take directly */
+  gint16 *scratch;
+  guint scratch_samples;
+  /* runs pairs 1..n_pairs-1 while the streaming thread does pair 0 */
+  GThreadPool *workers;
+  volatile gint pending;
+  GMutex done_lock;
+  GCond done_cond;
+  /* the buffer the workers are on, read from job_in */
+  const guint8 *job_in;
+  guint8 *job_data;
+  guint job_frames;
+  /* rolling load in percent, and as permille for get_property */
+  gdouble load;
+  volatile gint load_permille;
+  /* last level posted, overruns not posted yet */
+  gint load_level;
+  guint overruns;
+  GstClockTime overrun_posted;
+  /* per buffer timing, only while the viperfx tracer is active */
+  viperfx_stats *stats;
+  /* serializes ir path and preset writers, never waited on by the
+   * streaming thread */
   GMutex lock;
+  /* commands waiting to be applied before the next process call */
+  viperfx_cmdq cmdq;
+  volatile gint resync;
+  /* impulse responses are loaded into fresh cores by ir_loader and
+   * swapped in at a buffer boundary. the stream setup, ir_serial and
+   * ir_prepared are guarded by lock, ir_loaded is what cores[] have */
+  GThreadPool *ir_loader;
+  guint ir_serial;
+  gint core_rate;
+  guint core_count;
+  guint core_generation;
+  GstviperfxIrSet *ir_prepared;
+  volatile gint ir_swap;
+  gchar ir_loaded[256];
+  /* the cores a transition fades out, core frames it takes, and whether
+   * held module switches are waiting for ir_loader. streaming thread */
+  viperfx_interface *fading[GST_VIPERFX_MAX_PAIRS];
+  guint fade_frames;
+  gboolean shadow_requested;
+  gboolean shadow_failed;
+  /* buffers pass the element untouched, see gst_viperfx_can_bypass */
+  gboolean bypass;
+  /* bound parameters and their bindings, looked up again every
+   * CONTROL_REFRESH of stream time. streaming thread */
+  GstControlBinding *bindings[VIPERFX_PARAM_COUNT];
+  guint bound[VIPERFX_PARAM_COUNT];
+  guint n_bound;
+  GstClockTime control_refresh;
+  /* stream frames the output has been below silence_level for silent
+   * input, cores are skipped past silence_hold. streaming thread */
+  guint64 quiet_frames;
+  guint64 silence_hold;
+  gboolean measure_peak;
+  /* realtime profile still to be applied by the streaming thread, and
+   * once it was whether new buffers get locked, the failures already
+   * posted and whether the current buffer runs with denormals off */
+  volatile gint realtime_pending;
+  gboolean realtime_locked;
+  guint realtime_reported;
+  gboolean denormals_off;
+  /* the streaming thread's scheduling from before the profile, put back
+   * by that thread when the run ends, see gst_viperfx_chain. the chain
+   * function of basetransform that one wraps */
+  viperfx_sched_state realtime_sched;
+  gboolean realtime_applied;
+  volatile gint realtime_leaving;
+  GstPadChainFunction sink_chain;
+  /* a read-only input, from prepare_output_buffer to transform_ip, that
+   * the cores read while writing a buffer of out_pool. streaming thread */
+  GstBuffer *input;
+  GstBufferPool *out_pool;
+  guint out_pool_size;
+  /* channels no pair takes pass the cores, delayed as much as the
+   * pairs are. delay_width is the sample size. streaming thread */
+  gint unpaired[GST_VIPERFX_MAX_CHANNELS];
+  guint n_unpaired;
+  guint8 *delay_line;
+  guint delay_frames;
+  guint delay_pos;
+  guint delay_width;
+  /* end of the last buffer processed, and whether the cores may still
+   * hold some of it, for the drain at EOS. streaming thread */
+  GstClockTime next_pts;
+  gboolean drain_pending;
+  /* last preset queued and how many were, guarded by lock. the streaming
+   * thread counts the ones it applied to tell whether a resync owes one */
+  viperfx_preset *preset;
+  guint preset_serial;
+  guint preset_applied;
 };
 
 struct _GstviperfxClass {
@@ -114,6 +222,9 @@ struct _GstviperfxClass {
 
 GType gst_viperfx_get_type (void);
 
+viperfx_stats * gst_viperfx_enable_stats (Gstviperfx *self);
+viperfx_stats * gst_viperfx_get_stats (Gstviperfx *self);
+
 G_END_DECLS
 
 #endif /* __GST_VIPERFX_H__ */
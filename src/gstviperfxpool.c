@@ -0,0 +1,486 @@
+/**
+ * SECTION:element-viperfxpool
+ *
+ * Many stereo streams through one element. Every requested sink_%u pad
+ * gets a src_%u pad and a core instance of its own, and carries the fx
+ * properties of its stream. The process calls of all streams, of all
+ * viperfxpool elements in the process, run on one work-stealing pool
+ * with a worker per cpu instead of on each stream's streaming thread.
+ * A stream's buffers are processed in order, one at a time. Control
+ * bindings on a pad's fx properties are sampled at the start of each
+ * of its buffers.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 viperfxpool name=fx sink_0::vb_enable=true \
+ *     filesrc location=a.wav ! decodebin ! audioconvert ! fx.sink_0 \
+ *     fx.src_0 ! audioconvert ! autoaudiosink \
+ *     filesrc location=b.wav ! decodebin ! audioconvert ! fx.sink_1 \
+ *     fx.src_1 ! audioconvert ! wavenc ! filesink location=out.wav
+ * ]|
+ * </refsect2>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+#include "gstviperfxpool.h"
+#include "viperfx_params.h"
+#include "viperfx_preset.h"
+#include "viperfx_corepool.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_viperfx_pool_debug);
+#define GST_CAT_DEFAULT gst_viperfx_pool_debug
+
+enum
+{
+  PROP_0,
+  PROP_CONV_IR_PATH,
+  PROP_PRESET,
+  PROP_PARAM_FIRST,
+  PROP_PARAM_LAST = PROP_PARAM_FIRST + VIPERFX_PARAM_COUNT - 1
+};
+
+/* what the core takes as it is, anything else goes through audioconvert */
+#define POOL_CAPS \
+  "audio/x-raw,"                            \
+  " format=(string)"GST_AUDIO_NE(S16)","    \
+  " rate=(int)[44100,MAX],"                 \
+  " channels=(int)2,"                       \
+  " layout=(string)interleaved"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK, GST_PAD_REQUEST, GST_STATIC_CAPS (POOL_CAPS));
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC, GST_PAD_SOMETIMES, GST_STATIC_CAPS (POOL_CAPS));
+
+G_DEFINE_TYPE (GstviperfxPoolPad, gst_viperfx_pool_pad, GST_TYPE_PAD);
+
+#define gst_viperfx_pool_parent_class parent_class
+G_DEFINE_TYPE (GstviperfxPool, gst_viperfx_pool, GST_TYPE_ELEMENT);
+
+static GstPad *gst_viperfx_pool_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_viperfx_pool_release_pad (GstElement * element,
+    GstPad * pad);
+
+/* stream pad */
+
+/* put preset in the pad's slot and return what was there before */
+static viperfx_preset *
+gst_viperfx_pool_swap_preset (GstviperfxPoolPad *pad, viperfx_preset *preset)
+{
+  viperfx_preset *old;
+
+  do {
+    old = g_atomic_pointer_get (&pad->preset);
+  } while (!g_atomic_pointer_compare_and_exchange (&pad->preset, old, preset));
+  return old;
+}
+
+static void
+gst_viperfx_pool_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstviperfxPoolPad *pad = GST_VIPERFX_POOL_PAD (object);
+
+  if (prop_id >= PROP_PARAM_FIRST && prop_id <= PROP_PARAM_LAST) {
+    // sent by the stream's next task
+    viperfx_param_store_set (&pad->params,
+        prop_id - PROP_PARAM_FIRST, value);
+    return;
+  }
+
+  switch (prop_id) {
+    case PROP_CONV_IR_PATH:
+    {
+      const gchar *path = g_value_get_string (value);
+
+      if (path == NULL || strlen (path) >= sizeof(pad->conv_ir_path))
+        break;
+      GST_OBJECT_LOCK (pad);
+      strcpy (pad->conv_ir_path, path);
+      GST_OBJECT_UNLOCK (pad);
+      g_atomic_int_set (&pad->ir_changed, 1);
+    }
+    break;
+
+    case PROP_PRESET:
+    {
+      const gchar *path = g_value_get_string (value);
+      viperfx_preset *preset;
+      GError *err = NULL;
+
+      if (path == NULL || *path == '\0')
+        break;
+      preset = viperfx_preset_load (path, &err);
+      if (preset == NULL) {
+        GST_WARNING_OBJECT (pad, "can't load preset: %s", err->message);
+        g_error_free (err);
+        break;
+      }
+      // applied whole by the stream's next task, a preset set before
+      // that one ran stands in for this
+      viperfx_preset_unref (gst_viperfx_pool_swap_preset (pad, preset));
+    }
+    break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_viperfx_pool_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+}
+
+static void
+gst_viperfx_pool_pad_finalize (GObject * object)
+{
+  GstviperfxPoolPad *pad = GST_VIPERFX_POOL_PAD (object);
+
+  viperfx_strand_free (pad->strand);
+  viperfx_corepool_release (pad->vfx);
+  viperfx_preset_unref (pad->preset);
+
+  G_OBJECT_CLASS (gst_viperfx_pool_pad_parent_class)->finalize (object);
+}
+
+static void
+gst_viperfx_pool_pad_class_init (GstviperfxPoolPadClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+
+  gobject_class->set_property = gst_viperfx_pool_pad_set_property;
+  gobject_class->get_property = gst_viperfx_pool_pad_get_property;
+  gobject_class->finalize = gst_viperfx_pool_pad_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_CONV_IR_PATH,
+      g_param_spec_string ("conv_ir_path", "ConvIRPath",
+          "Impulse response file of the convolver", "",
+          G_PARAM_WRITABLE));
+  g_object_class_install_property (gobject_class, PROP_PRESET,
+      g_param_spec_string ("preset", "Preset",
+          "Keyfile with a [viperfx] group of parameter values", "",
+          G_PARAM_WRITABLE));
+  viperfx_params_install_properties (gobject_class, PROP_PARAM_FIRST);
+}
+
+static void
+gst_viperfx_pool_pad_init (GstviperfxPoolPad * pad)
+{
+  viperfx_param_store_init (&pad->params);
+  pad->conv_ir_path[0] = '\0';
+  pad->ir_changed = 0;
+  pad->preset = NULL;
+  pad->srcpad = NULL;
+  pad->vfx = NULL;
+  pad->strand = viperfx_strand_new ();
+  pad->kernels = viperfx_kernels_best ();
+  pad->rate = 0;
+  gst_segment_init (&pad->segment, GST_FORMAT_TIME);
+  pad->job = NULL;
+  pad->job_time = GST_CLOCK_TIME_NONE;
+  pad->job_ok = FALSE;
+  pad->job_preset = NULL;
+  pad->job_send_ir = FALSE;
+  pad->job_ir = NULL;
+  pad->job_ir_path[0] = '\0';
+}
+
+/* stream tasks, run on the work pool in the order they were pushed */
+
+static void
+gst_viperfx_pool_send_ir (GstviperfxPoolPad *pad)
+{
+  if (pad->job_ir != NULL)
+    viperfx_ir_send (pad->job_ir, pad->vfx);
+  else if (!viperfx_command_set_ir_path (pad->vfx, pad->job_ir_path))
+    GST_WARNING_OBJECT (pad, "core refused impulse response %s",
+        pad->job_ir_path);
+}
+
+static void
+gst_viperfx_pool_configure (gpointer data)
+{
+  GstviperfxPoolPad *pad = data;
+
+  pad->job_ok = pad->vfx->set_samplerate (pad->vfx, pad->rate) &&
+      pad->vfx->set_channels (pad->vfx, 2);
+  if (!pad->job_ok)
+    return;
+  pad->vfx->reset (pad->vfx);
+}
+
+static void
+gst_viperfx_pool_reset (gpointer data)
+{
+  GstviperfxPoolPad *pad = data;
+
+  pad->vfx->reset (pad->vfx);
+}
+
+static void
+gst_viperfx_pool_process (gpointer data)
+{
+  GstviperfxPoolPad *pad = data;
+  GstMapInfo map;
+  gint16 *pcm;
+  guint num_samples;
+
+  // controlled values go through set_property into the store
+  if (GST_CLOCK_TIME_IS_VALID (pad->job_time))
+    gst_object_sync_values (GST_OBJECT (pad), pad->job_time);
+  // the store only ever takes a preset here, next to its flush, so no
+  // buffer is processed with part of one
+  if (pad->job_preset != NULL)
+    viperfx_preset_apply (pad->job_preset, &pad->params);
+  viperfx_param_store_flush (&pad->params, &pad->vfx, 1, FALSE, NULL);
+  if (pad->job_send_ir)
+    gst_viperfx_pool_send_ir (pad);
+
+  pad->job_ok = gst_buffer_map (pad->job, &map, GST_MAP_READWRITE);
+  if (!pad->job_ok)
+    return;
+  pcm = (gint16 *) map.data;
+  num_samples = map.size / sizeof(gint16);
+  pad->kernels->headroom_s16 (pcm, pcm, num_samples);
+  pad->vfx->process (pad->vfx, pcm, (int)(num_samples / 2));
+  pad->kernels->makeup_s16 (pcm, pcm, num_samples);
+  gst_buffer_unmap (pad->job, &map);
+}
+
+/* streaming threads, they hand the work over and wait for it */
+
+/* decode, hash and resample a changed impulse response here, on the
+ * stream's own thread, rather than hold up a shared worker with it
+ */
+static void
+gst_viperfx_pool_load_ir (GstviperfxPoolPad *pad)
+{
+  GError *err = NULL;
+
+  GST_OBJECT_LOCK (pad);
+  strcpy (pad->job_ir_path, pad->conv_ir_path);
+  GST_OBJECT_UNLOCK (pad);
+
+  if (pad->job_ir_path[0] == '\0')
+    return;
+  pad->job_ir = viperfx_ir_cache_get (pad->job_ir_path, pad->rate, &err);
+  if (pad->job_ir == NULL) {
+    GST_DEBUG_OBJECT (pad, "core reads %s itself: %s", pad->job_ir_path,
+        err->message);
+    g_error_free (err);
+  }
+}
+
+static GstFlowReturn
+gst_viperfx_pool_chain (GstPad * sinkpad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstviperfxPoolPad *pad = GST_VIPERFX_POOL_PAD (sinkpad);
+
+  if (pad->rate == 0) {
+    gst_buffer_unref (buffer);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  pad->job = gst_buffer_make_writable (buffer);
+  pad->job_time = GST_CLOCK_TIME_NONE;
+  if (pad->segment.format == GST_FORMAT_TIME)
+    pad->job_time = gst_segment_to_stream_time (&pad->segment,
+        GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (pad->job));
+  pad->job_preset = gst_viperfx_pool_swap_preset (pad, NULL);
+  if (pad->job_preset != NULL && pad->job_preset->has_ir_path) {
+    GST_OBJECT_LOCK (pad);
+    strcpy (pad->conv_ir_path, pad->job_preset->ir_path);
+    GST_OBJECT_UNLOCK (pad);
+    g_atomic_int_set (&pad->ir_changed, 1);
+  }
+  pad->job_send_ir =
+      g_atomic_int_compare_and_exchange (&pad->ir_changed, 1, 0);
+  if (pad->job_send_ir)
+    gst_viperfx_pool_load_ir (pad);
+
+  viperfx_strand_run (pad->strand, gst_viperfx_pool_process, pad);
+  buffer = pad->job;
+  pad->job = NULL;
+  viperfx_preset_unref (pad->job_preset);
+  pad->job_preset = NULL;
+  viperfx_ir_unref (pad->job_ir);
+  pad->job_ir = NULL;
+  if (!pad->job_ok) {
+    gst_buffer_unref (buffer);
+    GST_ELEMENT_ERROR (parent, STREAM, FAILED, (NULL),
+        ("can't map buffer of %s", GST_PAD_NAME (sinkpad)));
+    return GST_FLOW_ERROR;
+  }
+  return gst_pad_push (pad->srcpad, buffer);
+}
+
+static gboolean
+gst_viperfx_pool_sink_event (GstPad * sinkpad, GstObject * parent,
+    GstEvent * event)
+{
+  GstviperfxPoolPad *pad = GST_VIPERFX_POOL_PAD (sinkpad);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+      gint rate = 0;
+
+      gst_event_parse_caps (event, &caps);
+      if (!gst_structure_get_int (gst_caps_get_structure (caps, 0),
+          "rate", &rate) || rate <= 0) {
+        gst_event_unref (event);
+        return FALSE;
+      }
+      pad->rate = rate;
+      viperfx_strand_run (pad->strand, gst_viperfx_pool_configure, pad);
+      if (!pad->job_ok) {
+        GST_WARNING_OBJECT (pad, "core can't run at %d Hz", rate);
+        pad->rate = 0;
+        gst_event_unref (event);
+        return FALSE;
+      }
+      // kernels are made for the rate, the next buffer loads it again
+      g_atomic_int_set (&pad->ir_changed, 1);
+    }
+    break;
+
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &pad->segment);
+      break;
+
+    case GST_EVENT_FLUSH_STOP:
+      viperfx_strand_run (pad->strand, gst_viperfx_pool_reset, pad);
+      break;
+
+    default:
+      break;
+  }
+
+  return gst_pad_push_event (pad->srcpad, event);
+}
+
+static GstIterator *
+gst_viperfx_pool_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  GstPad *other = gst_pad_get_element_private (pad);
+  GstIterator *it;
+  GValue value = G_VALUE_INIT;
+
+  if (other == NULL)
+    return NULL;
+  g_value_init (&value, GST_TYPE_PAD);
+  g_value_set_object (&value, other);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &value);
+  g_value_unset (&value);
+  return it;
+}
+
+/* element */
+
+static void
+gst_viperfx_pool_class_init (GstviperfxPoolClass * klass)
+{
+  GstElementClass *gstelement_class = (GstElementClass *) klass;
+
+  GST_DEBUG_CATEGORY_INIT (gst_viperfx_pool_debug, "viperfxpool", 0,
+      "viperfx multi-stream element");
+
+  gst_element_class_set_static_metadata (gstelement_class,
+    "viperfxpool",
+    "Filter/Effect/Audio",
+    "ViPER-FX Core wrapper for many streams on a shared worker pool",
+    "Jason <jason@vipersaudio.com>");
+
+  gst_element_class_add_static_pad_template (gstelement_class,
+      &sink_template);
+  gst_element_class_add_static_pad_template (gstelement_class, &src_template);
+
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_viperfx_pool_request_new_pad);
+  gstelement_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_viperfx_pool_release_pad);
+}
+
+static void
+gst_viperfx_pool_init (GstviperfxPool * self)
+{
+  self->next_index = 0;
+}
+
+static GstPad *
+gst_viperfx_pool_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstviperfxPool *self = GST_VIPERFX_POOL (element);
+  GstviperfxPoolPad *pad;
+  viperfx_interface *vfx;
+  gchar *sink_name, *src_name;
+  guint index;
+
+  GST_OBJECT_LOCK (self);
+  if (name != NULL && sscanf (name, "sink_%u", &index) == 1) {
+    if (index >= self->next_index)
+      self->next_index = index + 1;
+  } else {
+    index = self->next_index++;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  // pooled cores come reset and at the defaults params starts out with
+  vfx = viperfx_corepool_acquire ();
+  if (vfx == NULL) {
+    GST_ELEMENT_ERROR (self, LIBRARY, INIT, (NULL),
+        ("viperfx core unavailable"));
+    return NULL;
+  }
+
+  sink_name = g_strdup_printf ("sink_%u", index);
+  src_name = g_strdup_printf ("src_%u", index);
+  pad = g_object_new (GST_TYPE_VIPERFX_POOL_PAD, "name", sink_name,
+      "direction", GST_PAD_SINK, "template", templ, NULL);
+  pad->vfx = vfx;
+  pad->srcpad = gst_pad_new_from_static_template (&src_template, src_name);
+  g_free (sink_name);
+  g_free (src_name);
+
+  gst_pad_set_element_private (GST_PAD (pad), pad->srcpad);
+  gst_pad_set_element_private (pad->srcpad, pad);
+  gst_pad_set_chain_function (GST_PAD (pad),
+      GST_DEBUG_FUNCPTR (gst_viperfx_pool_chain));
+  gst_pad_set_event_function (GST_PAD (pad),
+      GST_DEBUG_FUNCPTR (gst_viperfx_pool_sink_event));
+  gst_pad_set_iterate_internal_links_function (GST_PAD (pad),
+      GST_DEBUG_FUNCPTR (gst_viperfx_pool_iterate_internal_links));
+  gst_pad_set_iterate_internal_links_function (pad->srcpad,
+      GST_DEBUG_FUNCPTR (gst_viperfx_pool_iterate_internal_links));
+  // caps and allocation queries go to the stream's own peer
+  GST_PAD_SET_PROXY_CAPS (GST_PAD (pad));
+  GST_PAD_SET_PROXY_ALLOCATION (GST_PAD (pad));
+  GST_PAD_SET_PROXY_CAPS (pad->srcpad);
+
+  gst_element_add_pad (element, pad->srcpad);
+  gst_element_add_pad (element, GST_PAD (pad));
+  return GST_PAD (pad);
+}
+
+static void
+gst_viperfx_pool_release_pad (GstElement * element, GstPad * sinkpad)
+{
+  GstviperfxPoolPad *pad = GST_VIPERFX_POOL_PAD (sinkpad);
+
+  // the core and strand go with the pad, once nothing uses it
+  gst_element_remove_pad (element, pad->srcpad);
+  gst_element_remove_pad (element, sinkpad);
+}
@@ -0,0 +1,91 @@
+#ifndef __GST_VIPERFX_POOL_H__
+#define __GST_VIPERFX_POOL_H__
+
+#include <gst/gst.h>
+#include "viperfx_so.h"
+#include "viperfx_params.h"
+#include "viperfx_preset.h"
+#include "viperfx_ircache.h"
+#include "viperfx_kernels.h"
+#include "viperfx_workpool.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VIPERFX_POOL            (gst_viperfx_pool_get_type())
+#define GST_VIPERFX_POOL(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VIPERFX_POOL,GstviperfxPool))
+#define GST_VIPERFX_POOL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass) ,GST_TYPE_VIPERFX_POOL,GstviperfxPoolClass))
+#define GST_IS_VIPERFX_POOL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VIPERFX_POOL))
+
+#define GST_TYPE_VIPERFX_POOL_PAD        (gst_viperfx_pool_pad_get_type())
+#define GST_VIPERFX_POOL_PAD(obj)        (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VIPERFX_POOL_PAD,GstviperfxPoolPad))
+#define GST_IS_VIPERFX_POOL_PAD(obj)     (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VIPERFX_POOL_PAD))
+
+typedef struct _GstviperfxPool         GstviperfxPool;
+typedef struct _GstviperfxPoolClass    GstviperfxPoolClass;
+typedef struct _GstviperfxPoolPad      GstviperfxPoolPad;
+typedef struct _GstviperfxPoolPadClass GstviperfxPoolPadClass;
+
+/* one stream of a viperfxpool, the request sink pad. it carries the
+ * stream's fx properties and owns its core and src pad
+ */
+struct _GstviperfxPoolPad {
+  GstPad pad;
+
+  /* properties */
+  // every scalar fx parameter, see viperfx_params.h
+  viperfx_param_store params;
+  // convolver impulse response path, object lock
+  gchar conv_ir_path[256];
+  volatile gint ir_changed;
+  // latest preset not yet applied, swapped atomically. the stream's
+  // next buffer takes it, its task applies it right before the flush
+  viperfx_preset *preset;
+
+  /* < private > */
+  GstPad *srcpad;
+  /* from the plugin-wide core pool, only used by the stream's tasks */
+  viperfx_interface *vfx;
+  /* the stream's queue on the work pool */
+  viperfx_strand *strand;
+  const viperfx_kernels *kernels;
+  /* negotiated rate, 0 before caps */
+  gint rate;
+  /* the stream's segment, bindings are sampled in its stream time */
+  GstSegment segment;
+  /* what the task in flight works on, and its stream time */
+  GstBuffer *job;
+  GstClockTime job_time;
+  gboolean job_ok;
+  viperfx_preset *job_preset;
+  /* an impulse response for the task to send, loaded on the streaming
+   * thread. job_ir NULL leaves job_ir_path for the core to read */
+  gboolean job_send_ir;
+  viperfx_ir *job_ir;
+  gchar job_ir_path[256];
+};
+
+struct _GstviperfxPoolPadClass {
+  GstPadClass parent_class;
+};
+
+/* any number of stereo streams, each with a core of its own, whose
+ * process calls all run on the plugin-wide work pool
+ */
+struct _GstviperfxPool {
+  GstElement element;
+
+  /* < private > */
+  /* next free stream index, object lock */
+  guint next_index;
+};
+
+struct _GstviperfxPoolClass {
+  GstElementClass parent_class;
+};
+
+GType gst_viperfx_pool_get_type (void);
+GType gst_viperfx_pool_pad_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_VIPERFX_POOL_H__ */
@@ -0,0 +1,117 @@
+/**
+ * SECTION:tracer-viperfx
+ *
+ * Per buffer timing of the viperfx element: core processing, command
+ * handling and sample conversion. Percentiles are logged as
+ * viperfx-interval records when an element returns to READY.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * GST_TRACERS=viperfx GST_DEBUG=GST_TRACER:7 gst-launch-1.0 audiotestsrc num-buffers=1000 ! viperfx ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#include <gst/gst.h>
+
+#include "gstviperfxtracer.h"
+#include "gstviperfx.h"
+#include "viperfx_stats.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_viperfx_tracer_debug);
+#define GST_CAT_DEFAULT gst_viperfx_tracer_debug
+
+#define gst_viperfx_tracer_parent_class parent_class
+G_DEFINE_TYPE (GstviperfxTracer, gst_viperfx_tracer, GST_TYPE_TRACER);
+
+static GstTracerRecord *tr_interval;
+
+/* start timing every viperfx element as it is created */
+static void
+do_element_new (GstTracer * self, GstClockTime ts, GstElement * element)
+{
+  if (!GST_IS_VIPERFX (element))
+    return;
+  gst_viperfx_enable_stats (GST_VIPERFX (element));
+  GST_DEBUG_OBJECT (self, "timing %" GST_PTR_FORMAT, element);
+}
+
+static void
+do_element_change_state_post (GstTracer * self, GstClockTime ts,
+    GstElement * element, GstStateChange transition,
+    GstStateChangeReturn result)
+{
+  viperfx_stats *stats;
+  gchar *name;
+  guint i;
+
+  if (transition != GST_STATE_CHANGE_PAUSED_TO_READY ||
+      !GST_IS_VIPERFX (element))
+    return;
+
+  stats = gst_viperfx_get_stats (GST_VIPERFX (element));
+  if (stats == NULL)
+    return;
+
+  name = gst_object_get_name (GST_OBJECT (element));
+  for (i = 0; i < VIPERFX_STAT_COUNT; i++) {
+    guint64 count = viperfx_stats_count (stats, i);
+
+    if (count == 0)
+      continue;
+    gst_tracer_record_log (tr_interval, name, viperfx_stats_name (i), count,
+        viperfx_stats_percentile (stats, i, 0.5),
+        viperfx_stats_percentile (stats, i, 0.99),
+        viperfx_stats_percentile (stats, i, 0.999));
+  }
+  g_free (name);
+
+  // the next run starts from scratch
+  viperfx_stats_reset (stats);
+}
+
+static GstStructure *
+value_field (GType type, const gchar * description)
+{
+  return gst_structure_new ("value",
+      "type", G_TYPE_GTYPE, type,
+      "description", G_TYPE_STRING, description,
+      NULL);
+}
+
+static void
+gst_viperfx_tracer_class_init (GstviperfxTracerClass * klass)
+{
+  GST_DEBUG_CATEGORY_INIT (gst_viperfx_tracer_debug, "viperfxtracer", 0,
+      "viperfx tracer");
+
+  tr_interval = gst_tracer_record_new ("viperfx-interval.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT,
+          NULL),
+      "interval", GST_TYPE_STRUCTURE, value_field (G_TYPE_STRING,
+          "process, commands or convert"),
+      "count", GST_TYPE_STRUCTURE, value_field (G_TYPE_UINT64,
+          "buffers timed"),
+      "p50", GST_TYPE_STRUCTURE, value_field (G_TYPE_UINT64,
+          "median in ns"),
+      "p99", GST_TYPE_STRUCTURE, value_field (G_TYPE_UINT64,
+          "99th percentile in ns"),
+      "p999", GST_TYPE_STRUCTURE, value_field (G_TYPE_UINT64,
+          "99.9th percentile in ns"),
+      NULL);
+}
+
+static void
+gst_viperfx_tracer_init (GstviperfxTracer * self)
+{
+  GstTracer *tracer = GST_TRACER (self);
+
+  gst_tracing_register_hook (tracer, "element-new",
+      G_CALLBACK (do_element_new));
+  gst_tracing_register_hook (tracer, "element-change-state-post",
+      G_CALLBACK (do_element_change_state_post));
+}
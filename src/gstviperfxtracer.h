@@ -0,0 +1,32 @@
+#ifndef __GST_VIPERFX_TRACER_H__
+#define __GST_VIPERFX_TRACER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VIPERFX_TRACER            (gst_viperfx_tracer_get_type())
+#define GST_VIPERFX_TRACER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VIPERFX_TRACER,GstviperfxTracer))
+#define GST_VIPERFX_TRACER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass) ,GST_TYPE_VIPERFX_TRACER,GstviperfxTracerClass))
+#define GST_IS_VIPERFX_TRACER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VIPERFX_TRACER))
+
+typedef struct _GstviperfxTracer      GstviperfxTracer;
+typedef struct _GstviperfxTracerClass GstviperfxTracerClass;
+
+/* GST_TRACERS=viperfx
+ * times every buffer of every viperfx element and logs percentiles
+ * of each interval when the element goes back to READY
+ */
+struct _GstviperfxTracer {
+  GstTracer parent;
+};
+
+struct _GstviperfxTracerClass {
+  GstTracerClass parent_class;
+};
+
+GType gst_viperfx_tracer_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_VIPERFX_TRACER_H__ */
@@ -0,0 +1,56 @@
+#include <string.h>
+#include <glib.h>
+#include "viperfx_cmdq.h"
+
+void viperfx_cmdq_init (viperfx_cmdq * q, guint capacity)
+{
+  guint size = 1;
+
+  /* round up to a power of two so indices can be masked */
+  while (size < capacity)
+    size <<= 1;
+
+  q->slots = g_new0 (viperfx_cmd, size);
+  q->mask = size - 1;
+  q->head = 0;
+  q->tail = 0;
+}
+
+void viperfx_cmdq_clear (viperfx_cmdq * q)
+{
+  g_free (q->slots);
+  q->slots = NULL;
+  q->mask = 0;
+  q->head = 0;
+  q->tail = 0;
+}
+
+gboolean viperfx_cmdq_push (viperfx_cmdq * q, const viperfx_cmd * cmd)
+{
+  guint head = (guint) q->head;
+  guint tail = (guint) g_atomic_int_get (&q->tail);
+
+  if (head - tail > q->mask)
+    return FALSE;
+
+  memcpy (&q->slots[head & q->mask], cmd, sizeof(viperfx_cmd));
+  /* publish the slot only after its content is written */
+  g_atomic_int_set (&q->head, (gint) (head + 1));
+  return TRUE;
+}
+
+viperfx_cmd * viperfx_cmdq_peek (viperfx_cmdq * q)
+{
+  guint tail = (guint) q->tail;
+  guint head = (guint) g_atomic_int_get (&q->head);
+
+  if (head == tail)
+    return NULL;
+  return &q->slots[tail & q->mask];
+}
+
+void viperfx_cmdq_advance (viperfx_cmdq * q)
+{
+  /* hand the slot back to the producer once it has been consumed */
+  g_atomic_int_set (&q->tail, q->tail + 1);
+}
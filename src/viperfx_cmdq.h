@@ -0,0 +1,41 @@
+#ifndef _VIPERFX_CMDQ_H
+#define _VIPERFX_CMDQ_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* single-producer/single-consumer command ring
+ *
+ * producers (property setters) must be serialized by the caller,
+ * the consumer is the streaming thread and never blocks.
+ */
+
+enum
+{
+  VIPERFX_CMD_PRESET = 0,
+};
+
+typedef struct _viperfx_cmd {
+  gint32 type;
+  /* VIPERFX_CMD_PRESET, owns a reference to the preset */
+  gpointer data;
+} viperfx_cmd;
+
+typedef struct _viperfx_cmdq {
+  viperfx_cmd *slots;
+  guint mask;
+  volatile gint head;   /* next slot to write, owned by the producer */
+  volatile gint tail;   /* next slot to read, owned by the consumer */
+} viperfx_cmdq;
+
+void viperfx_cmdq_init (viperfx_cmdq * q, guint capacity);
+void viperfx_cmdq_clear (viperfx_cmdq * q);
+
+gboolean viperfx_cmdq_push (viperfx_cmdq * q, const viperfx_cmd * cmd);
+viperfx_cmd * viperfx_cmdq_peek (viperfx_cmdq * q);
+void viperfx_cmdq_advance (viperfx_cmdq * q);
+
+G_END_DECLS
+
+#endif
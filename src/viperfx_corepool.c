@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <glib.h>
+#include "viperfx_corepool.h"
+#include "viperfx_params.h"
+
+typedef struct _viperfx_corepool {
+  GMutex lock;
+  fn_viperfx_ep entrypoint;
+  /* the state idle instances are kept in */
+  viperfx_param_store defaults;
+  GQueue idle;
+  guint min_idle;
+  guint max_idle;
+  /* restores returned instances and tops the idle list up */
+  GThreadPool *maintainer;
+  gboolean refilling;
+} viperfx_corepool;
+
+static viperfx_corepool pool = { { 0 }, };
+
+/* maintainer task that isn't a returned instance */
+static gchar refill_task;
+
+static guint env_uint (const gchar * name, guint fallback)
+{
+  const gchar *value = g_getenv (name);
+
+  if (value == NULL || *value == '\0')
+    return fallback;
+  return (guint) strtoul (value, NULL, 10);
+}
+
+/* fresh or used, leave the instance reset and at defaults
+*/
+static void corepool_restore (viperfx_interface * vfx)
+{
+  viperfx_command_set_ir_path (vfx, "");
+  viperfx_param_store_replay (&pool.defaults, vfx);
+  vfx->reset (vfx);
+}
+
+static viperfx_interface * corepool_create (void)
+{
+  viperfx_interface *vfx = pool.entrypoint ();
+
+  if (vfx != NULL)
+    corepool_restore (vfx);
+  return vfx;
+}
+
+static void corepool_refill (void)
+{
+  for (;;) {
+    viperfx_interface *vfx;
+
+    g_mutex_lock (&pool.lock);
+    if (g_queue_get_length (&pool.idle) >= pool.min_idle) {
+      pool.refilling = FALSE;
+      g_mutex_unlock (&pool.lock);
+      return;
+    }
+    g_mutex_unlock (&pool.lock);
+
+    vfx = corepool_create ();
+    g_mutex_lock (&pool.lock);
+    if (vfx == NULL) {
+      pool.refilling = FALSE;
+      g_mutex_unlock (&pool.lock);
+      return;
+    }
+    g_queue_push_tail (&pool.idle, vfx);
+    g_mutex_unlock (&pool.lock);
+  }
+}
+
+static void corepool_maintain (gpointer data, gpointer user_data)
+{
+  viperfx_interface *vfx = data;
+
+  if (data == &refill_task) {
+    corepool_refill ();
+    return;
+  }
+
+  corepool_restore (vfx);
+  g_mutex_lock (&pool.lock);
+  if (g_queue_get_length (&pool.idle) < pool.max_idle) {
+    g_queue_push_tail (&pool.idle, vfx);
+    vfx = NULL;
+  }
+  g_mutex_unlock (&pool.lock);
+
+  if (vfx != NULL)
+    vfx->release (vfx);
+}
+
+/* called with pool.lock held */
+static void corepool_schedule_refill (void)
+{
+  if (pool.refilling || pool.maintainer == NULL)
+    return;
+  if (g_queue_get_length (&pool.idle) >= pool.min_idle)
+    return;
+  pool.refilling = TRUE;
+  g_thread_pool_push (pool.maintainer, &refill_task, NULL);
+}
+
+/* called once from the plugin init, the pool lives as long as the
+ * process, like the library it creates instances from
+ */
+void viperfx_corepool_init (fn_viperfx_ep entrypoint)
+{
+  g_mutex_init (&pool.lock);
+  g_queue_init (&pool.idle);
+  viperfx_param_store_init (&pool.defaults);
+  pool.min_idle = env_uint ("VIPERFX_POOL_MIN", VIPERFX_COREPOOL_MIN_IDLE);
+  pool.max_idle = env_uint ("VIPERFX_POOL_MAX", VIPERFX_COREPOOL_MAX_IDLE);
+  if (pool.max_idle < pool.min_idle)
+    pool.max_idle = pool.min_idle;
+  pool.entrypoint = entrypoint;
+  if (entrypoint == NULL)
+    return;
+
+  pool.maintainer = g_thread_pool_new (corepool_maintain, NULL,
+      1, FALSE, NULL);
+
+  g_mutex_lock (&pool.lock);
+  corepool_schedule_refill ();
+  g_mutex_unlock (&pool.lock);
+}
+
+viperfx_interface * viperfx_corepool_acquire (void)
+{
+  viperfx_interface *vfx;
+
+  if (pool.entrypoint == NULL)
+    return NULL;
+
+  g_mutex_lock (&pool.lock);
+  vfx = g_queue_pop_head (&pool.idle);
+  corepool_schedule_refill ();
+  g_mutex_unlock (&pool.lock);
+
+  // pool ran dry, pay for a new instance right here
+  if (vfx == NULL)
+    vfx = corepool_create ();
+  return vfx;
+}
+
+void viperfx_corepool_release (viperfx_interface * vfx)
+{
+  if (vfx == NULL)
+    return;
+
+  if (pool.maintainer != NULL) {
+    g_thread_pool_push (pool.maintainer, vfx, NULL);
+    return;
+  }
+  corepool_maintain (vfx, NULL);
+}
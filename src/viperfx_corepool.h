@@ -0,0 +1,29 @@
+#ifndef _VIPERFX_COREPOOL_H
+#define _VIPERFX_COREPOOL_H
+
+#include <glib.h>
+#include "viperfx_so.h"
+
+G_BEGIN_DECLS
+
+/* plugin-wide pool of core instances
+ *
+ * idle instances are reset and carry the default parameters and no
+ * impulse response, exactly what a fresh viperfx_param_store assumes.
+ * returned instances are brought back to that state on a background
+ * thread, which also keeps at least min_idle of them around.
+ */
+
+/* idle instances kept warm, overridable with VIPERFX_POOL_MIN/MAX */
+#define VIPERFX_COREPOOL_MIN_IDLE 2
+#define VIPERFX_COREPOOL_MAX_IDLE 16
+
+void viperfx_corepool_init (fn_viperfx_ep entrypoint);
+
+/* NULL when there is no core library or the core can't be created */
+viperfx_interface * viperfx_corepool_acquire (void);
+void viperfx_corepool_release (viperfx_interface * vfx);
+
+G_END_DECLS
+
+#endif
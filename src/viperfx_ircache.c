@@ -0,0 +1,485 @@
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "viperfx_ircache.h"
+
+/* zero crossings of the resampling sinc on each side */
+#define RESAMPLE_ZEROS 16
+
+/* content hash per path, so only changed files are read again */
+typedef struct _ir_digest {
+  gint64 size;
+  gint64 mtime;
+  gchar hex[65];
+} ir_digest;
+
+static GMutex index_lock;
+static GHashTable *digest_index = NULL;
+
+/* every kernel alive in the process, keyed by content hash and rate */
+static GMutex registry_lock;
+static GHashTable *registry = NULL;
+
+G_DEFINE_QUARK (viperfx-ir-error-quark, viperfx_ir_error)
+
+viperfx_ir * viperfx_ir_ref (viperfx_ir * ir)
+{
+  // the caller holds a reference, this can't race the last unref
+  g_atomic_int_inc (&ir->refcount);
+  return ir;
+}
+
+static void ir_free (viperfx_ir * ir)
+{
+  if (ir->mapped != NULL)
+    g_mapped_file_unref (ir->mapped);
+  g_free (ir->owned);
+  g_free (ir);
+}
+
+/* the registry doesn't hold a reference, the last unref takes the
+ * kernel out under the lock lookups take theirs with
+ */
+void viperfx_ir_unref (viperfx_ir * ir)
+{
+  gboolean last;
+
+  if (ir == NULL)
+    return;
+  g_mutex_lock (&registry_lock);
+  last = g_atomic_int_dec_and_test (&ir->refcount);
+  if (last)
+    g_hash_table_remove (registry, ir->key);
+  g_mutex_unlock (&registry_lock);
+  if (last)
+    ir_free (ir);
+}
+
+/* publish a kernel under hex and its rate, or hand out the one that
+ * a racing load published first
+ */
+static viperfx_ir * ir_register (viperfx_ir * ir, const gchar * hex)
+{
+  viperfx_ir *existing;
+
+  g_snprintf (ir->key, sizeof(ir->key), "%s-%u", hex, ir->rate);
+  g_mutex_lock (&registry_lock);
+  existing = g_hash_table_lookup (registry, ir->key);
+  if (existing != NULL) {
+    g_atomic_int_inc (&existing->refcount);
+    g_mutex_unlock (&registry_lock);
+    ir_free (ir);
+    return existing;
+  }
+  g_hash_table_insert (registry, ir->key, ir);
+  g_mutex_unlock (&registry_lock);
+  return ir;
+}
+
+static guint32 read_le16 (const guint8 * p)
+{
+  return (guint32) p[0] | ((guint32) p[1] << 8);
+}
+
+static guint32 read_le32 (const guint8 * p)
+{
+  return (guint32) p[0] | ((guint32) p[1] << 8) |
+      ((guint32) p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+gfloat * viperfx_ir_decode_wav (const guint8 * data, gsize size,
+    guint32 * rate, guint32 * channels, guint32 * frames, GError ** error)
+{
+  const guint8 *samples = NULL;
+  guint32 format = 0, n_channels = 0, sample_rate = 0, bits = 0;
+  gsize pos, data_size = 0, frame_bytes, n_frames, i;
+  gfloat *out;
+
+  if (size < 12 || memcmp (data, "RIFF", 4) != 0 ||
+      memcmp (data + 8, "WAVE", 4) != 0) {
+    g_set_error (error, VIPERFX_IR_ERROR, VIPERFX_IR_ERROR_FORMAT,
+        "not a RIFF/WAVE file");
+    return NULL;
+  }
+
+  for (pos = 12; pos + 8 <= size; ) {
+    const guint8 *chunk = data + pos;
+    gsize body = pos + 8;
+    gsize len = read_le32 (chunk + 4);
+
+    // tolerate a data chunk running past a truncated file
+    if (len > size - body)
+      len = size - body;
+    if (memcmp (chunk, "fmt ", 4) == 0 && len >= 16) {
+      format = read_le16 (data + body);
+      n_channels = read_le16 (data + body + 2);
+      sample_rate = read_le32 (data + body + 4);
+      bits = read_le16 (data + body + 14);
+      // WAVE_FORMAT_EXTENSIBLE, the sub format starts with the tag
+      if (format == 0xfffe && len >= 26)
+        format = read_le16 (data + body + 24);
+    } else if (memcmp (chunk, "data", 4) == 0) {
+      samples = data + body;
+      data_size = len;
+    }
+    pos = body + len + (len & 1);
+  }
+
+  if (samples == NULL || sample_rate == 0 ||
+      !(n_channels == 1 || n_channels == 2 || n_channels == 4) ||
+      !((format == 1 && (bits == 16 || bits == 24 || bits == 32)) ||
+          (format == 3 && bits == 32))) {
+    g_set_error (error, VIPERFX_IR_ERROR, VIPERFX_IR_ERROR_FORMAT,
+        "unsupported wave format %u, %u bits, %u channels",
+        format, bits, n_channels);
+    return NULL;
+  }
+
+  frame_bytes = n_channels * (bits / 8);
+  n_frames = data_size / frame_bytes;
+  if (n_frames == 0 || n_frames > G_MAXUINT32 / 4 / n_channels) {
+    g_set_error (error, VIPERFX_IR_ERROR, VIPERFX_IR_ERROR_CORRUPT,
+        "%" G_GSIZE_FORMAT " frames of impulse response", n_frames);
+    return NULL;
+  }
+
+  out = g_new (gfloat, n_frames * n_channels);
+  for (i = 0; i < n_frames * n_channels; i++) {
+    const guint8 *s = samples + i * (bits / 8);
+
+    if (format == 3) {
+      guint32 u = read_le32 (s);
+      gfloat f;
+
+      memcpy (&f, &u, sizeof(f));
+      out[i] = f;
+    } else if (bits == 16) {
+      out[i] = (gint16) read_le16 (s) / 32768.0f;
+    } else if (bits == 24) {
+      gint32 v = (gint32)(read_le16 (s) << 8 | (guint32) s[2] << 24) >> 8;
+
+      out[i] = v / 8388608.0f;
+    } else {
+      out[i] = (gint32) read_le32 (s) / 2147483648.0f;
+    }
+  }
+
+  *rate = sample_rate;
+  *channels = n_channels;
+  *frames = (guint32) n_frames;
+  return out;
+}
+
+/* blackman window over [-1, 1] */
+static gdouble window (gdouble u)
+{
+  return 0.42 + 0.5 * cos (G_PI * u) + 0.08 * cos (2.0 * G_PI * u);
+}
+
+gfloat * viperfx_ir_resample (const gfloat * in, guint32 frames,
+    guint32 channels, guint32 in_rate, guint32 out_rate,
+    guint32 * out_frames)
+{
+  gdouble ratio = (gdouble) out_rate / in_rate;
+  // cut at the lower nyquist, below the input's when decimating
+  gdouble fc = ratio < 1.0 ? ratio : 1.0;
+  gdouble half = RESAMPLE_ZEROS / fc;
+  guint32 n, c, count;
+  gfloat *out;
+
+  count = (guint32) ceil (frames * ratio);
+  out = g_new0 (gfloat, (gsize) count * channels);
+
+  for (n = 0; n < count; n++) {
+    gdouble t = n / ratio;
+    gint64 first = (gint64) ceil (t - half);
+    gint64 last = (gint64) floor (t + half);
+    gint64 k;
+
+    if (first < 0)
+      first = 0;
+    if (last > (gint64) frames - 1)
+      last = (gint64) frames - 1;
+    for (c = 0; c < channels; c++) {
+      gdouble acc = 0.0;
+
+      for (k = first; k <= last; k++) {
+        gdouble x = t - k;
+        gdouble h = x == 0.0 ? fc :
+            sin (G_PI * fc * x) / (G_PI * x) * window (x / half);
+
+        acc += h * in[k * channels + c];
+      }
+      // a kernel with more taps has to sum to the same response
+      out[(gsize) n * channels + c] = (gfloat)(acc / ratio);
+    }
+  }
+
+  *out_frames = count;
+  return out;
+}
+
+static gchar * cache_dir (void)
+{
+  const gchar *dir = g_getenv ("VIPERFX_IR_CACHE");
+  gchar *path;
+
+  if (dir != NULL && *dir != '\0')
+    path = g_strdup (dir);
+  else
+    path = g_build_filename (g_get_user_cache_dir (), "viperfx",
+        "kernels", NULL);
+  if (g_mkdir_with_parents (path, 0700) != 0) {
+    g_free (path);
+    return NULL;
+  }
+  return path;
+}
+
+/* sha256 of the file, from the index while path, size and mtime match.
+ * on a miss the mapped file is handed back for decoding
+ */
+static gboolean ir_digest_of (const gchar * path, gchar hex[65],
+    GMappedFile ** mapped, GError ** error)
+{
+  ir_digest *digest;
+  GStatBuf st;
+  gchar *sum;
+
+  *mapped = NULL;
+  if (g_stat (path, &st) != 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "%s: %s", path, g_strerror (errno));
+    return FALSE;
+  }
+
+  g_mutex_lock (&index_lock);
+  if (digest_index == NULL) {
+    digest_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, g_free);
+  }
+  digest = g_hash_table_lookup (digest_index, path);
+  if (digest != NULL && digest->size == (gint64) st.st_size &&
+      digest->mtime == (gint64) st.st_mtime) {
+    memcpy (hex, digest->hex, 65);
+    g_mutex_unlock (&index_lock);
+    return TRUE;
+  }
+  g_mutex_unlock (&index_lock);
+
+  *mapped = g_mapped_file_new (path, FALSE, error);
+  if (*mapped == NULL)
+    return FALSE;
+  sum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+      (const guchar *) g_mapped_file_get_contents (*mapped),
+      g_mapped_file_get_length (*mapped));
+  g_strlcpy (hex, sum, 65);
+  g_free (sum);
+
+  digest = g_new (ir_digest, 1);
+  digest->size = (gint64) st.st_size;
+  digest->mtime = (gint64) st.st_mtime;
+  memcpy (digest->hex, hex, 65);
+  g_mutex_lock (&index_lock);
+  g_hash_table_replace (digest_index, g_strdup (path), digest);
+  g_mutex_unlock (&index_lock);
+  return TRUE;
+}
+
+/* leading 32 bits of the content hash */
+static gint32 ir_id (const gchar * hex)
+{
+  guint32 id = 0;
+  guint i;
+
+  for (i = 0; i < 8; i++)
+    id = (id << 4) | (guint32) g_ascii_xdigit_value (hex[i]);
+  return (gint32) id;
+}
+
+/* a complete entry for rate, NULL for anything else */
+static viperfx_ir * ir_open_entry (const gchar * entry, gint rate)
+{
+  const viperfx_ir_header *header;
+  GMappedFile *mapped;
+  viperfx_ir *ir;
+  gsize length;
+
+  mapped = g_mapped_file_new (entry, FALSE, NULL);
+  if (mapped == NULL)
+    return NULL;
+
+  header = (const viperfx_ir_header *) g_mapped_file_get_contents (mapped);
+  length = g_mapped_file_get_length (mapped);
+  if (length < sizeof(*header) ||
+      memcmp (header->magic, VIPERFX_IR_CACHE_MAGIC, 8) != 0 ||
+      header->rate != (guint32) rate || header->channels == 0 ||
+      length != sizeof(*header) +
+          (gsize) header->frames * header->channels * sizeof(gfloat)) {
+    g_mapped_file_unref (mapped);
+    return NULL;
+  }
+
+  ir = g_new0 (viperfx_ir, 1);
+  ir->refcount = 1;
+  ir->mapped = mapped;
+  ir->samples = (const gfloat *)(header + 1);
+  ir->rate = header->rate;
+  ir->channels = header->channels;
+  ir->frames = header->frames;
+  ir->id = header->id;
+  return ir;
+}
+
+/* a kernel somebody in the process already holds, or the entry on disk
+ * with the cache file name in *entry for the caller to create
+ */
+static viperfx_ir * ir_lookup (const gchar * hex, gint rate, gchar ** entry)
+{
+  viperfx_ir *ir;
+  gchar key[80], *dir;
+
+  g_snprintf (key, sizeof(key), "%s-%d", hex, rate);
+  *entry = NULL;
+
+  g_mutex_lock (&registry_lock);
+  if (registry == NULL)
+    registry = g_hash_table_new (g_str_hash, g_str_equal);
+  ir = g_hash_table_lookup (registry, key);
+  if (ir != NULL)
+    g_atomic_int_inc (&ir->refcount);
+  g_mutex_unlock (&registry_lock);
+  if (ir != NULL)
+    return ir;
+
+  dir = cache_dir ();
+  if (dir == NULL)
+    return NULL;
+  g_strlcat (key, ".vfxk", sizeof(key));
+  *entry = g_build_filename (dir, key, NULL);
+  g_free (dir);
+
+  ir = ir_open_entry (*entry, rate);
+  if (ir == NULL)
+    return NULL;
+  g_free (*entry);
+  *entry = NULL;
+  return ir_register (ir, hex);
+}
+
+/* decode and resample once, keep it on disk if there is a cache */
+static viperfx_ir * ir_create (const gchar * hex, gint rate,
+    const guint8 * data, gsize size, const gchar * entry, GError ** error)
+{
+  viperfx_ir_header header;
+  viperfx_ir *ir = NULL;
+  guint32 in_rate, channels, frames, out_frames;
+  gfloat *decoded, *kernel;
+  gsize bytes;
+
+  decoded = viperfx_ir_decode_wav (data, size, &in_rate, &channels,
+      &frames, error);
+  if (decoded == NULL)
+    return NULL;
+  if (in_rate != (guint32) rate) {
+    kernel = viperfx_ir_resample (decoded, frames, channels, in_rate,
+        (guint32) rate, &out_frames);
+    g_free (decoded);
+  } else {
+    kernel = decoded;
+    out_frames = frames;
+  }
+
+  memset (&header, 0, sizeof(header));
+  memcpy (header.magic, VIPERFX_IR_CACHE_MAGIC, 8);
+  header.rate = (guint32) rate;
+  header.channels = channels;
+  header.frames = out_frames;
+  header.id = ir_id (hex);
+  bytes = (gsize) out_frames * channels * sizeof(gfloat);
+
+  if (entry != NULL) {
+    gchar *contents = g_malloc (sizeof(header) + bytes);
+
+    memcpy (contents, &header, sizeof(header));
+    memcpy (contents + sizeof(header), kernel, bytes);
+    // written to a temporary and renamed, readers never see half an entry
+    if (g_file_set_contents (entry, contents, sizeof(header) + bytes, NULL))
+      ir = ir_open_entry (entry, rate);
+    g_free (contents);
+  }
+  if (ir != NULL) {
+    g_free (kernel);
+    return ir_register (ir, hex);
+  }
+
+  ir = g_new0 (viperfx_ir, 1);
+  ir->refcount = 1;
+  ir->owned = kernel;
+  ir->samples = kernel;
+  ir->rate = header.rate;
+  ir->channels = header.channels;
+  ir->frames = header.frames;
+  ir->id = header.id;
+  return ir_register (ir, hex);
+}
+
+viperfx_ir * viperfx_ir_cache_get (const gchar * path, gint rate,
+    GError ** error)
+{
+  GMappedFile *source = NULL;
+  viperfx_ir *ir;
+  gchar hex[65], *entry;
+
+  if (!ir_digest_of (path, hex, &source, error))
+    return NULL;
+
+  ir = ir_lookup (hex, rate, &entry);
+  if (ir == NULL) {
+    // miss, the index may have spared us mapping the file so far
+    if (source == NULL)
+      source = g_mapped_file_new (path, FALSE, error);
+    if (source != NULL) {
+      ir = ir_create (hex, rate,
+          (const guint8 *) g_mapped_file_get_contents (source),
+          g_mapped_file_get_length (source), entry, error);
+    }
+  }
+
+  if (source != NULL)
+    g_mapped_file_unref (source);
+  g_free (entry);
+  return ir;
+}
+
+void viperfx_ir_digest (GBytes * data, gchar hex[65])
+{
+  gchar *sum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, data);
+
+  g_strlcpy (hex, sum, 65);
+  g_free (sum);
+}
+
+viperfx_ir * viperfx_ir_cache_get_data (const gchar * hex, GBytes * data,
+    gint rate, GError ** error)
+{
+  viperfx_ir *ir;
+  gchar *entry;
+
+  ir = ir_lookup (hex, rate, &entry);
+  if (ir == NULL) {
+    ir = ir_create (hex, rate, g_bytes_get_data (data, NULL),
+        g_bytes_get_size (data), entry, error);
+  }
+  g_free (entry);
+  return ir;
+}
+
+gboolean viperfx_ir_send (viperfx_ir * ir, viperfx_interface * vfx)
+{
+  return viperfx_command_set_kernel (vfx, ir->samples, ir->frames,
+      ir->channels, ir->id);
+}
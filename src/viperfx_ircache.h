@@ -0,0 +1,85 @@
+#ifndef _VIPERFX_IRCACHE_H
+#define _VIPERFX_IRCACHE_H
+
+#include <glib.h>
+#include "viperfx_so.h"
+
+G_BEGIN_DECLS
+
+/* convolver kernels decoded and resampled to the core rate once
+ *
+ * kernels are shared by everything in the process that uses the same
+ * impulse response at the same rate, whether it came as a file or as
+ * bytes in memory.
+ *
+ * entries live in a content-addressed directory, one file per
+ * (sha256 of the impulse response file, core rate), and are mapped
+ * straight from there. the directory is VIPERFX_IR_CACHE or
+ * $XDG_CACHE_HOME/viperfx/kernels. without a usable directory the
+ * kernel is still decoded, just not kept.
+ *
+ * only RIFF/WAVE files (pcm 16/24/32 bit or float, 1, 2 or 4 channels)
+ * are decoded, anything else has to go through the path command.
+ */
+
+#define VIPERFX_IR_CACHE_MAGIC "VFXKERN1"
+
+/* on-disk entry header, followed by frames * channels floats */
+typedef struct _viperfx_ir_header {
+  gchar magic[8];
+  guint32 rate;
+  guint32 channels;
+  guint32 frames;
+  gint32 id;
+  guint32 reserved[2];
+} viperfx_ir_header;
+
+typedef struct _viperfx_ir {
+  volatile gint refcount;
+  /* the cache entry, or owned when there is none */
+  GMappedFile *mapped;
+  gfloat *owned;
+  const gfloat *samples;
+  guint32 rate;
+  guint32 channels;
+  guint32 frames;
+  /* from the content hash, handed to the core with the kernel */
+  gint32 id;
+  /* registry key, content hash and rate */
+  gchar key[80];
+} viperfx_ir;
+
+typedef enum {
+  VIPERFX_IR_ERROR_FORMAT,
+  VIPERFX_IR_ERROR_CORRUPT
+} viperfx_ir_error;
+
+#define VIPERFX_IR_ERROR viperfx_ir_error_quark ()
+GQuark viperfx_ir_error_quark (void);
+
+/* cached kernel for path at rate, decoded and stored on a miss */
+viperfx_ir * viperfx_ir_cache_get (const gchar * path, gint rate,
+    GError ** error);
+
+/* the same for an impulse response file held in memory, hex is its
+ * viperfx_ir_digest */
+void viperfx_ir_digest (GBytes * data, gchar hex[65]);
+viperfx_ir * viperfx_ir_cache_get_data (const gchar * hex, GBytes * data,
+    gint rate, GError ** error);
+
+viperfx_ir * viperfx_ir_ref (viperfx_ir * ir);
+void viperfx_ir_unref (viperfx_ir * ir);
+
+/* interleaved float frames of a RIFF/WAVE file, NULL if it isn't one */
+gfloat * viperfx_ir_decode_wav (const guint8 * data, gsize size,
+    guint32 * rate, guint32 * channels, guint32 * frames, GError ** error);
+/* windowed sinc, any ratio, keeps the frequency response of the kernel */
+gfloat * viperfx_ir_resample (const gfloat * in, guint32 frames,
+    guint32 channels, guint32 in_rate, guint32 out_rate,
+    guint32 * out_frames);
+
+gboolean viperfx_ir_send (viperfx_ir * ir, viperfx_interface * vfx);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,868 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "viperfx_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+#define F32_SCALE 32768.0f
+#define F32_MIN -32768.0f
+#define F32_MAX 32767.0f
+
+/* scalar reference
+*/
+static void headroom_s16_scalar (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx;
+
+  for (idx = 0; idx < count; idx++)
+    dst[idx] = (int16_t)(src[idx] >> 1);
+}
+
+static void makeup_s16_scalar (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx;
+
+  for (idx = 0; idx < count; idx++) {
+    int32_t v = (int32_t) src[idx] * 2;
+
+    v = (v < INT16_MAX) ? v : INT16_MAX;
+    v = (v > INT16_MIN) ? v : INT16_MIN;
+    dst[idx] = (int16_t) v;
+  }
+}
+
+static void f32_to_s16_headroom_scalar (const float * src, int16_t * dst, size_t count)
+{
+  size_t idx;
+
+  for (idx = 0; idx < count; idx++) {
+    float v = src[idx] * F32_SCALE;
+    // same clamp order as maxps/minps, NaN ends up at the lower bound
+    v = (v > F32_MIN) ? v : F32_MIN;
+    v = (v < F32_MAX) ? v : F32_MAX;
+    dst[idx] = (int16_t)(lrintf (v) >> 1);
+  }
+}
+
+static void s32_to_s16_headroom_scalar (const int32_t * src, int16_t * dst, size_t count)
+{
+  size_t idx;
+
+  for (idx = 0; idx < count; idx++)
+    dst[idx] = (int16_t)(src[idx] >> 17);
+}
+
+static void s16_to_f32_scalar (const int16_t * src, float * dst, size_t count)
+{
+  size_t idx;
+
+  for (idx = 0; idx < count; idx++)
+    dst[idx] = (float) src[idx] * (1.0f / F32_SCALE);
+}
+
+static void s16_to_s32_scalar (const int16_t * src, int32_t * dst, size_t count)
+{
+  size_t idx;
+
+  for (idx = 0; idx < count; idx++)
+    dst[idx] = (int32_t)((uint32_t)(uint16_t) src[idx] << 16);
+}
+
+/* eight running sums reduced in a fixed tree, the order every vector
+ * variant ends up with, count must be a multiple of 8
+ */
+static float dot_f32_scalar (const float * a, const float * b, size_t count)
+{
+  float s[8] = { 0.0f };
+  size_t idx, lane;
+
+  for (idx = 0; idx < count; idx += 8) {
+    for (lane = 0; lane < 8; lane++)
+      s[lane] += a[idx + lane] * b[idx + lane];
+  }
+  return ((s[0] + s[4]) + (s[2] + s[6])) + ((s[1] + s[5]) + (s[3] + s[7]));
+}
+
+/* dst holds the incoming core output, src the outgoing one. gains are
+ * per frame, base + frame * step, so every variant sees the same values
+ * and a vector loop can leave the tail from frame first on to this one
+ */
+static void xfade_frames (int16_t * dst, const int16_t * src, size_t first,
+    size_t frames, float gain_in, float gain_out, float step_in, float step_out)
+{
+  size_t idx, ch;
+
+  for (idx = first; idx < frames; idx++) {
+    float gi = gain_in + (float) idx * step_in;
+    float go = gain_out + (float) idx * step_out;
+
+    for (ch = 0; ch < 2; ch++) {
+      float v = (float) dst[idx * 2 + ch] * gi + (float) src[idx * 2 + ch] * go;
+      v = (v > F32_MIN) ? v : F32_MIN;
+      v = (v < F32_MAX) ? v : F32_MAX;
+      dst[idx * 2 + ch] = (int16_t) lrintf (v);
+    }
+  }
+}
+
+static void xfade_s16_scalar (int16_t * dst, const int16_t * src, size_t frames,
+    float gain_in, float gain_out, float step_in, float step_out)
+{
+  xfade_frames (dst, src, 0, frames, gain_in, gain_out, step_in, step_out);
+}
+
+static int is_zero_scalar (const void * data, size_t bytes)
+{
+  const uint8_t *p = data;
+  size_t idx;
+
+  for (idx = 0; idx < bytes; idx++) {
+    if (p[idx] != 0)
+      return 0;
+  }
+  return 1;
+}
+
+static int peak_s16_scalar (const int16_t * src, size_t count)
+{
+  int peak = 0;
+  size_t idx;
+
+  for (idx = 0; idx < count; idx++) {
+    int v = abs (src[idx]);
+
+    if (v > peak)
+      peak = v;
+  }
+  return peak;
+}
+
+/* magnitude from separate extremes, -32768 has no positive s16 */
+static int peak_of (int hi, int lo)
+{
+  return hi > -lo ? hi : -lo;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse2")))
+static void headroom_s16_sse2 (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(src + idx));
+    _mm_storeu_si128 ((__m128i *)(dst + idx), _mm_srai_epi16 (v, 1));
+  }
+  headroom_s16_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("sse2")))
+static void makeup_s16_sse2 (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(src + idx));
+    _mm_storeu_si128 ((__m128i *)(dst + idx), _mm_adds_epi16 (v, v));
+  }
+  makeup_s16_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("sse2")))
+static void f32_to_s16_headroom_sse2 (const float * src, int16_t * dst, size_t count)
+{
+  const __m128 scale = _mm_set1_ps (F32_SCALE);
+  const __m128 lo = _mm_set1_ps (F32_MIN);
+  const __m128 hi = _mm_set1_ps (F32_MAX);
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m128 a = _mm_mul_ps (_mm_loadu_ps (src + idx), scale);
+    __m128 b = _mm_mul_ps (_mm_loadu_ps (src + idx + 4), scale);
+    __m128i p;
+    a = _mm_min_ps (_mm_max_ps (a, lo), hi);
+    b = _mm_min_ps (_mm_max_ps (b, lo), hi);
+    p = _mm_packs_epi32 (_mm_cvtps_epi32 (a), _mm_cvtps_epi32 (b));
+    _mm_storeu_si128 ((__m128i *)(dst + idx), _mm_srai_epi16 (p, 1));
+  }
+  f32_to_s16_headroom_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("sse2")))
+static void s32_to_s16_headroom_sse2 (const int32_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m128i a = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *)(src + idx)), 17);
+    __m128i b = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *)(src + idx + 4)), 17);
+    _mm_storeu_si128 ((__m128i *)(dst + idx), _mm_packs_epi32 (a, b));
+  }
+  s32_to_s16_headroom_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("sse2")))
+static void s16_to_f32_sse2 (const int16_t * src, float * dst, size_t count)
+{
+  const __m128 scale = _mm_set1_ps (1.0f / F32_SCALE);
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(src + idx));
+    __m128i a = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16);
+    __m128i b = _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+    _mm_storeu_ps (dst + idx, _mm_mul_ps (_mm_cvtepi32_ps (a), scale));
+    _mm_storeu_ps (dst + idx + 4, _mm_mul_ps (_mm_cvtepi32_ps (b), scale));
+  }
+  s16_to_f32_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("sse2")))
+static void s16_to_s32_sse2 (const int16_t * src, int32_t * dst, size_t count)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(src + idx));
+    _mm_storeu_si128 ((__m128i *)(dst + idx), _mm_unpacklo_epi16 (zero, v));
+    _mm_storeu_si128 ((__m128i *)(dst + idx + 4), _mm_unpackhi_epi16 (zero, v));
+  }
+  s16_to_s32_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("sse2")))
+static float dot_f32_sse2 (const float * a, const float * b, size_t count)
+{
+  __m128 acc0 = _mm_setzero_ps ();
+  __m128 acc1 = _mm_setzero_ps ();
+  size_t idx;
+
+  for (idx = 0; idx < count; idx += 8) {
+    acc0 = _mm_add_ps (acc0,
+        _mm_mul_ps (_mm_loadu_ps (a + idx), _mm_loadu_ps (b + idx)));
+    acc1 = _mm_add_ps (acc1,
+        _mm_mul_ps (_mm_loadu_ps (a + idx + 4), _mm_loadu_ps (b + idx + 4)));
+  }
+  acc0 = _mm_add_ps (acc0, acc1);
+  acc0 = _mm_add_ps (acc0, _mm_movehl_ps (acc0, acc0));
+  acc0 = _mm_add_ss (acc0, _mm_shuffle_ps (acc0, acc0, 1));
+  return _mm_cvtss_f32 (acc0);
+}
+
+__attribute__((target("sse2")))
+static void xfade_s16_sse2 (int16_t * dst, const int16_t * src, size_t frames,
+    float gain_in, float gain_out, float step_in, float step_out)
+{
+  const __m128 lo = _mm_set1_ps (F32_MIN);
+  const __m128 hi = _mm_set1_ps (F32_MAX);
+  const __m128i lane = _mm_setr_epi32 (0, 0, 1, 1);
+  size_t idx = 0;
+
+  for (; idx + 4 <= frames; idx += 4) {
+    __m128i d = _mm_loadu_si128 ((const __m128i *)(dst + idx * 2));
+    __m128i s = _mm_loadu_si128 ((const __m128i *)(src + idx * 2));
+    __m128i base = _mm_add_epi32 (_mm_set1_epi32 ((int) idx), lane);
+    __m128 fa = _mm_cvtepi32_ps (base);
+    __m128 fb = _mm_cvtepi32_ps (_mm_add_epi32 (base, _mm_set1_epi32 (2)));
+    __m128 gia = _mm_add_ps (_mm_set1_ps (gain_in), _mm_mul_ps (fa, _mm_set1_ps (step_in)));
+    __m128 gib = _mm_add_ps (_mm_set1_ps (gain_in), _mm_mul_ps (fb, _mm_set1_ps (step_in)));
+    __m128 goa = _mm_add_ps (_mm_set1_ps (gain_out), _mm_mul_ps (fa, _mm_set1_ps (step_out)));
+    __m128 gob = _mm_add_ps (_mm_set1_ps (gain_out), _mm_mul_ps (fb, _mm_set1_ps (step_out)));
+    __m128 da = _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (d, d), 16));
+    __m128 db = _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpackhi_epi16 (d, d), 16));
+    __m128 sa = _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (s, s), 16));
+    __m128 sb = _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpackhi_epi16 (s, s), 16));
+    __m128 a = _mm_add_ps (_mm_mul_ps (da, gia), _mm_mul_ps (sa, goa));
+    __m128 b = _mm_add_ps (_mm_mul_ps (db, gib), _mm_mul_ps (sb, gob));
+    a = _mm_min_ps (_mm_max_ps (a, lo), hi);
+    b = _mm_min_ps (_mm_max_ps (b, lo), hi);
+    _mm_storeu_si128 ((__m128i *)(dst + idx * 2),
+        _mm_packs_epi32 (_mm_cvtps_epi32 (a), _mm_cvtps_epi32 (b)));
+  }
+  xfade_frames (dst, src, idx, frames, gain_in, gain_out, step_in, step_out);
+}
+
+__attribute__((target("sse2")))
+static int is_zero_sse2 (const void * data, size_t bytes)
+{
+  const uint8_t *p = data;
+  const __m128i zero = _mm_setzero_si128 ();
+  size_t idx = 0;
+
+  // one test per cache line, silence has to be read through anyway
+  for (; idx + 64 <= bytes; idx += 64) {
+    __m128i acc = _mm_or_si128 (
+        _mm_or_si128 (_mm_loadu_si128 ((const __m128i *)(p + idx)),
+            _mm_loadu_si128 ((const __m128i *)(p + idx + 16))),
+        _mm_or_si128 (_mm_loadu_si128 ((const __m128i *)(p + idx + 32)),
+            _mm_loadu_si128 ((const __m128i *)(p + idx + 48))));
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (acc, zero)) != 0xFFFF)
+      return 0;
+  }
+  return is_zero_scalar (p + idx, bytes - idx);
+}
+
+__attribute__((target("sse2")))
+static int peak_s16_sse2 (const int16_t * src, size_t count)
+{
+  __m128i hi = _mm_setzero_si128 ();
+  __m128i lo = _mm_setzero_si128 ();
+  int16_t h[8], l[8];
+  int peak;
+  size_t idx = 0, i;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(src + idx));
+    hi = _mm_max_epi16 (hi, v);
+    lo = _mm_min_epi16 (lo, v);
+  }
+  _mm_storeu_si128 ((__m128i *) h, hi);
+  _mm_storeu_si128 ((__m128i *) l, lo);
+  peak = peak_s16_scalar (src + idx, count - idx);
+  for (i = 0; i < 8; i++) {
+    int v = peak_of (h[i], l[i]);
+
+    if (v > peak)
+      peak = v;
+  }
+  return peak;
+}
+
+__attribute__((target("avx2")))
+static void headroom_s16_avx2 (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 16 <= count; idx += 16) {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *)(src + idx));
+    _mm256_storeu_si256 ((__m256i *)(dst + idx), _mm256_srai_epi16 (v, 1));
+  }
+  headroom_s16_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("avx2")))
+static void makeup_s16_avx2 (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 16 <= count; idx += 16) {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *)(src + idx));
+    _mm256_storeu_si256 ((__m256i *)(dst + idx), _mm256_adds_epi16 (v, v));
+  }
+  makeup_s16_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("avx2")))
+static void f32_to_s16_headroom_avx2 (const float * src, int16_t * dst, size_t count)
+{
+  const __m256 scale = _mm256_set1_ps (F32_SCALE);
+  const __m256 lo = _mm256_set1_ps (F32_MIN);
+  const __m256 hi = _mm256_set1_ps (F32_MAX);
+  size_t idx = 0;
+
+  for (; idx + 16 <= count; idx += 16) {
+    __m256 a = _mm256_mul_ps (_mm256_loadu_ps (src + idx), scale);
+    __m256 b = _mm256_mul_ps (_mm256_loadu_ps (src + idx + 8), scale);
+    __m256i p;
+    a = _mm256_min_ps (_mm256_max_ps (a, lo), hi);
+    b = _mm256_min_ps (_mm256_max_ps (b, lo), hi);
+    // packs works per 128-bit lane, restore sample order afterwards
+    p = _mm256_packs_epi32 (_mm256_cvtps_epi32 (a), _mm256_cvtps_epi32 (b));
+    p = _mm256_permute4x64_epi64 (p, 0xD8);
+    _mm256_storeu_si256 ((__m256i *)(dst + idx), _mm256_srai_epi16 (p, 1));
+  }
+  f32_to_s16_headroom_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("avx2")))
+static void s32_to_s16_headroom_avx2 (const int32_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 16 <= count; idx += 16) {
+    __m256i a = _mm256_srai_epi32 (_mm256_loadu_si256 ((const __m256i *)(src + idx)), 17);
+    __m256i b = _mm256_srai_epi32 (_mm256_loadu_si256 ((const __m256i *)(src + idx + 8)), 17);
+    __m256i p = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (a, b), 0xD8);
+    _mm256_storeu_si256 ((__m256i *)(dst + idx), p);
+  }
+  s32_to_s16_headroom_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("avx2")))
+static void s16_to_f32_avx2 (const int16_t * src, float * dst, size_t count)
+{
+  const __m256 scale = _mm256_set1_ps (1.0f / F32_SCALE);
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m256i v = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)(src + idx)));
+    _mm256_storeu_ps (dst + idx, _mm256_mul_ps (_mm256_cvtepi32_ps (v), scale));
+  }
+  s16_to_f32_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("avx2")))
+static void s16_to_s32_avx2 (const int16_t * src, int32_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    __m256i v = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)(src + idx)));
+    _mm256_storeu_si256 ((__m256i *)(dst + idx), _mm256_slli_epi32 (v, 16));
+  }
+  s16_to_s32_scalar (src + idx, dst + idx, count - idx);
+}
+
+__attribute__((target("avx2")))
+static float dot_f32_avx2 (const float * a, const float * b, size_t count)
+{
+  __m256 acc = _mm256_setzero_ps ();
+  __m128 sum;
+  size_t idx;
+
+  for (idx = 0; idx < count; idx += 8) {
+    acc = _mm256_add_ps (acc,
+        _mm256_mul_ps (_mm256_loadu_ps (a + idx), _mm256_loadu_ps (b + idx)));
+  }
+  sum = _mm_add_ps (_mm256_castps256_ps128 (acc),
+      _mm256_extractf128_ps (acc, 1));
+  sum = _mm_add_ps (sum, _mm_movehl_ps (sum, sum));
+  sum = _mm_add_ss (sum, _mm_shuffle_ps (sum, sum, 1));
+  return _mm_cvtss_f32 (sum);
+}
+__attribute__((target("avx2")))
+static void xfade_s16_avx2 (int16_t * dst, const int16_t * src, size_t frames,
+    float gain_in, float gain_out, float step_in, float step_out)
+{
+  const __m256 lo = _mm256_set1_ps (F32_MIN);
+  const __m256 hi = _mm256_set1_ps (F32_MAX);
+  const __m256i lane = _mm256_setr_epi32 (0, 0, 1, 1, 2, 2, 3, 3);
+  size_t idx = 0;
+
+  for (; idx + 8 <= frames; idx += 8) {
+    __m256i base = _mm256_add_epi32 (_mm256_set1_epi32 ((int) idx), lane);
+    __m256 fa = _mm256_cvtepi32_ps (base);
+    __m256 fb = _mm256_cvtepi32_ps (_mm256_add_epi32 (base, _mm256_set1_epi32 (4)));
+    __m256 gia = _mm256_add_ps (_mm256_set1_ps (gain_in), _mm256_mul_ps (fa, _mm256_set1_ps (step_in)));
+    __m256 gib = _mm256_add_ps (_mm256_set1_ps (gain_in), _mm256_mul_ps (fb, _mm256_set1_ps (step_in)));
+    __m256 goa = _mm256_add_ps (_mm256_set1_ps (gain_out), _mm256_mul_ps (fa, _mm256_set1_ps (step_out)));
+    __m256 gob = _mm256_add_ps (_mm256_set1_ps (gain_out), _mm256_mul_ps (fb, _mm256_set1_ps (step_out)));
+    __m256 da = _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)(dst + idx * 2))));
+    __m256 db = _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)(dst + idx * 2 + 8))));
+    __m256 sa = _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)(src + idx * 2))));
+    __m256 sb = _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)(src + idx * 2 + 8))));
+    __m256 a = _mm256_add_ps (_mm256_mul_ps (da, gia), _mm256_mul_ps (sa, goa));
+    __m256 b = _mm256_add_ps (_mm256_mul_ps (db, gib), _mm256_mul_ps (sb, gob));
+    __m256i p;
+    a = _mm256_min_ps (_mm256_max_ps (a, lo), hi);
+    b = _mm256_min_ps (_mm256_max_ps (b, lo), hi);
+    p = _mm256_packs_epi32 (_mm256_cvtps_epi32 (a), _mm256_cvtps_epi32 (b));
+    _mm256_storeu_si256 ((__m256i *)(dst + idx * 2), _mm256_permute4x64_epi64 (p, 0xD8));
+  }
+  xfade_frames (dst, src, idx, frames, gain_in, gain_out, step_in, step_out);
+}
+
+__attribute__((target("avx2")))
+static int is_zero_avx2 (const void * data, size_t bytes)
+{
+  const uint8_t *p = data;
+  size_t idx = 0;
+
+  for (; idx + 128 <= bytes; idx += 128) {
+    __m256i acc = _mm256_or_si256 (
+        _mm256_or_si256 (_mm256_loadu_si256 ((const __m256i *)(p + idx)),
+            _mm256_loadu_si256 ((const __m256i *)(p + idx + 32))),
+        _mm256_or_si256 (_mm256_loadu_si256 ((const __m256i *)(p + idx + 64)),
+            _mm256_loadu_si256 ((const __m256i *)(p + idx + 96))));
+    if (!_mm256_testz_si256 (acc, acc))
+      return 0;
+  }
+  return is_zero_scalar (p + idx, bytes - idx);
+}
+
+__attribute__((target("avx2")))
+static int peak_s16_avx2 (const int16_t * src, size_t count)
+{
+  __m256i hi = _mm256_setzero_si256 ();
+  __m256i lo = _mm256_setzero_si256 ();
+  int16_t h[16], l[16];
+  int peak;
+  size_t idx = 0, i;
+
+  for (; idx + 16 <= count; idx += 16) {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *)(src + idx));
+    hi = _mm256_max_epi16 (hi, v);
+    lo = _mm256_min_epi16 (lo, v);
+  }
+  _mm256_storeu_si256 ((__m256i *) h, hi);
+  _mm256_storeu_si256 ((__m256i *) l, lo);
+  peak = peak_s16_scalar (src + idx, count - idx);
+  for (i = 0; i < 16; i++) {
+    int v = peak_of (h[i], l[i]);
+
+    if (v > peak)
+      peak = v;
+  }
+  return peak;
+}
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+static void headroom_s16_neon (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8)
+    vst1q_s16 (dst + idx, vshrq_n_s16 (vld1q_s16 (src + idx), 1));
+  headroom_s16_scalar (src + idx, dst + idx, count - idx);
+}
+
+static void makeup_s16_neon (const int16_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    int16x8_t v = vld1q_s16 (src + idx);
+
+    vst1q_s16 (dst + idx, vqaddq_s16 (v, v));
+  }
+  makeup_s16_scalar (src + idx, dst + idx, count - idx);
+}
+
+static void f32_to_s16_headroom_neon (const float * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+#ifdef __aarch64__
+  const float32x4_t lo = vdupq_n_f32 (F32_MIN);
+  const float32x4_t hi = vdupq_n_f32 (F32_MAX);
+
+  for (; idx + 8 <= count; idx += 8) {
+    float32x4_t a = vmulq_n_f32 (vld1q_f32 (src + idx), F32_SCALE);
+    float32x4_t b = vmulq_n_f32 (vld1q_f32 (src + idx + 4), F32_SCALE);
+    int16x8_t p;
+    // compare and select to match the scalar NaN handling
+    a = vbslq_f32 (vcgtq_f32 (a, lo), a, lo);
+    a = vbslq_f32 (vcltq_f32 (a, hi), a, hi);
+    b = vbslq_f32 (vcgtq_f32 (b, lo), b, lo);
+    b = vbslq_f32 (vcltq_f32 (b, hi), b, hi);
+    p = vcombine_s16 (vqmovn_s32 (vcvtnq_s32_f32 (a)),
+        vqmovn_s32 (vcvtnq_s32_f32 (b)));
+    vst1q_s16 (dst + idx, vshrq_n_s16 (p, 1));
+  }
+#endif
+  // armv7 has no round-to-nearest conversion, stay on the reference
+  f32_to_s16_headroom_scalar (src + idx, dst + idx, count - idx);
+}
+
+static void s32_to_s16_headroom_neon (const int32_t * src, int16_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    int16x4_t a = vmovn_s32 (vshrq_n_s32 (vld1q_s32 (src + idx), 17));
+    int16x4_t b = vmovn_s32 (vshrq_n_s32 (vld1q_s32 (src + idx + 4), 17));
+    vst1q_s16 (dst + idx, vcombine_s16 (a, b));
+  }
+  s32_to_s16_headroom_scalar (src + idx, dst + idx, count - idx);
+}
+
+static void s16_to_f32_neon (const int16_t * src, float * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    int16x8_t v = vld1q_s16 (src + idx);
+    float32x4_t a = vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (v)));
+    float32x4_t b = vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (v)));
+    vst1q_f32 (dst + idx, vmulq_n_f32 (a, 1.0f / F32_SCALE));
+    vst1q_f32 (dst + idx + 4, vmulq_n_f32 (b, 1.0f / F32_SCALE));
+  }
+  s16_to_f32_scalar (src + idx, dst + idx, count - idx);
+}
+
+static void s16_to_s32_neon (const int16_t * src, int32_t * dst, size_t count)
+{
+  size_t idx = 0;
+
+  for (; idx + 8 <= count; idx += 8) {
+    int16x8_t v = vld1q_s16 (src + idx);
+    vst1q_s32 (dst + idx, vshll_n_s16 (vget_low_s16 (v), 16));
+    vst1q_s32 (dst + idx + 4, vshll_n_s16 (vget_high_s16 (v), 16));
+  }
+  s16_to_s32_scalar (src + idx, dst + idx, count - idx);
+}
+
+static float dot_f32_neon (const float * a, const float * b, size_t count)
+{
+  float32x4_t acc0 = vdupq_n_f32 (0.0f);
+  float32x4_t acc1 = vdupq_n_f32 (0.0f);
+  float32x2_t sum;
+  size_t idx;
+
+  // separate multiply and add, a fused vmla would round differently
+  for (idx = 0; idx < count; idx += 8) {
+    acc0 = vaddq_f32 (acc0,
+        vmulq_f32 (vld1q_f32 (a + idx), vld1q_f32 (b + idx)));
+    acc1 = vaddq_f32 (acc1,
+        vmulq_f32 (vld1q_f32 (a + idx + 4), vld1q_f32 (b + idx + 4)));
+  }
+  acc0 = vaddq_f32 (acc0, acc1);
+  sum = vadd_f32 (vget_low_f32 (acc0), vget_high_f32 (acc0));
+  return vget_lane_f32 (sum, 0) + vget_lane_f32 (sum, 1);
+}
+static void xfade_s16_neon (int16_t * dst, const int16_t * src, size_t frames,
+    float gain_in, float gain_out, float step_in, float step_out)
+{
+  size_t idx = 0;
+#ifdef __aarch64__
+  const float32x4_t lo = vdupq_n_f32 (F32_MIN);
+  const float32x4_t hi = vdupq_n_f32 (F32_MAX);
+  const int32_t lane_init[4] = { 0, 0, 1, 1 };
+  const int32x4_t lane = vld1q_s32 (lane_init);
+
+  for (; idx + 4 <= frames; idx += 4) {
+    int16x8_t d = vld1q_s16 (dst + idx * 2);
+    int16x8_t s = vld1q_s16 (src + idx * 2);
+    int32x4_t base = vaddq_s32 (vdupq_n_s32 ((int32_t) idx), lane);
+    float32x4_t fa = vcvtq_f32_s32 (base);
+    float32x4_t fb = vcvtq_f32_s32 (vaddq_s32 (base, vdupq_n_s32 (2)));
+    // separate multiply and add like the reference
+    float32x4_t gia = vaddq_f32 (vdupq_n_f32 (gain_in), vmulq_n_f32 (fa, step_in));
+    float32x4_t gib = vaddq_f32 (vdupq_n_f32 (gain_in), vmulq_n_f32 (fb, step_in));
+    float32x4_t goa = vaddq_f32 (vdupq_n_f32 (gain_out), vmulq_n_f32 (fa, step_out));
+    float32x4_t gob = vaddq_f32 (vdupq_n_f32 (gain_out), vmulq_n_f32 (fb, step_out));
+    float32x4_t a = vaddq_f32 (
+        vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (d))), gia),
+        vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (s))), goa));
+    float32x4_t b = vaddq_f32 (
+        vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (d))), gib),
+        vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (s))), gob));
+    a = vbslq_f32 (vcgtq_f32 (a, lo), a, lo);
+    a = vbslq_f32 (vcltq_f32 (a, hi), a, hi);
+    b = vbslq_f32 (vcgtq_f32 (b, lo), b, lo);
+    b = vbslq_f32 (vcltq_f32 (b, hi), b, hi);
+    vst1q_s16 (dst + idx * 2, vcombine_s16 (vqmovn_s32 (vcvtnq_s32_f32 (a)),
+        vqmovn_s32 (vcvtnq_s32_f32 (b))));
+  }
+#endif
+  xfade_frames (dst, src, idx, frames, gain_in, gain_out, step_in, step_out);
+}
+
+static int is_zero_neon (const void * data, size_t bytes)
+{
+  const uint8_t *p = data;
+  size_t idx = 0;
+
+  for (; idx + 64 <= bytes; idx += 64) {
+    uint8x16_t acc = vorrq_u8 (
+        vorrq_u8 (vld1q_u8 (p + idx), vld1q_u8 (p + idx + 16)),
+        vorrq_u8 (vld1q_u8 (p + idx + 32), vld1q_u8 (p + idx + 48)));
+    uint64x2_t wide = vreinterpretq_u64_u8 (acc);
+
+    if ((vgetq_lane_u64 (wide, 0) | vgetq_lane_u64 (wide, 1)) != 0)
+      return 0;
+  }
+  return is_zero_scalar (p + idx, bytes - idx);
+}
+
+static int peak_s16_neon (const int16_t * src, size_t count)
+{
+  int16x8_t hi = vdupq_n_s16 (0);
+  int16x8_t lo = vdupq_n_s16 (0);
+  int16_t h[8], l[8];
+  int peak;
+  size_t idx = 0, i;
+
+  for (; idx + 8 <= count; idx += 8) {
+    int16x8_t v = vld1q_s16 (src + idx);
+    hi = vmaxq_s16 (hi, v);
+    lo = vminq_s16 (lo, v);
+  }
+  vst1q_s16 (h, hi);
+  vst1q_s16 (l, lo);
+  peak = peak_s16_scalar (src + idx, count - idx);
+  for (i = 0; i < 8; i++) {
+    int v = peak_of (h[i], l[i]);
+
+    if (v > peak)
+      peak = v;
+  }
+  return peak;
+}
+#endif
+
+static const viperfx_kernels kernel_table[VIPERFX_ISA_COUNT] = {
+  [VIPERFX_ISA_SCALAR] = { VIPERFX_ISA_SCALAR, "scalar",
+      headroom_s16_scalar, makeup_s16_scalar,
+      f32_to_s16_headroom_scalar, s32_to_s16_headroom_scalar,
+      s16_to_f32_scalar, s16_to_s32_scalar,
+      dot_f32_scalar,
+      xfade_s16_scalar,
+      is_zero_scalar, peak_s16_scalar },
+#ifdef HAVE_X86_KERNELS
+  [VIPERFX_ISA_SSE2] = { VIPERFX_ISA_SSE2, "sse2",
+      headroom_s16_sse2, makeup_s16_sse2,
+      f32_to_s16_headroom_sse2, s32_to_s16_headroom_sse2,
+      s16_to_f32_sse2, s16_to_s32_sse2,
+      dot_f32_sse2,
+      xfade_s16_sse2,
+      is_zero_sse2, peak_s16_sse2 },
+  [VIPERFX_ISA_AVX2] = { VIPERFX_ISA_AVX2, "avx2",
+      headroom_s16_avx2, makeup_s16_avx2,
+      f32_to_s16_headroom_avx2, s32_to_s16_headroom_avx2,
+      s16_to_f32_avx2, s16_to_s32_avx2,
+      dot_f32_avx2,
+      xfade_s16_avx2,
+      is_zero_avx2, peak_s16_avx2 },
+#endif
+#ifdef HAVE_NEON_KERNELS
+  [VIPERFX_ISA_NEON] = { VIPERFX_ISA_NEON, "neon",
+      headroom_s16_neon, makeup_s16_neon,
+      f32_to_s16_headroom_neon, s32_to_s16_headroom_neon,
+      s16_to_f32_neon, s16_to_s32_neon,
+      dot_f32_neon,
+      xfade_s16_neon,
+      is_zero_neon, peak_s16_neon },
+#endif
+};
+
+static int isa_supported (int isa)
+{
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init ();
+#endif
+
+  switch (isa) {
+    case VIPERFX_ISA_SCALAR:
+      return 1;
+#ifdef HAVE_X86_KERNELS
+    case VIPERFX_ISA_SSE2:
+      return __builtin_cpu_supports ("sse2");
+    case VIPERFX_ISA_AVX2:
+      return __builtin_cpu_supports ("avx2");
+#endif
+#ifdef HAVE_NEON_KERNELS
+    case VIPERFX_ISA_NEON:
+      // the build already targets neon
+      return 1;
+#endif
+    default:
+      return 0;
+  }
+}
+
+void * viperfx_aligned_alloc (size_t size)
+{
+  void * ptr = NULL;
+
+  if (posix_memalign (&ptr, VIPERFX_KERNEL_ALIGN, size) != 0)
+    return NULL;
+  return ptr;
+}
+
+void viperfx_aligned_free (void * ptr)
+{
+  free (ptr);
+}
+
+/* strided copies, specialised on the sample width so the inner loop
+ * is a plain load/store pair
+ */
+void viperfx_pair_gather (const void * src, void * dst, size_t width,
+    size_t channels, size_t left, size_t right, size_t frames)
+{
+  size_t i;
+
+  if (width == 2) {
+    const int16_t * s = src;
+    int16_t * d = dst;
+    for (i = 0; i < frames; i++, s += channels) {
+      d[2 * i] = s[left];
+      d[2 * i + 1] = s[right];
+    }
+  } else {
+    const int32_t * s = src;
+    int32_t * d = dst;
+    for (i = 0; i < frames; i++, s += channels) {
+      d[2 * i] = s[left];
+      d[2 * i + 1] = s[right];
+    }
+  }
+}
+
+void viperfx_pair_scatter (const void * src, void * dst, size_t width,
+    size_t channels, size_t left, size_t right, size_t frames)
+{
+  size_t i;
+
+  if (width == 2) {
+    const int16_t * s = src;
+    int16_t * d = dst;
+    for (i = 0; i < frames; i++, d += channels) {
+      d[left] = s[2 * i];
+      d[right] = s[2 * i + 1];
+    }
+  } else {
+    const int32_t * s = src;
+    int32_t * d = dst;
+    for (i = 0; i < frames; i++, d += channels) {
+      d[left] = s[2 * i];
+      d[right] = s[2 * i + 1];
+    }
+  }
+}
+
+const viperfx_kernels * viperfx_kernels_get (int isa)
+{
+  if (isa < 0 || isa >= VIPERFX_ISA_COUNT)
+    return NULL;
+  if (kernel_table[isa].name == NULL || !isa_supported (isa))
+    return NULL;
+  return &kernel_table[isa];
+}
+
+const viperfx_kernels * viperfx_kernels_best (void)
+{
+  static const viperfx_kernels * best = NULL;
+  const viperfx_kernels * found;
+  const char * force;
+  int isa;
+
+  found = __atomic_load_n (&best, __ATOMIC_ACQUIRE);
+  if (found != NULL)
+    return found;
+
+  found = &kernel_table[VIPERFX_ISA_SCALAR];
+  for (isa = VIPERFX_ISA_COUNT - 1; isa > VIPERFX_ISA_SCALAR; isa--) {
+    if (viperfx_kernels_get (isa) != NULL) {
+      found = &kernel_table[isa];
+      break;
+    }
+  }
+
+  // VIPERFX_KERNELS=scalar|sse2|avx2|neon pins a variant for debugging
+  force = getenv ("VIPERFX_KERNELS");
+  if (force != NULL) {
+    for (isa = 0; isa < VIPERFX_ISA_COUNT; isa++) {
+      if (viperfx_kernels_get (isa) != NULL &&
+          strcmp (force, kernel_table[isa].name) == 0) {
+        found = &kernel_table[isa];
+        break;
+      }
+    }
+  }
+
+  __atomic_store_n (&best, found, __ATOMIC_RELEASE);
+  return found;
+}
@@ -0,0 +1,77 @@
+#ifndef _VIPERFX_KERNELS_H
+#define _VIPERFX_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* sample conversion kernels around the s16 core
+ *
+ * every kernel has a scalar reference, the vector variants must be
+ * bit-exact with it. src and dst may only alias for kernels whose
+ * input and output sample sizes match.
+ */
+
+enum
+{
+	VIPERFX_ISA_SCALAR = 0,
+	VIPERFX_ISA_SSE2,
+	VIPERFX_ISA_AVX2,
+	VIPERFX_ISA_NEON,
+
+	VIPERFX_ISA_COUNT
+};
+
+typedef struct _viperfx_kernels {
+  int isa;
+  const char * name;
+  /* halve every sample to leave headroom for the core */
+  void (*headroom_s16) (const int16_t * src, int16_t * dst, size_t count);
+  /* double every sample with saturation, undoing the shift after the core */
+  void (*makeup_s16) (const int16_t * src, int16_t * dst, size_t count);
+  /* convert into the core format, headroom shift included */
+  void (*f32_to_s16_headroom) (const float * src, int16_t * dst, size_t count);
+  void (*s32_to_s16_headroom) (const int32_t * src, int16_t * dst, size_t count);
+  /* convert the core output back */
+  void (*s16_to_f32) (const int16_t * src, float * dst, size_t count);
+  void (*s16_to_s32) (const int16_t * src, int32_t * dst, size_t count);
+  /* filter tap sum for the resampler, count a multiple of 8 */
+  float (*dot_f32) (const float * a, const float * b, size_t count);
+  /* mix src into dst, both interleaved stereo, with gains moving
+   * linearly from gain_in/gain_out by step_in/step_out per frame
+   */
+  void (*xfade_s16) (int16_t * dst, const int16_t * src, size_t frames,
+      float gain_in, float gain_out, float step_in, float step_out);
+  /* whether a buffer of any sample format holds nothing but zero bytes */
+  int (*is_zero) (const void * data, size_t bytes);
+  /* largest magnitude, 32768 for a full scale negative sample */
+  int (*peak_s16) (const int16_t * src, size_t count);
+} viperfx_kernels;
+
+#define VIPERFX_KERNEL_ALIGN 64
+
+/* scratch memory aligned for the widest vector loads */
+void * viperfx_aligned_alloc (size_t size);
+void viperfx_aligned_free (void * ptr);
+
+/* copy channels left/right of an interleaved stream to or from a
+ * packed stereo buffer, width is the sample size in bytes (2 or 4)
+ */
+void viperfx_pair_gather (const void * src, void * dst, size_t width,
+    size_t channels, size_t left, size_t right, size_t frames);
+void viperfx_pair_scatter (const void * src, void * dst, size_t width,
+    size_t channels, size_t left, size_t right, size_t frames);
+
+/* returns NULL when the variant is not built in or not supported by the cpu */
+const viperfx_kernels * viperfx_kernels_get (int isa);
+/* the fastest variant usable on this cpu, never NULL */
+const viperfx_kernels * viperfx_kernels_best (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
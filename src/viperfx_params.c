@@ -0,0 +1,523 @@
+#include <string.h>
+#include <gst/gst.h>
+#include "viperfx_params.h"
+
+/* colorful music depth arrives as 0..32767 and is sent as 200..800
+*/
+static gint32 colm_depth_to_core (gint32 value)
+{
+  float f_depth_val = (float) value;
+  gint32 s_val = 0;
+
+  f_depth_val = (f_depth_val / 32767.00f) * 600.00f;
+  s_val = (gint32) (f_depth_val + 200.0f);
+  if (s_val < 200) s_val = 200;
+  if (s_val > 800) s_val = 800;
+  return s_val;
+}
+
+/* diff-surround level arrives in percent and is sent as delay time
+*/
+static gint32 ds_level_to_core (gint32 value)
+{
+  gint32 s_val = value * 20;
+
+  if (s_val < 0) s_val = 0;
+  if (s_val > 2000) s_val = 2000;
+  return s_val;
+}
+
+#define PARAM_BOOL(n, k, b, def, id) \
+  { n, k, b, TRUE, FALSE, TRUE, def, id, -1, NULL, TRUE }
+#define PARAM_INT(n, k, b, min, max, def, id) \
+  { n, k, b, FALSE, min, max, def, id, -1, NULL, FALSE }
+/* discrete choice, switches the whole module like a boolean */
+#define PARAM_MODE(n, k, b, min, max, def, id) \
+  { n, k, b, FALSE, min, max, def, id, -1, NULL, TRUE }
+#define PARAM_EQ_BAND(n, k, b, band) \
+  { n, k, b, FALSE, -1200, 1200, 0, PARAM_HPFX_FIREQ_BANDLEVEL, band, NULL, FALSE }
+
+const viperfx_param_desc viperfx_params[VIPERFX_PARAM_COUNT] = {
+  /* convolver */
+  [VIPERFX_PARAM_CONV_CC_LEVEL] = PARAM_INT ("conv_cc_level", "ConvEnabled",
+      "Cross-channel level (percent)", 0, 100, 0,
+      PARAM_HPFX_CONV_CROSSCHANNEL),
+  [VIPERFX_PARAM_CONV_ENABLE] = PARAM_BOOL ("conv_enable", "ConvEnabled",
+      "Enable convolver", FALSE,
+      PARAM_HPFX_CONV_PROCESS_ENABLED),
+
+  /* vhe */
+  [VIPERFX_PARAM_VHE_LEVEL] = PARAM_INT ("vhe_level", "VHELevel",
+      "VHE level", 0, 4, 0,
+      PARAM_HPFX_VHE_EFFECT_LEVEL),
+  [VIPERFX_PARAM_VHE_ENABLE] = PARAM_BOOL ("vhe_enable", "VHEEnabled",
+      "Enable viper headphone engine", FALSE,
+      PARAM_HPFX_VHE_PROCESS_ENABLED),
+
+  /* vse */
+  [VIPERFX_PARAM_VSE_REF_BARK] = PARAM_INT ("vse_ref_bark", "VSERefBark",
+      "VSE reference bark frequency", 800, 20000, 7600,
+      PARAM_HPFX_VSE_REFERENCE_BARK),
+  [VIPERFX_PARAM_VSE_BARK_CONS] = PARAM_INT ("vse_bark_cons", "VSEBarkCons",
+      "VSE bark reconstruct level", 10, 100, 10,
+      PARAM_HPFX_VSE_BARK_RECONSTRUCT),
+  [VIPERFX_PARAM_VSE_ENABLE] = PARAM_BOOL ("vse_enable", "VSEEnabled",
+      "Enable viper spectrum extend", FALSE,
+      PARAM_HPFX_VSE_PROCESS_ENABLED),
+
+  /* equalizer */
+  [VIPERFX_PARAM_EQ_BAND1] = PARAM_EQ_BAND ("eq_band1", "EQBand1",
+      "Gain of eq band 1", 0),
+  [VIPERFX_PARAM_EQ_BAND2] = PARAM_EQ_BAND ("eq_band2", "EQBand2",
+      "Gain of eq band 2", 1),
+  [VIPERFX_PARAM_EQ_BAND3] = PARAM_EQ_BAND ("eq_band3", "EQBand3",
+      "Gain of eq band 3", 2),
+  [VIPERFX_PARAM_EQ_BAND4] = PARAM_EQ_BAND ("eq_band4", "EQBand4",
+      "Gain of eq band 4", 3),
+  [VIPERFX_PARAM_EQ_BAND5] = PARAM_EQ_BAND ("eq_band5", "EQBand5",
+      "Gain of eq band 5", 4),
+  [VIPERFX_PARAM_EQ_BAND6] = PARAM_EQ_BAND ("eq_band6", "EQBand6",
+      "Gain of eq band 6", 5),
+  [VIPERFX_PARAM_EQ_BAND7] = PARAM_EQ_BAND ("eq_band7", "EQBand7",
+      "Gain of eq band 7", 6),
+  [VIPERFX_PARAM_EQ_BAND8] = PARAM_EQ_BAND ("eq_band8", "EQBand8",
+      "Gain of eq band 8", 7),
+  [VIPERFX_PARAM_EQ_BAND9] = PARAM_EQ_BAND ("eq_band9", "EQBand9",
+      "Gain of eq band 9", 8),
+  [VIPERFX_PARAM_EQ_BAND10] = PARAM_EQ_BAND ("eq_band10", "EQBand10",
+      "Gain of eq band 10", 9),
+  [VIPERFX_PARAM_EQ_ENABLE] = PARAM_BOOL ("eq_enable", "EQEnable",
+      "Enable FIR linear equalizer", FALSE,
+      PARAM_HPFX_FIREQ_PROCESS_ENABLED),
+
+  /* colorful music */
+  [VIPERFX_PARAM_COLM_WIDENING] = PARAM_INT ("colm_widening", "COLMWidening",
+      "Widening of colorful music", 0, 800, 100,
+      PARAM_HPFX_COLM_WIDENING),
+  [VIPERFX_PARAM_COLM_MIDIMAGE] = PARAM_INT ("colm_midimage", "COLMMidImage",
+      "Mid-image of colorful music", 0, 800, 100,
+      PARAM_HPFX_COLM_MIDIMAGE),
+  [VIPERFX_PARAM_COLM_DEPTH] = { "colm_depth", "COLMDepth",
+      "Depth of colorful music", FALSE, 0, 32767, 0,
+      PARAM_HPFX_COLM_DEPTH, -1, colm_depth_to_core },
+  [VIPERFX_PARAM_COLM_ENABLE] = PARAM_BOOL ("colm_enable", "COLMEnabled",
+      "Enable colorful music", FALSE,
+      PARAM_HPFX_COLM_PROCESS_ENABLED),
+
+  /* diff surr */
+  [VIPERFX_PARAM_DS_LEVEL] = { "ds_level", "DSLevel",
+      "Diff-surround level (percent)", FALSE, 0, 100, 0,
+      PARAM_HPFX_DIFFSURR_DELAYTIME, -1, ds_level_to_core },
+  [VIPERFX_PARAM_DS_ENABLE] = PARAM_BOOL ("ds_enable", "DSEnabled",
+      "Enable diff-surround", FALSE,
+      PARAM_HPFX_DIFFSURR_PROCESS_ENABLED),
+
+  /* reverb */
+  [VIPERFX_PARAM_REVERB_ROOMSIZE] = PARAM_INT ("reverb_roomsize", "ReverbRoomSize",
+      "Reverb room size (percent)", 1, 100, 30,
+      PARAM_HPFX_REVB_ROOMSIZE),
+  [VIPERFX_PARAM_REVERB_WIDTH] = PARAM_INT ("reverb_width", "ReverbWidth",
+      "Reveb room width (percent)", 1, 100, 40,
+      PARAM_HPFX_REVB_WIDTH),
+  [VIPERFX_PARAM_REVERB_DAMP] = PARAM_INT ("reverb_damp", "ReverbDamp",
+      "Reverb room damp (percent)", 1, 100, 10,
+      PARAM_HPFX_REVB_DAMP),
+  [VIPERFX_PARAM_REVERB_WET] = PARAM_INT ("reverb_wet", "ReverbWet",
+      "Reverb wet signal (percent)", 1, 100, 20,
+      PARAM_HPFX_REVB_WET),
+  [VIPERFX_PARAM_REVERB_DRY] = PARAM_INT ("reverb_dry", "ReverbDry",
+      "Reverb dry signal (percent)", 1, 100, 80,
+      PARAM_HPFX_REVB_DRY),
+  [VIPERFX_PARAM_REVERB_ENABLE] = PARAM_BOOL ("reverb_enable", "ReverbEnabled",
+      "Enable reverb", FALSE,
+      PARAM_HPFX_REVB_PROCESS_ENABLED),
+
+  /* agc */
+  [VIPERFX_PARAM_AGC_RATIO] = PARAM_INT ("agc_ratio", "AGCRatio",
+      "Working ratio of agc", 50, 500, 100,
+      PARAM_HPFX_AGC_RATIO),
+  [VIPERFX_PARAM_AGC_VOLUME] = PARAM_INT ("agc_volume", "AGCVolume",
+      "Max volume of agc", 0, 200, 100,
+      PARAM_HPFX_AGC_VOLUME),
+  [VIPERFX_PARAM_AGC_MAXGAIN] = PARAM_INT ("agc_maxgain", "AGCMaxGain",
+      "Max gain of agc", 100, 800, 100,
+      PARAM_HPFX_AGC_MAXSCALER),
+  [VIPERFX_PARAM_AGC_ENABLE] = PARAM_BOOL ("agc_enable", "AGCEnabled",
+      "Enable auto gain control", FALSE,
+      PARAM_HPFX_AGC_PROCESS_ENABLED),
+
+  /* viper bass */
+  [VIPERFX_PARAM_VB_MODE] = PARAM_MODE ("vb_mode", "VBMode",
+      "ViPER bass mode", 0, 2, 0,
+      PARAM_HPFX_VIPERBASS_MODE),
+  [VIPERFX_PARAM_VB_FREQ] = PARAM_INT ("vb_freq", "VBFreq",
+      "ViPER bass frequency", 50, 160, 76,
+      PARAM_HPFX_VIPERBASS_SPEAKER),
+  [VIPERFX_PARAM_VB_GAIN] = PARAM_INT ("vb_gain", "VBGain",
+      "ViPER bass gain", 0, 800, 0,
+      PARAM_HPFX_VIPERBASS_BASSGAIN),
+  [VIPERFX_PARAM_VB_ENABLE] = PARAM_BOOL ("vb_enable", "VBEnabled",
+      "Enable viper bass", FALSE,
+      PARAM_HPFX_VIPERBASS_PROCESS_ENABLED),
+
+  /* viper clarity */
+  [VIPERFX_PARAM_VC_MODE] = PARAM_MODE ("vc_mode", "VCMode",
+      "ViPER clarity mode", 0, 2, 0,
+      PARAM_HPFX_VIPERCLARITY_MODE),
+  [VIPERFX_PARAM_VC_LEVEL] = PARAM_INT ("vc_level", "VCLevel",
+      "ViPER clarity level", 0, 800, 0,
+      PARAM_HPFX_VIPERCLARITY_CLARITY),
+  [VIPERFX_PARAM_VC_ENABLE] = PARAM_BOOL ("vc_enable", "VCEnabled",
+      "Enable viper clarity", FALSE,
+      PARAM_HPFX_VIPERCLARITY_PROCESS_ENABLED),
+
+  /* cure */
+  [VIPERFX_PARAM_CURE_LEVEL] = PARAM_MODE ("cure_level", "CureLevel",
+      "ViPER cure+ level", 0, 2, 0,
+      PARAM_HPFX_CURE_CROSSFEED),
+  [VIPERFX_PARAM_CURE_ENABLE] = PARAM_BOOL ("cure_enable", "CureEnabled",
+      "Enable viper cure+", FALSE,
+      PARAM_HPFX_CURE_PROCESS_ENABLED),
+
+  /* tube */
+  [VIPERFX_PARAM_TUBE_ENABLE] = PARAM_BOOL ("tube_enable", "TubeEnabled",
+      "Enable tube simiulator", FALSE,
+      PARAM_HPFX_TUBE_PROCESS_ENABLED),
+
+  /* analog-x */
+  [VIPERFX_PARAM_AX_MODE] = PARAM_MODE ("ax_mode", "AXMode",
+      "ViPER analog-x mode", 0, 2, 0,
+      PARAM_HPFX_ANALOGX_MODE),
+  [VIPERFX_PARAM_AX_ENABLE] = PARAM_BOOL ("ax_enable", "AXEnabled",
+      "Enable viper analog-x", FALSE,
+      PARAM_HPFX_ANALOGX_PROCESS_ENABLED),
+
+  /* fet compressor */
+  [VIPERFX_PARAM_FETCOMP_THRESHOLD] = PARAM_INT ("fetcomp_threshold", "FETCompThreshold",
+      "Compressor threshold (percent)", 0, 100, 0,
+      PARAM_HPFX_FETCOMP_THRESHOLD),
+  [VIPERFX_PARAM_FETCOMP_RATIO] = PARAM_INT ("fetcomp_ratio", "FETCompRatio",
+      "Compressor ratio (percent)", 0, 100, 0,
+      PARAM_HPFX_FETCOMP_RATIO),
+  [VIPERFX_PARAM_FETCOMP_KNEEWIDTH] = PARAM_INT ("fetcomp_kneewidth", "FETCompKneeWidth",
+      "Compressor knee width (percent)", 0, 100, 0,
+      PARAM_HPFX_FETCOMP_KNEEWIDTH),
+  [VIPERFX_PARAM_FETCOMP_AUTOKNEE] = PARAM_BOOL ("fetcomp_autoknee", "FETCompAutoKnee",
+      "Compressor auto knee control", TRUE,
+      PARAM_HPFX_FETCOMP_AUTOKNEE_ENABLED),
+  [VIPERFX_PARAM_FETCOMP_GAIN] = PARAM_INT ("fetcomp_gain", "FETCompGain",
+      "Compressor makeup gain (percent)", 0, 100, 0,
+      PARAM_HPFX_FETCOMP_GAIN),
+  [VIPERFX_PARAM_FETCOMP_AUTOGAIN] = PARAM_BOOL ("fetcomp_autogain", "FETCompAutoGain",
+      "Compressor auto gain control", TRUE,
+      PARAM_HPFX_FETCOMP_AUTOGAIN_ENABLED),
+  [VIPERFX_PARAM_FETCOMP_ATTACK] = PARAM_INT ("fetcomp_attack", "FETCompAttack",
+      "Compressor attack time (percent)", 0, 100, 51,
+      PARAM_HPFX_FETCOMP_ATTACK),
+  [VIPERFX_PARAM_FETCOMP_AUTOATTACK] = PARAM_BOOL ("fetcomp_autoattack", "FETCompAutoAttack",
+      "Compressor auto attack control", TRUE,
+      PARAM_HPFX_FETCOMP_AUTOATTACK_ENABLED),
+  [VIPERFX_PARAM_FETCOMP_RELEASE] = PARAM_INT ("fetcomp_release", "FETCompRelease",
+      "Compressor release time (percent)", 0, 100, 38,
+      PARAM_HPFX_FETCOMP_RELEASE),
+  [VIPERFX_PARAM_FETCOMP_AUTORELEASE] = PARAM_BOOL ("fetcomp_autorelease", "FETCompAutoRelease",
+      "Compressor auto release control", TRUE,
+      PARAM_HPFX_FETCOMP_AUTORELEASE_ENABLED),
+  [VIPERFX_PARAM_FETCOMP_META_KNEEMULTI] = PARAM_INT ("fetcomp_meta_kneemulti", "FETCompKneeMulti",
+      "Compressor knee width multi in auto mode (percent)", 0, 100, 50,
+      PARAM_HPFX_FETCOMP_META_KNEEMULTI),
+  [VIPERFX_PARAM_FETCOMP_META_MAXATTACK] = PARAM_INT ("fetcomp_meta_maxattack", "FETCompMaxAttack",
+      "Compressor max attack in auto mode (percent)", 0, 100, 88,
+      PARAM_HPFX_FETCOMP_META_MAXATTACK),
+  [VIPERFX_PARAM_FETCOMP_META_MAXRELEASE] = PARAM_INT ("fetcomp_meta_maxrelease", "FETCompMaxRelease",
+      "Compressor max release in auto mode (percent)", 0, 100, 88,
+      PARAM_HPFX_FETCOMP_META_MAXRELEASE),
+  [VIPERFX_PARAM_FETCOMP_META_CREST] = PARAM_INT ("fetcomp_meta_crest", "FETCompCrest",
+      "Compressor crest in auto mode (percent)", 0, 100, 61,
+      PARAM_HPFX_FETCOMP_META_CREST),
+  [VIPERFX_PARAM_FETCOMP_META_ADAPT] = PARAM_INT ("fetcomp_meta_adapt", "FETCompAdapt",
+      "Compressor adapt in auto mode (percent)", 0, 100, 66,
+      PARAM_HPFX_FETCOMP_META_ADAPT),
+  [VIPERFX_PARAM_FETCOMP_NOCLIP] = PARAM_BOOL ("fetcomp_noclip", "FETCompNoClip",
+      "Compressor prevent clipping", TRUE,
+      PARAM_HPFX_FETCOMP_META_NOCLIP_ENABLED),
+  [VIPERFX_PARAM_FETCOMP_ENABLE] = PARAM_BOOL ("fetcomp_enable", "FETCompEnabled",
+      "Enable fet compressor", FALSE,
+      PARAM_HPFX_FETCOMP_PROCESS_ENABLED),
+
+  /* output volume */
+  [VIPERFX_PARAM_OUT_VOLUME] = PARAM_INT ("out_volume", "OutVolume",
+      "Master output volume (percent)", 0, 100, 100,
+      PARAM_HPFX_OUTPUT_VOLUME),
+
+  /* output pan */
+  [VIPERFX_PARAM_OUT_PAN] = PARAM_INT ("out_pan", "OutPan",
+      "Master output pan", -100, 100, 0,
+      PARAM_HPFX_OUTPUT_PAN),
+
+  /* limiter */
+  [VIPERFX_PARAM_LIM_THRESHOLD] = PARAM_INT ("lim_threshold", "LimThreshold",
+      "Master limiter threshold (percent)", 1, 100, 100,
+      PARAM_HPFX_LIMITER_THRESHOLD),
+
+  /* global switch */
+  [VIPERFX_PARAM_FX_ENABLE] = PARAM_BOOL ("fx_enable", "FXEnabled",
+      "Enable viperfx processing", FALSE,
+      PARAM_SET_DOPROCESS_STATUS),
+};
+
+gint32 viperfx_param_to_core (guint idx, gint32 value)
+{
+  if (viperfx_params[idx].to_core != NULL)
+    return viperfx_params[idx].to_core (value);
+  return value;
+}
+
+/* register one controllable property per table entry,
+ * property ids are first_prop_id + table index
+ */
+void viperfx_params_install_properties (GObjectClass * gobject_class,
+    guint first_prop_id)
+{
+  guint idx;
+
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++) {
+    const viperfx_param_desc *desc = &viperfx_params[idx];
+    GParamSpec *pspec;
+
+    if (desc->boolean) {
+      pspec = g_param_spec_boolean (desc->name, desc->nick, desc->blurb,
+          desc->default_value, G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE);
+    } else {
+      pspec = g_param_spec_int (desc->name, desc->nick, desc->blurb,
+          desc->minimum, desc->maximum, desc->default_value,
+          G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE);
+    }
+    g_object_class_install_property (gobject_class,
+        first_prop_id + idx, pspec);
+  }
+}
+
+void viperfx_param_store_init (viperfx_param_store * store)
+{
+  guint idx;
+
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++) {
+    store->value[idx] = viperfx_param_to_core (idx,
+        viperfx_params[idx].default_value);
+    store->sent[idx] = store->value[idx];
+  }
+  viperfx_param_store_mark_all (store);
+}
+
+void viperfx_param_store_mark_all (viperfx_param_store * store)
+{
+  guint word;
+
+  for (word = 0; word < VIPERFX_PARAM_DIRTY_WORDS; word++)
+    g_atomic_int_set ((volatile gint *) &store->dirty[word], (gint) ~0u);
+}
+
+/* store a new property value, returns FALSE when nothing changed
+ * lock-free, may be called from any thread
+ */
+gboolean viperfx_param_store_set (viperfx_param_store * store,
+    guint idx, const GValue * value)
+{
+  gint32 core_value;
+
+  if (viperfx_params[idx].boolean)
+    core_value = g_value_get_boolean (value) ? 1 : 0;
+  else
+    core_value = viperfx_param_to_core (idx, g_value_get_int (value));
+
+  if (g_atomic_int_get (&store->value[idx]) == core_value)
+    return FALSE;
+
+  // publish the value before the dirty bit so a flush never sees a stale one
+  g_atomic_int_set (&store->value[idx], core_value);
+  g_atomic_int_or (&store->dirty[idx / 32], 1u << (idx % 32));
+  return TRUE;
+}
+
+gboolean viperfx_param_send (viperfx_interface * vfx,
+    guint idx, gint32 value)
+{
+  const viperfx_param_desc *desc = &viperfx_params[idx];
+
+  if (desc->band >= 0) {
+    return viperfx_command_set_px4_vx4x2 (vfx,
+        desc->param, desc->band, value);
+  }
+  return viperfx_command_set_px4_vx4x1 (vfx,
+      desc->param, value);
+}
+
+/* send every dirty parameter whose value differs from what the cores have,
+ * in table order, to each of the n_vfx cores. all cores share sent[], so
+ * they have to be kept in lockstep. parameters in hold (may be NULL) stay
+ * dirty and are left alone. returns the number of parameters sent
+ */
+guint viperfx_param_store_flush (viperfx_param_store * store,
+    viperfx_interface * const * vfx, guint n_vfx, gboolean force,
+    const guint * hold)
+{
+  guint word, i, sent = 0;
+
+  for (word = 0; word < VIPERFX_PARAM_DIRTY_WORDS; word++) {
+    guint bits;
+
+    if (g_atomic_int_get ((volatile gint *) &store->dirty[word]) == 0)
+      continue;
+    if (hold != NULL) {
+      bits = g_atomic_int_and (&store->dirty[word], hold[word]) & ~hold[word];
+    } else {
+      bits = g_atomic_int_and (&store->dirty[word], 0);
+    }
+
+    while (bits != 0) {
+      guint idx = word * 32 + g_bit_nth_lsf (bits, -1);
+      gint32 value;
+
+      bits &= bits - 1;
+      if (idx >= VIPERFX_PARAM_COUNT)
+        continue;
+
+      value = g_atomic_int_get (&store->value[idx]);
+      if (!force && value == store->sent[idx])
+        continue;
+      for (i = 0; i < n_vfx; i++)
+        viperfx_param_send (vfx[i], idx, value);
+      store->sent[idx] = value;
+      sent++;
+    }
+  }
+
+  return sent;
+}
+
+/* module switches, with all of them off only the output stage is left */
+static const guint module_switches[] = {
+  VIPERFX_PARAM_CONV_ENABLE, VIPERFX_PARAM_VHE_ENABLE,
+  VIPERFX_PARAM_VSE_ENABLE, VIPERFX_PARAM_EQ_ENABLE,
+  VIPERFX_PARAM_COLM_ENABLE, VIPERFX_PARAM_DS_ENABLE,
+  VIPERFX_PARAM_REVERB_ENABLE, VIPERFX_PARAM_AGC_ENABLE,
+  VIPERFX_PARAM_VB_ENABLE, VIPERFX_PARAM_VC_ENABLE,
+  VIPERFX_PARAM_CURE_ENABLE, VIPERFX_PARAM_TUBE_ENABLE,
+  VIPERFX_PARAM_AX_ENABLE, VIPERFX_PARAM_FETCOMP_ENABLE,
+};
+
+/* whether cores configured with sent[] leave the audio as it is, either
+ * switched off or with every module off and a neutral output stage
+ */
+gboolean viperfx_param_store_neutral (const viperfx_param_store * store)
+{
+  guint i;
+
+  if (store->sent[VIPERFX_PARAM_FX_ENABLE] == 0)
+    return TRUE;
+  for (i = 0; i < G_N_ELEMENTS (module_switches); i++) {
+    if (store->sent[module_switches[i]] != 0)
+      return FALSE;
+  }
+  return store->sent[VIPERFX_PARAM_OUT_VOLUME] == 100 &&
+      store->sent[VIPERFX_PARAM_OUT_PAN] == 0 &&
+      store->sent[VIPERFX_PARAM_LIM_THRESHOLD] == 100;
+}
+
+/* current values, for cores configured away from the streaming thread
+*/
+void viperfx_param_store_snapshot (viperfx_param_store * store,
+    gint32 values[VIPERFX_PARAM_COUNT])
+{
+  guint idx;
+
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++)
+    values[idx] = g_atomic_int_get (&store->value[idx]);
+}
+
+void viperfx_param_send_values (viperfx_interface * vfx,
+    const gint32 values[VIPERFX_PARAM_COUNT])
+{
+  guint idx;
+
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++)
+    viperfx_param_send (vfx, idx, values[idx]);
+}
+
+/* the cores in use were configured with values instead of what sent[]
+ * says, the next flush sends whatever changed since
+ */
+void viperfx_param_store_adopt (viperfx_param_store * store,
+    const gint32 values[VIPERFX_PARAM_COUNT])
+{
+  memcpy (store->sent, values, sizeof(store->sent));
+  viperfx_param_store_mark_all (store);
+}
+
+/* the parameters viperfx_param_store_flush holds back in transition mode
+*/
+void viperfx_param_crossfade_mask (guint mask[VIPERFX_PARAM_DIRTY_WORDS])
+{
+  guint idx;
+
+  memset (mask, 0, sizeof(guint) * VIPERFX_PARAM_DIRTY_WORDS);
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++) {
+    if (viperfx_params[idx].crossfade)
+      mask[idx / 32] |= 1u << (idx % 32);
+  }
+}
+
+/* whether a held parameter really changed, held bits whose value is
+ * already what the cores have are dropped on the way. a set racing the
+ * drop has published its value before its bit, so the value read after
+ * the drop shows it and the bit goes back
+ */
+gboolean viperfx_param_store_pending (viperfx_param_store * store,
+    const guint * hold)
+{
+  gboolean pending = FALSE;
+  guint word;
+
+  for (word = 0; word < VIPERFX_PARAM_DIRTY_WORDS; word++) {
+    guint bits = g_atomic_int_get ((volatile gint *) &store->dirty[word]) &
+        hold[word];
+    guint stale = 0;
+
+    while (bits != 0) {
+      guint idx = word * 32 + g_bit_nth_lsf (bits, -1);
+
+      bits &= bits - 1;
+      if (g_atomic_int_get (&store->value[idx]) != store->sent[idx])
+        pending = TRUE;
+      else
+        stale |= 1u << (idx % 32);
+    }
+    if (stale == 0)
+      continue;
+    g_atomic_int_and (&store->dirty[word], ~stale);
+    while (stale != 0) {
+      guint idx = word * 32 + g_bit_nth_lsf (stale, -1);
+
+      stale &= stale - 1;
+      if (g_atomic_int_get (&store->value[idx]) != store->sent[idx]) {
+        g_atomic_int_or (&store->dirty[word], 1u << (idx % 32));
+        pending = TRUE;
+      }
+    }
+  }
+
+  return pending;
+}
+
+/* bring a freshly created core up to what the running cores were sent,
+ * parameters still dirty reach it with the next flush
+ */
+void viperfx_param_store_replay (viperfx_param_store * store,
+    viperfx_interface * vfx)
+{
+  guint idx;
+
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++)
+    viperfx_param_send (vfx, idx, store->sent[idx]);
+}
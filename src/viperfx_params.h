@@ -0,0 +1,166 @@
+#ifndef _VIPERFX_PARAMS_H
+#define _VIPERFX_PARAMS_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include "viperfx_so.h"
+
+G_BEGIN_DECLS
+
+/* scalar fx parameters, in the order they are sent to the core
+ * (module settings first, then the module switch, global enable last)
+ */
+enum
+{
+  /* convolver */
+  VIPERFX_PARAM_CONV_CC_LEVEL = 0,
+  VIPERFX_PARAM_CONV_ENABLE,
+  /* vhe */
+  VIPERFX_PARAM_VHE_LEVEL,
+  VIPERFX_PARAM_VHE_ENABLE,
+  /* vse */
+  VIPERFX_PARAM_VSE_REF_BARK,
+  VIPERFX_PARAM_VSE_BARK_CONS,
+  VIPERFX_PARAM_VSE_ENABLE,
+  /* equalizer */
+  VIPERFX_PARAM_EQ_BAND1,
+  VIPERFX_PARAM_EQ_BAND2,
+  VIPERFX_PARAM_EQ_BAND3,
+  VIPERFX_PARAM_EQ_BAND4,
+  VIPERFX_PARAM_EQ_BAND5,
+  VIPERFX_PARAM_EQ_BAND6,
+  VIPERFX_PARAM_EQ_BAND7,
+  VIPERFX_PARAM_EQ_BAND8,
+  VIPERFX_PARAM_EQ_BAND9,
+  VIPERFX_PARAM_EQ_BAND10,
+  VIPERFX_PARAM_EQ_ENABLE,
+  /* colorful music */
+  VIPERFX_PARAM_COLM_WIDENING,
+  VIPERFX_PARAM_COLM_MIDIMAGE,
+  VIPERFX_PARAM_COLM_DEPTH,
+  VIPERFX_PARAM_COLM_ENABLE,
+  /* diff surr */
+  VIPERFX_PARAM_DS_LEVEL,
+  VIPERFX_PARAM_DS_ENABLE,
+  /* reverb */
+  VIPERFX_PARAM_REVERB_ROOMSIZE,
+  VIPERFX_PARAM_REVERB_WIDTH,
+  VIPERFX_PARAM_REVERB_DAMP,
+  VIPERFX_PARAM_REVERB_WET,
+  VIPERFX_PARAM_REVERB_DRY,
+  VIPERFX_PARAM_REVERB_ENABLE,
+  /* agc */
+  VIPERFX_PARAM_AGC_RATIO,
+  VIPERFX_PARAM_AGC_VOLUME,
+  VIPERFX_PARAM_AGC_MAXGAIN,
+  VIPERFX_PARAM_AGC_ENABLE,
+  /* viper bass */
+  VIPERFX_PARAM_VB_MODE,
+  VIPERFX_PARAM_VB_FREQ,
+  VIPERFX_PARAM_VB_GAIN,
+  VIPERFX_PARAM_VB_ENABLE,
+  /* viper clarity */
+  VIPERFX_PARAM_VC_MODE,
+  VIPERFX_PARAM_VC_LEVEL,
+  VIPERFX_PARAM_VC_ENABLE,
+  /* cure */
+  VIPERFX_PARAM_CURE_LEVEL,
+  VIPERFX_PARAM_CURE_ENABLE,
+  /* tube */
+  VIPERFX_PARAM_TUBE_ENABLE,
+  /* analog-x */
+  VIPERFX_PARAM_AX_MODE,
+  VIPERFX_PARAM_AX_ENABLE,
+  /* fet compressor */
+  VIPERFX_PARAM_FETCOMP_THRESHOLD,
+  VIPERFX_PARAM_FETCOMP_RATIO,
+  VIPERFX_PARAM_FETCOMP_KNEEWIDTH,
+  VIPERFX_PARAM_FETCOMP_AUTOKNEE,
+  VIPERFX_PARAM_FETCOMP_GAIN,
+  VIPERFX_PARAM_FETCOMP_AUTOGAIN,
+  VIPERFX_PARAM_FETCOMP_ATTACK,
+  VIPERFX_PARAM_FETCOMP_AUTOATTACK,
+  VIPERFX_PARAM_FETCOMP_RELEASE,
+  VIPERFX_PARAM_FETCOMP_AUTORELEASE,
+  VIPERFX_PARAM_FETCOMP_META_KNEEMULTI,
+  VIPERFX_PARAM_FETCOMP_META_MAXATTACK,
+  VIPERFX_PARAM_FETCOMP_META_MAXRELEASE,
+  VIPERFX_PARAM_FETCOMP_META_CREST,
+  VIPERFX_PARAM_FETCOMP_META_ADAPT,
+  VIPERFX_PARAM_FETCOMP_NOCLIP,
+  VIPERFX_PARAM_FETCOMP_ENABLE,
+  /* output volume */
+  VIPERFX_PARAM_OUT_VOLUME,
+  /* output pan */
+  VIPERFX_PARAM_OUT_PAN,
+  /* limiter */
+  VIPERFX_PARAM_LIM_THRESHOLD,
+  /* global enable */
+  VIPERFX_PARAM_FX_ENABLE,
+
+  VIPERFX_PARAM_COUNT
+};
+
+#define VIPERFX_PARAM_DIRTY_WORDS ((VIPERFX_PARAM_COUNT + 31) / 32)
+
+typedef struct _viperfx_param_desc {
+  const gchar *name;
+  const gchar *nick;
+  const gchar *blurb;
+  gboolean boolean;
+  gint32 minimum;
+  gint32 maximum;
+  gint32 default_value;
+  /* core parameter id, band index for px4_vx4x2 parameters or -1 */
+  gint32 param;
+  gint32 band;
+  /* maps the property value to the value the core expects */
+  gint32 (*to_core) (gint32 value);
+  /* switches processing on or off as a whole, clicks on a running core */
+  gboolean crossfade;
+} viperfx_param_desc;
+
+extern const viperfx_param_desc viperfx_params[VIPERFX_PARAM_COUNT];
+
+/* per instance parameter values
+ * value[] and dirty[] are written by any thread, sent[] is owned
+ * by the thread that talks to the core
+ */
+typedef struct _viperfx_param_store {
+  volatile gint value[VIPERFX_PARAM_COUNT];
+  gint32 sent[VIPERFX_PARAM_COUNT];
+  volatile guint dirty[VIPERFX_PARAM_DIRTY_WORDS];
+} viperfx_param_store;
+
+void viperfx_params_install_properties (GObjectClass * gobject_class,
+    guint first_prop_id);
+
+void viperfx_param_store_init (viperfx_param_store * store);
+void viperfx_param_store_mark_all (viperfx_param_store * store);
+gboolean viperfx_param_store_set (viperfx_param_store * store,
+    guint idx, const GValue * value);
+guint viperfx_param_store_flush (viperfx_param_store * store,
+    viperfx_interface * const * vfx, guint n_vfx, gboolean force,
+    const guint * hold);
+gboolean viperfx_param_store_pending (viperfx_param_store * store,
+    const guint * hold);
+gboolean viperfx_param_store_neutral (const viperfx_param_store * store);
+void viperfx_param_crossfade_mask (guint mask[VIPERFX_PARAM_DIRTY_WORDS]);
+void viperfx_param_store_snapshot (viperfx_param_store * store,
+    gint32 values[VIPERFX_PARAM_COUNT]);
+void viperfx_param_store_adopt (viperfx_param_store * store,
+    const gint32 values[VIPERFX_PARAM_COUNT]);
+void viperfx_param_store_replay (viperfx_param_store * store,
+    viperfx_interface * vfx);
+
+/* property value to the value sent to the core */
+gint32 viperfx_param_to_core (guint idx, gint32 value);
+
+gboolean viperfx_param_send (viperfx_interface * vfx,
+    guint idx, gint32 value);
+void viperfx_param_send_values (viperfx_interface * vfx,
+    const gint32 values[VIPERFX_PARAM_COUNT]);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,183 @@
+#include <errno.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "viperfx_preset.h"
+
+static GMutex cache_lock;
+static GHashTable *cache = NULL;
+
+viperfx_preset * viperfx_preset_ref (viperfx_preset * preset)
+{
+  g_atomic_int_inc (&preset->refcount);
+  return preset;
+}
+
+void viperfx_preset_unref (viperfx_preset * preset)
+{
+  if (preset != NULL && g_atomic_int_dec_and_test (&preset->refcount))
+    g_free (preset);
+}
+
+static gint param_lookup (const gchar * name)
+{
+  guint idx;
+
+  for (idx = 0; idx < VIPERFX_PARAM_COUNT; idx++) {
+    if (strcmp (viperfx_params[idx].name, name) == 0)
+      return (gint) idx;
+  }
+  return -1;
+}
+
+/* one key, either a table parameter or the impulse response path
+*/
+static gboolean preset_parse_key (viperfx_preset * preset, GKeyFile * kf,
+    const gchar * path, const gchar * key, GError ** error)
+{
+  const viperfx_param_desc *desc;
+  GError *err = NULL;
+  gint idx, value;
+
+  if (strcmp (key, "conv_ir_path") == 0) {
+    gchar *ir_path = g_key_file_get_string (kf, VIPERFX_PRESET_GROUP,
+        key, error);
+
+    if (ir_path == NULL)
+      return FALSE;
+    if (strlen (ir_path) >= sizeof(preset->ir_path)) {
+      g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+          "%s: conv_ir_path is too long", path);
+      g_free (ir_path);
+      return FALSE;
+    }
+    g_strlcpy (preset->ir_path, ir_path, sizeof(preset->ir_path));
+    preset->has_ir_path = TRUE;
+    g_free (ir_path);
+    return TRUE;
+  }
+
+  idx = param_lookup (key);
+  if (idx < 0) {
+    g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+        "%s: unknown parameter %s", path, key);
+    return FALSE;
+  }
+  desc = &viperfx_params[idx];
+
+  if (desc->boolean)
+    value = g_key_file_get_boolean (kf, VIPERFX_PRESET_GROUP, key, &err);
+  else
+    value = g_key_file_get_integer (kf, VIPERFX_PRESET_GROUP, key, &err);
+  if (err != NULL) {
+    g_propagate_error (error, err);
+    return FALSE;
+  }
+  if (!desc->boolean && (value < desc->minimum || value > desc->maximum)) {
+    g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+        "%s: %s=%d is out of range [%d, %d]", path, key, value,
+        desc->minimum, desc->maximum);
+    return FALSE;
+  }
+
+  preset->value[idx] = desc->boolean ? (value ? 1 : 0) :
+      viperfx_param_to_core (idx, value);
+  preset->mask[idx / 32] |= 1u << (idx % 32);
+  return TRUE;
+}
+
+static viperfx_preset * preset_parse (const gchar * path, GError ** error)
+{
+  viperfx_preset *preset;
+  GKeyFile *kf;
+  gchar **keys;
+  gsize i, n_keys;
+
+  kf = g_key_file_new ();
+  if (!g_key_file_load_from_file (kf, path, G_KEY_FILE_NONE, error)) {
+    g_key_file_free (kf);
+    return NULL;
+  }
+  keys = g_key_file_get_keys (kf, VIPERFX_PRESET_GROUP, &n_keys, error);
+  if (keys == NULL) {
+    g_key_file_free (kf);
+    return NULL;
+  }
+
+  preset = g_new0 (viperfx_preset, 1);
+  preset->refcount = 1;
+  for (i = 0; i < n_keys; i++) {
+    if (!preset_parse_key (preset, kf, path, keys[i], error)) {
+      g_free (preset);
+      preset = NULL;
+      break;
+    }
+  }
+
+  g_strfreev (keys);
+  g_key_file_free (kf);
+  return preset;
+}
+
+/* the cache owns one reference to every preset it holds
+*/
+viperfx_preset * viperfx_preset_load (const gchar * path, GError ** error)
+{
+  viperfx_preset *preset;
+  GStatBuf st;
+
+  if (g_stat (path, &st) != 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "%s: %s", path, g_strerror (errno));
+    return NULL;
+  }
+
+  g_mutex_lock (&cache_lock);
+  if (cache == NULL) {
+    cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) viperfx_preset_unref);
+  }
+  preset = g_hash_table_lookup (cache, path);
+  if (preset != NULL && preset->mtime == (gint64) st.st_mtime &&
+      preset->size == (gint64) st.st_size) {
+    viperfx_preset_ref (preset);
+    g_mutex_unlock (&cache_lock);
+    return preset;
+  }
+  g_mutex_unlock (&cache_lock);
+
+  // parse outside the lock, a racing load of the same file just parses twice
+  preset = preset_parse (path, error);
+  if (preset == NULL)
+    return NULL;
+  preset->mtime = (gint64) st.st_mtime;
+  preset->size = (gint64) st.st_size;
+
+  g_mutex_lock (&cache_lock);
+  if (g_hash_table_size (cache) >= VIPERFX_PRESET_CACHE_SIZE)
+    g_hash_table_remove_all (cache);
+  g_hash_table_replace (cache, g_strdup (path), viperfx_preset_ref (preset));
+  g_mutex_unlock (&cache_lock);
+
+  return preset;
+}
+
+void viperfx_preset_apply (const viperfx_preset * preset,
+    viperfx_param_store * store)
+{
+  guint word;
+
+  for (word = 0; word < VIPERFX_PARAM_DIRTY_WORDS; word++) {
+    guint bits = preset->mask[word];
+
+    if (bits == 0)
+      continue;
+    while (bits != 0) {
+      guint idx = word * 32 + g_bit_nth_lsf (bits, -1);
+
+      bits &= bits - 1;
+      g_atomic_int_set (&store->value[idx], preset->value[idx]);
+    }
+    g_atomic_int_or (&store->dirty[word], preset->mask[word]);
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef _VIPERFX_PRESET_H
+#define _VIPERFX_PRESET_H
+
+#include <glib.h>
+#include "viperfx_params.h"
+
+G_BEGIN_DECLS
+
+/* whole parameter sets loaded from a keyfile
+ *
+ * [viperfx]
+ * fx_enable=true
+ * eq_enable=true
+ * eq_band1=300
+ * conv_ir_path=/usr/share/viperfx/hall.irs
+ *
+ * keys are the element property names, parameters a preset leaves out
+ * keep their current value. parsed presets are cached plugin-wide by
+ * path, size and mtime, already mapped to the values the core expects.
+ */
+
+#define VIPERFX_PRESET_GROUP "viperfx"
+/* the cache is dropped as a whole when it grows past this */
+#define VIPERFX_PRESET_CACHE_SIZE 64
+
+typedef struct _viperfx_preset {
+  volatile gint refcount;
+  /* what the file looked like when it was parsed */
+  gint64 mtime;
+  gint64 size;
+  /* parameters the preset sets, and their core values */
+  guint mask[VIPERFX_PARAM_DIRTY_WORDS];
+  gint32 value[VIPERFX_PARAM_COUNT];
+  gboolean has_ir_path;
+  gchar ir_path[256];
+} viperfx_preset;
+
+/* parsed or cached, NULL and error set when the file can't be used */
+viperfx_preset * viperfx_preset_load (const gchar * path, GError ** error);
+
+viperfx_preset * viperfx_preset_ref (viperfx_preset * preset);
+void viperfx_preset_unref (viperfx_preset * preset);
+
+/* store every value of the preset and mark it dirty, the next flush
+ * sends them all. only called from the thread that flushes the store
+ */
+void viperfx_preset_apply (const viperfx_preset * preset,
+    viperfx_param_store * store);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "viperfx_resample.h"
+
+/* passband edge relative to the stream nyquist */
+#define RESAMPLE_CUTOFF 0.9
+
+struct _viperfx_resampler {
+  const viperfx_kernels * kernels;
+  unsigned int factor;
+  /* prototype length, factor * VIPERFX_RESAMPLE_TAPS */
+  size_t length;
+  /* factor phases of VIPERFX_RESAMPLE_TAPS each, time reversed and
+   * scaled by factor to make up for the stuffed zeros */
+  float * up_coeffs;
+  /* the whole prototype, time reversed */
+  float * down_coeffs;
+  /* per channel history followed by room for one call */
+  float * up_hist[2];
+  float * down_hist[2];
+};
+
+unsigned int viperfx_resample_factor (int rate, int core_rate)
+{
+  if (rate <= 0 || rate >= core_rate)
+    return 1;
+  return (unsigned int)((core_rate + rate - 1) / rate);
+}
+
+/* blackman windowed sinc with unity dc gain
+*/
+static void design_prototype (float * h, size_t length, unsigned int factor)
+{
+  double fc = RESAMPLE_CUTOFF * 0.5 / factor;
+  double center = (length - 1) * 0.5;
+  double sum = 0.0;
+  size_t n;
+
+  for (n = 0; n < length; n++) {
+    double t = n - center;
+    double w = 0.42 - 0.5 * cos (2.0 * M_PI * n / (length - 1)) +
+        0.08 * cos (4.0 * M_PI * n / (length - 1));
+    double v = (t == 0.0) ? 2.0 * fc : sin (2.0 * M_PI * fc * t) / (M_PI * t);
+    h[n] = (float)(v * w);
+    sum += v * w;
+  }
+  for (n = 0; n < length; n++)
+    h[n] = (float)(h[n] / sum);
+}
+
+static int16_t to_s16 (float v)
+{
+  v = (v > -32768.0f) ? v : -32768.0f;
+  v = (v < 32767.0f) ? v : 32767.0f;
+  return (int16_t) lrintf (v);
+}
+
+viperfx_resampler * viperfx_resampler_new (unsigned int factor,
+    const viperfx_kernels * kernels)
+{
+  viperfx_resampler * r;
+  float * h;
+  size_t taps = VIPERFX_RESAMPLE_TAPS;
+  size_t n, p, ch;
+
+  if (factor < 2)
+    return NULL;
+
+  r = calloc (1, sizeof(*r));
+  if (r == NULL)
+    return NULL;
+  r->kernels = kernels;
+  r->factor = factor;
+  r->length = factor * taps;
+
+  h = malloc (r->length * sizeof(float));
+  r->up_coeffs = viperfx_aligned_alloc (r->length * sizeof(float));
+  r->down_coeffs = viperfx_aligned_alloc (r->length * sizeof(float));
+  for (ch = 0; ch < 2; ch++) {
+    r->up_hist[ch] = viperfx_aligned_alloc (
+        (taps - 1 + VIPERFX_RESAMPLE_MAX_FRAMES) * sizeof(float));
+    r->down_hist[ch] = viperfx_aligned_alloc (
+        (r->length - 1 + VIPERFX_RESAMPLE_MAX_FRAMES * factor) * sizeof(float));
+    if (r->up_hist[ch] == NULL || r->down_hist[ch] == NULL)
+      break;
+  }
+  if (h == NULL || r->up_coeffs == NULL || r->down_coeffs == NULL || ch < 2) {
+    free (h);
+    viperfx_resampler_free (r);
+    return NULL;
+  }
+
+  design_prototype (h, r->length, factor);
+  for (p = 0; p < factor; p++) {
+    for (n = 0; n < taps; n++)
+      r->up_coeffs[p * taps + n] = h[p + (taps - 1 - n) * factor] * factor;
+  }
+  for (n = 0; n < r->length; n++)
+    r->down_coeffs[n] = h[r->length - 1 - n];
+  free (h);
+
+  viperfx_resampler_reset (r);
+  return r;
+}
+
+void viperfx_resampler_free (viperfx_resampler * r)
+{
+  size_t ch;
+
+  if (r == NULL)
+    return;
+  viperfx_aligned_free (r->up_coeffs);
+  viperfx_aligned_free (r->down_coeffs);
+  for (ch = 0; ch < 2; ch++) {
+    viperfx_aligned_free (r->up_hist[ch]);
+    viperfx_aligned_free (r->down_hist[ch]);
+  }
+  free (r);
+}
+
+void viperfx_resampler_reset (viperfx_resampler * r)
+{
+  size_t ch;
+
+  for (ch = 0; ch < 2; ch++) {
+    memset (r->up_hist[ch], 0, (VIPERFX_RESAMPLE_TAPS - 1) * sizeof(float));
+    memset (r->down_hist[ch], 0, (r->length - 1) * sizeof(float));
+  }
+}
+
+/* the down filter picks the last high rate sample of every group, which
+ * makes the round trip delay a whole number of stream frames
+ */
+unsigned int viperfx_resampler_latency (const viperfx_resampler * r)
+{
+  return VIPERFX_RESAMPLE_TAPS - 1;
+}
+
+void viperfx_resampler_up (viperfx_resampler * r,
+    const int16_t * src, int16_t * dst, size_t frames)
+{
+  const size_t taps = VIPERFX_RESAMPLE_TAPS;
+  const size_t factor = r->factor;
+  size_t ch, i, p;
+
+  for (ch = 0; ch < 2; ch++) {
+    float * hist = r->up_hist[ch];
+
+    for (i = 0; i < frames; i++)
+      hist[taps - 1 + i] = (float) src[2 * i + ch];
+
+    // output i * factor + p only sees the input taps of phase p
+    for (i = 0; i < frames; i++) {
+      for (p = 0; p < factor; p++) {
+        float acc = r->kernels->dot_f32 (r->up_coeffs + p * taps,
+            hist + i, taps);
+        dst[2 * (i * factor + p) + ch] = to_s16 (acc);
+      }
+    }
+
+    memmove (hist, hist + frames, (taps - 1) * sizeof(float));
+  }
+}
+
+void viperfx_resampler_down (viperfx_resampler * r,
+    const int16_t * src, int16_t * dst, size_t frames)
+{
+  const size_t length = r->length;
+  const size_t factor = r->factor;
+  size_t ch, i;
+
+  for (ch = 0; ch < 2; ch++) {
+    float * hist = r->down_hist[ch];
+
+    for (i = 0; i < frames * factor; i++)
+      hist[length - 1 + i] = (float) src[2 * i + ch];
+
+    for (i = 0; i < frames; i++) {
+      float acc = r->kernels->dot_f32 (r->down_coeffs,
+          hist + i * factor + factor - 1, length);
+      dst[2 * i + ch] = to_s16 (acc);
+    }
+
+    memmove (hist, hist + frames * factor, (length - 1) * sizeof(float));
+  }
+}
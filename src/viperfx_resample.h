@@ -0,0 +1,48 @@
+#ifndef _VIPERFX_RESAMPLE_H
+#define _VIPERFX_RESAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "viperfx_kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* integer ratio polyphase resampler around the core
+ *
+ * interleaved stereo s16 is taken up by factor before the core and
+ * back down by the same factor after it, both with the same windowed
+ * sinc. all state is allocated by viperfx_resampler_new, up and down
+ * handle at most VIPERFX_RESAMPLE_MAX_FRAMES stream frames per call.
+ */
+
+/* filter taps per phase, a multiple of 8 for the dot kernel */
+#define VIPERFX_RESAMPLE_TAPS 64
+#define VIPERFX_RESAMPLE_MAX_FRAMES 4096
+
+typedef struct _viperfx_resampler viperfx_resampler;
+
+/* smallest factor bringing rate up to the core minimum, 1 if it already is */
+unsigned int viperfx_resample_factor (int rate, int core_rate);
+
+viperfx_resampler * viperfx_resampler_new (unsigned int factor,
+    const viperfx_kernels * kernels);
+void viperfx_resampler_free (viperfx_resampler * r);
+void viperfx_resampler_reset (viperfx_resampler * r);
+
+/* delay of an up/down round trip, in stream frames */
+unsigned int viperfx_resampler_latency (const viperfx_resampler * r);
+
+/* frames stream frames in, frames * factor out */
+void viperfx_resampler_up (viperfx_resampler * r,
+    const int16_t * src, int16_t * dst, size_t frames);
+/* frames * factor in, frames stream frames out */
+void viperfx_resampler_down (viperfx_resampler * r,
+    const int16_t * src, int16_t * dst, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <glib.h>
+#include "viperfx_rt.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+/* flush to zero and denormals are zero */
+#define MXCSR_FTZ_DAZ 0x8040
+#endif
+
+/* FZ in the aarch64 FPCR and the arm FPSCR */
+#define ARM_FZ (1u << 24)
+
+gint viperfx_rt_denormals_off (viperfx_fpu_state * state)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  guint csr = _mm_getcsr ();
+
+  state->saved = csr;
+  _mm_setcsr (csr | MXCSR_FTZ_DAZ);
+  return 0;
+#elif defined(__aarch64__)
+  guint64 fpcr;
+
+  __asm__ __volatile__ ("mrs %0, fpcr" : "=r" (fpcr));
+  state->saved = fpcr;
+  __asm__ __volatile__ ("msr fpcr, %0" : : "r" (fpcr | ARM_FZ));
+  return 0;
+#elif defined(__arm__) && defined(__ARM_FP)
+  guint fpscr;
+
+  __asm__ __volatile__ ("vmrs %0, fpscr" : "=r" (fpscr));
+  state->saved = fpscr;
+  __asm__ __volatile__ ("vmsr fpscr, %0" : : "r" (fpscr | ARM_FZ));
+  return 0;
+#else
+  state->saved = 0;
+  return ENOTSUP;
+#endif
+}
+
+void viperfx_rt_denormals_restore (const viperfx_fpu_state * state)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_setcsr ((guint) state->saved);
+#elif defined(__aarch64__)
+  __asm__ __volatile__ ("msr fpcr, %0" : : "r" (state->saved));
+#elif defined(__arm__) && defined(__ARM_FP)
+  __asm__ __volatile__ ("vmsr fpscr, %0" : : "r" ((guint) state->saved));
+#else
+  (void) state;
+#endif
+}
+
+gint viperfx_rt_lock (const void * ptr, gsize size)
+{
+  gsize page = (gsize) sysconf (_SC_PAGESIZE);
+  guintptr start, end;
+
+  if (ptr == NULL || size == 0)
+    return 0;
+  // mlock wants whole pages on some systems
+  start = (guintptr) ptr & ~(guintptr) (page - 1);
+  end = (guintptr) ptr + size;
+  if (mlock ((const void *) start, end - start) != 0)
+    return errno;
+  return 0;
+}
+
+gint viperfx_rt_unlock (const void * ptr, gsize size)
+{
+  gsize page = (gsize) sysconf (_SC_PAGESIZE);
+  guintptr start, end;
+
+  if (ptr == NULL || size == 0)
+    return 0;
+  start = ((guintptr) ptr + page - 1) & ~(guintptr) (page - 1);
+  end = ((guintptr) ptr + size) & ~(guintptr) (page - 1);
+  if (end <= start)
+    return 0;
+  if (munlock ((const void *) start, end - start) != 0)
+    return errno;
+  return 0;
+}
+
+gint viperfx_rt_set_fifo (gint priority)
+{
+  struct sched_param param = { 0 };
+
+  if (priority <= 0)
+    return 0;
+  param.sched_priority = priority;
+  return pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+}
+
+gint viperfx_rt_set_affinity (gint cpu)
+{
+#ifdef CPU_SET
+  cpu_set_t set;
+
+  if (cpu < 0)
+    return 0;
+  if (cpu >= CPU_SETSIZE)
+    return EINVAL;
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  return pthread_setaffinity_np (pthread_self (), sizeof(set), &set);
+#else
+  return cpu < 0 ? 0 : ENOTSUP;
+#endif
+}
+
+gint viperfx_rt_sched_save (viperfx_sched_state * state)
+{
+  struct sched_param param;
+  gint error;
+
+  error = pthread_getschedparam (pthread_self (), &state->policy, &param);
+  if (error != 0)
+    return error;
+  state->priority = param.sched_priority;
+  state->has_cpus = FALSE;
+#ifdef CPU_SET
+  {
+    cpu_set_t set;
+
+    G_STATIC_ASSERT (sizeof(set) <= sizeof(state->cpus));
+    if (pthread_getaffinity_np (pthread_self (), sizeof(set), &set) == 0) {
+      memcpy (state->cpus, &set, sizeof(set));
+      state->has_cpus = TRUE;
+    }
+  }
+#endif
+  return 0;
+}
+
+gint viperfx_rt_sched_restore (const viperfx_sched_state * state)
+{
+  struct sched_param param = { 0 };
+  gint error;
+
+  param.sched_priority = state->priority;
+  error = pthread_setschedparam (pthread_self (), state->policy, &param);
+#ifdef CPU_SET
+  if (state->has_cpus) {
+    cpu_set_t set;
+    gint cpu_error;
+
+    memcpy (&set, state->cpus, sizeof(set));
+    cpu_error = pthread_setaffinity_np (pthread_self (), sizeof(set), &set);
+    if (error == 0)
+      error = cpu_error;
+  }
+#endif
+  return error;
+}
@@ -0,0 +1,51 @@
+#ifndef _VIPERFX_RT_H
+#define _VIPERFX_RT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* protections for threads that run the core in real time
+ *
+ * all of these return 0 or an errno value, ENOTSUP where the platform
+ * has no such thing.
+ */
+
+/* float control register of the calling thread */
+typedef struct _viperfx_fpu_state {
+  guint64 saved;
+} viperfx_fpu_state;
+
+/* flush denormals to zero (FTZ, and DAZ on x86) until the restore,
+ * the reverb and filter tails of the core decay into them otherwise
+ */
+gint viperfx_rt_denormals_off (viperfx_fpu_state * state);
+void viperfx_rt_denormals_restore (const viperfx_fpu_state * state);
+
+/* fault pages in and keep them resident. locks don't nest, pages stay
+ * locked until they go back to the system */
+gint viperfx_rt_lock (const void * ptr, gsize size);
+/* before a locked range is freed. only the pages it covers alone are
+ * unlocked, the ones at its ends may hold other locked buffers */
+gint viperfx_rt_unlock (const void * ptr, gsize size);
+
+/* the calling thread, priority 0 leaves the scheduling alone */
+gint viperfx_rt_set_fifo (gint priority);
+gint viperfx_rt_set_affinity (gint cpu);
+
+/* policy, priority and cpus of the calling thread, to be put back by
+ * the same thread once it no longer runs in real time
+ */
+typedef struct _viperfx_sched_state {
+  gint policy;
+  gint priority;
+  gboolean has_cpus;
+  guint64 cpus[16];
+} viperfx_sched_state;
+
+gint viperfx_rt_sched_save (viperfx_sched_state * state);
+gint viperfx_rt_sched_restore (const viperfx_sched_state * state);
+
+G_END_DECLS
+
+#endif
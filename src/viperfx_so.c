@@ -1,12 +1,25 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <dlfcn.h>
+#include <link.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "viperfx_so.h"
 
 #define ViPERFX_SO "libviperfx.so"
 #define ViPERFX_ENTRYPOINT "viperfx_create_instance"
 
+/* the one copy of the core library every element shares */
+static pthread_mutex_t library_lock = PTHREAD_MUTEX_INITIALIZER;
+static void * library_handle = NULL;
+static fn_viperfx_ep library_entrypoint = NULL;
+static unsigned int library_refs = 0;
+static int library_failed = FALSE;
+static char library_error[256];
+
 void* viperfx_load_library (const char * so_path_name)
 {
   if (so_path_name == NULL) {
@@ -31,6 +44,118 @@ fn_viperfx_ep query_viperfx_entrypoint (void * handle)
       handle, ViPERFX_ENTRYPOINT);
 }
 
+/* a failed load is remembered, later callers get NULL without
+ * another dlopen and can fetch the reason from viperfx_library_error
+ */
+fn_viperfx_ep viperfx_library_ref (void)
+{
+  fn_viperfx_ep entrypoint = NULL;
+
+  pthread_mutex_lock (&library_lock);
+  if (library_refs == 0 && !library_failed) {
+    const char * reason;
+
+    // VIPERFX_CORE_PATH picks another build, the mock core for one
+    library_handle = viperfx_load_library (getenv ("VIPERFX_CORE_PATH"));
+    library_entrypoint = query_viperfx_entrypoint (library_handle);
+    if (library_entrypoint == NULL) {
+      reason = dlerror ();
+      strncpy (library_error, reason != NULL ? reason : ViPERFX_SO,
+          sizeof(library_error) - 1);
+      viperfx_unload_library (library_handle);
+      library_handle = NULL;
+      library_failed = TRUE;
+    }
+  }
+  if (library_entrypoint != NULL) {
+    library_refs++;
+    entrypoint = library_entrypoint;
+  }
+  pthread_mutex_unlock (&library_lock);
+
+  return entrypoint;
+}
+
+/* only for callers whose viperfx_library_ref succeeded, every instance
+ * created from the entrypoint must be released before the last unref
+ */
+void viperfx_library_unref (void)
+{
+  pthread_mutex_lock (&library_lock);
+  if (library_refs > 0 && --library_refs == 0) {
+    viperfx_unload_library (library_handle);
+    library_handle = NULL;
+    library_entrypoint = NULL;
+  }
+  pthread_mutex_unlock (&library_lock);
+}
+
+const char * viperfx_library_error (void)
+{
+  const char * reason = NULL;
+
+  pthread_mutex_lock (&library_lock);
+  if (library_failed)
+    reason = library_error;
+  pthread_mutex_unlock (&library_lock);
+
+  return reason;
+}
+
+struct library_segments {
+  ElfW(Addr) base;
+  int found;
+  int error;
+};
+
+static int lock_segments (struct dl_phdr_info * info, size_t size,
+    void * data)
+{
+  struct library_segments * segments = data;
+  ElfW(Half) i;
+
+  (void) size;
+  if (info->dlpi_addr != segments->base)
+    return 0;
+
+  segments->found = TRUE;
+  for (i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) * phdr = &info->dlpi_phdr[i];
+
+    if (phdr->p_type != PT_LOAD || phdr->p_memsz == 0)
+      continue;
+    // mlock rounds the start down to its page
+    if (mlock ((void *)(info->dlpi_addr + phdr->p_vaddr),
+        phdr->p_memsz) != 0 && segments->error == 0)
+      segments->error = errno;
+  }
+  return 1;
+}
+
+/* code and data of the core, the heap it allocates from is not
+ * covered. locks don't nest so nothing is ever unlocked, dlclose
+ * takes the mapping with it
+ */
+int viperfx_library_mlock (void)
+{
+  struct library_segments segments = { 0, FALSE, 0 };
+  struct link_map * map = NULL;
+
+  pthread_mutex_lock (&library_lock);
+  if (library_handle == NULL ||
+      dlinfo (library_handle, RTLD_DI_LINKMAP, &map) != 0 || map == NULL) {
+    pthread_mutex_unlock (&library_lock);
+    return ENOENT;
+  }
+  segments.base = map->l_addr;
+  dl_iterate_phdr (lock_segments, &segments);
+  pthread_mutex_unlock (&library_lock);
+
+  if (!segments.found)
+    return ENOENT;
+  return segments.error;
+}
+
 int viperfx_command_set_px4_vx4x1 (viperfx_interface * intf,
 	int32_t param, int32_t value)
 {
@@ -82,7 +207,8 @@ int viperfx_command_set_px4_vx4x3 (viperfx_interface * intf,
 int viperfx_command_set_ir_path (viperfx_interface * intf,
     const char * pathname)
 {
-  char cmd_data[4 + 256];
+  /* id, buffer size and length ahead of the path */
+  char cmd_data[12 + 256];
   int32_t * cmd_data_int = (int32_t *)cmd_data;
 
   if (strlen (pathname) >= 256)
@@ -101,3 +227,35 @@ int viperfx_command_set_ir_path (viperfx_interface * intf,
   }
   return TRUE;
 }
+
+int viperfx_command_set_kernel (viperfx_interface * intf,
+    const float * samples, uint32_t frames, uint32_t channels,
+    int32_t kernel_id)
+{
+  int32_t cmd_data[4 + VIPERFX_KERNEL_CHUNK];
+  uint32_t total = frames * channels;
+  uint32_t offset, count;
+
+  if (!viperfx_command_set_px4_vx4x2 (intf, PARAM_HPFX_CONV_PREPAREBUFFER,
+      (int32_t)total, (int32_t)channels))
+    return FALSE;
+
+  for (offset = 0; offset < total; offset += count) {
+    count = total - offset;
+    if (count > VIPERFX_KERNEL_CHUNK)
+      count = VIPERFX_KERNEL_CHUNK;
+    cmd_data[0] = PARAM_HPFX_CONV_SETBUFFER;
+    cmd_data[1] = (int32_t)(sizeof(int32_t) * 2 + sizeof(float) * count);
+    cmd_data[2] = (int32_t)offset;
+    cmd_data[3] = (int32_t)count;
+    memcpy (&cmd_data[4], samples + offset, sizeof(float) * count);
+    if (intf->command (intf, COMMAND_CODE_SET,
+      sizeof(int32_t) * 4 + sizeof(float) * count, cmd_data,
+      NULL, NULL) != 0) {
+      return FALSE;
+    }
+  }
+
+  return viperfx_command_set_px4_vx4x3 (intf, PARAM_HPFX_CONV_COMMITBUFFER,
+      (int32_t)total, (int32_t)channels, kernel_id);
+}
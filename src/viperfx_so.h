@@ -191,6 +191,15 @@ void* viperfx_load_library (const char * so_path_name);
 void viperfx_unload_library (void * handle);
 fn_viperfx_ep query_viperfx_entrypoint (void * handle);
 
+/* process-wide refcounted library, NULL when it can't be loaded */
+fn_viperfx_ep viperfx_library_ref (void);
+void viperfx_library_unref (void);
+/* why the load failed, NULL if it didn't */
+const char * viperfx_library_error (void);
+/* lock the loaded library's segments in memory, 0 or an errno value,
+ * for callers holding a reference */
+int viperfx_library_mlock (void);
+
 int viperfx_command_set_px4_vx4x1 (viperfx_interface * intf,
 	int32_t param, int32_t value);
 int viperfx_command_set_px4_vx4x2 (viperfx_interface * intf,
@@ -200,6 +209,19 @@ int viperfx_command_set_px4_vx4x3 (viperfx_interface * intf,
 int viperfx_command_set_ir_path (viperfx_interface * intf,
     const char * pathname);
 
+/* floats per PARAM_HPFX_CONV_SETBUFFER command */
+#define VIPERFX_KERNEL_CHUNK 2048
+
+/* decoded kernel at the core rate, interleaved, through the buffer
+ * commands instead of a path:
+ *   PREPAREBUFFER { samples, channels }
+ *   SETBUFFER     { offset, count, float[count] }, count <= VIPERFX_KERNEL_CHUNK
+ *   COMMITBUFFER  { samples, channels, kernel id }
+ */
+int viperfx_command_set_kernel (viperfx_interface * intf,
+    const float * samples, uint32_t frames, uint32_t channels,
+    int32_t kernel_id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,90 @@
+#include <glib.h>
+#include "viperfx_stats.h"
+
+static const gchar *stat_names[VIPERFX_STAT_COUNT] = {
+  [VIPERFX_STAT_PROCESS] = "process",
+  [VIPERFX_STAT_COMMANDS] = "commands",
+  [VIPERFX_STAT_CONVERT] = "convert",
+};
+
+const gchar * viperfx_stats_name (guint interval)
+{
+  if (interval >= VIPERFX_STAT_COUNT)
+    return NULL;
+  return stat_names[interval];
+}
+
+/* log-linear buckets, 3 bits of mantissa per power of two
+*/
+static guint bucket_of (guint64 value)
+{
+  guint exponent;
+
+  if (value < 16)
+    return (guint) value;
+  exponent = 63 - __builtin_clzll (value);
+  return 16 + (exponent - 4) * 8 + (guint)((value >> (exponent - 3)) & 7);
+}
+
+static guint64 bucket_limit (guint bucket)
+{
+  guint exponent, mantissa;
+
+  if (bucket < 16)
+    return bucket;
+  exponent = (bucket - 16) / 8 + 4;
+  mantissa = (bucket - 16) % 8;
+  return ((guint64)(8 + mantissa + 1) << (exponent - 3)) - 1;
+}
+
+void viperfx_stats_record (viperfx_stats * stats, guint interval,
+    guint64 nanoseconds)
+{
+  g_atomic_int_inc (&stats->hist[interval].counts[bucket_of (nanoseconds)]);
+}
+
+void viperfx_stats_reset (viperfx_stats * stats)
+{
+  guint i, b;
+
+  for (i = 0; i < VIPERFX_STAT_COUNT; i++) {
+    for (b = 0; b < VIPERFX_STATS_BUCKETS; b++)
+      g_atomic_int_set (&stats->hist[i].counts[b], 0);
+  }
+}
+
+guint64 viperfx_stats_count (viperfx_stats * stats, guint interval)
+{
+  guint64 total = 0;
+  guint b;
+
+  for (b = 0; b < VIPERFX_STATS_BUCKETS; b++)
+    total += (guint) g_atomic_int_get (&stats->hist[interval].counts[b]);
+  return total;
+}
+
+guint64 viperfx_stats_percentile (viperfx_stats * stats, guint interval,
+    gdouble q)
+{
+  guint counts[VIPERFX_STATS_BUCKETS];
+  guint64 total = 0, rank, seen = 0;
+  guint b;
+
+  // one snapshot, the streaming thread may still be adding to it
+  for (b = 0; b < VIPERFX_STATS_BUCKETS; b++) {
+    counts[b] = (guint) g_atomic_int_get (&stats->hist[interval].counts[b]);
+    total += counts[b];
+  }
+  if (total == 0)
+    return 0;
+
+  rank = (guint64)(q * total + 0.5);
+  if (rank < 1)
+    rank = 1;
+  for (b = 0; b < VIPERFX_STATS_BUCKETS; b++) {
+    seen += counts[b];
+    if (seen >= rank)
+      return bucket_limit (b);
+  }
+  return bucket_limit (VIPERFX_STATS_BUCKETS - 1);
+}
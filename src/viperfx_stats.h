@@ -0,0 +1,49 @@
+#ifndef _VIPERFX_STATS_H
+#define _VIPERFX_STATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* per element timing histograms, filled by the streaming thread
+ * without locks and read by the viperfx tracer
+ */
+
+enum
+{
+  /* vfx->process, resampling and block adapter included */
+  VIPERFX_STAT_PROCESS = 0,
+  /* queued commands and parameter flush before processing */
+  VIPERFX_STAT_COMMANDS,
+  /* headroom shift or format conversion in and out of s16, stereo
+   * streams only, multichannel pairs convert inside their process */
+  VIPERFX_STAT_CONVERT,
+
+  VIPERFX_STAT_COUNT
+};
+
+/* 16 exact buckets, then 8 per power of two up to 2^63 ns */
+#define VIPERFX_STATS_BUCKETS (16 + 60 * 8)
+
+typedef struct _viperfx_histogram {
+  volatile gint counts[VIPERFX_STATS_BUCKETS];
+} viperfx_histogram;
+
+typedef struct _viperfx_stats {
+  viperfx_histogram hist[VIPERFX_STAT_COUNT];
+} viperfx_stats;
+
+const gchar * viperfx_stats_name (guint interval);
+
+void viperfx_stats_record (viperfx_stats * stats, guint interval,
+    guint64 nanoseconds);
+void viperfx_stats_reset (viperfx_stats * stats);
+
+guint64 viperfx_stats_count (viperfx_stats * stats, guint interval);
+/* upper bound of the bucket holding quantile q (0..1), within 12.5% */
+guint64 viperfx_stats_percentile (viperfx_stats * stats, guint interval,
+    gdouble q);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <glib.h>
+#include "viperfx_workpool.h"
+
+typedef struct _viperfx_task {
+  viperfx_task_func func;
+  gpointer data;
+  /* the waiter's flag for viperfx_strand_run, the task is on its stack */
+  gboolean *done;
+} viperfx_task;
+
+struct _viperfx_strand {
+  GMutex lock;
+  GCond cond;
+  GQueue tasks;
+  /* on a deque or running */
+  gboolean scheduled;
+};
+
+typedef struct _viperfx_deque {
+  GMutex lock;
+  GQueue strands;
+} viperfx_deque;
+
+typedef struct _viperfx_workpool {
+  guint n_workers;
+  viperfx_deque *deques;
+  /* strands on deques, wakes sleeping workers */
+  volatile gint queued;
+  GMutex lock;
+  GCond wake;
+  guint sleeping;
+  /* deque for submitters that aren't workers */
+  volatile gint next;
+} viperfx_workpool;
+
+static viperfx_workpool pool = { 0, };
+
+/* index + 1 of the worker running on this thread */
+static GPrivate current_worker;
+
+static guint env_uint (const gchar * name, guint fallback)
+{
+  const gchar *value = g_getenv (name);
+
+  if (value == NULL || *value == '\0')
+    return fallback;
+  return (guint) strtoul (value, NULL, 10);
+}
+
+static void workpool_schedule (viperfx_strand * strand)
+{
+  guint idx = GPOINTER_TO_UINT (g_private_get (&current_worker));
+  viperfx_deque *deque;
+
+  // a worker keeps what it schedules, where its caches are warm
+  if (idx > 0)
+    idx--;
+  else
+    idx = (guint) g_atomic_int_add (&pool.next, 1) % pool.n_workers;
+  deque = &pool.deques[idx];
+
+  g_mutex_lock (&deque->lock);
+  g_queue_push_tail (&deque->strands, strand);
+  g_mutex_unlock (&deque->lock);
+  g_atomic_int_inc (&pool.queued);
+
+  g_mutex_lock (&pool.lock);
+  if (pool.sleeping > 0)
+    g_cond_signal (&pool.wake);
+  g_mutex_unlock (&pool.lock);
+}
+
+/* own deque first, oldest first, then the newest of another worker */
+static viperfx_strand * workpool_take (guint self)
+{
+  viperfx_strand *strand;
+  guint i;
+
+  for (i = 0; i < pool.n_workers; i++) {
+    viperfx_deque *deque = &pool.deques[(self + i) % pool.n_workers];
+
+    g_mutex_lock (&deque->lock);
+    if (i == 0)
+      strand = g_queue_pop_head (&deque->strands);
+    else
+      strand = g_queue_pop_tail (&deque->strands);
+    g_mutex_unlock (&deque->lock);
+    if (strand != NULL) {
+      g_atomic_int_add (&pool.queued, -1);
+      return strand;
+    }
+  }
+  return NULL;
+}
+
+static void workpool_run_strand (viperfx_strand * strand)
+{
+  guint n;
+
+  for (n = 0; n < VIPERFX_WORKPOOL_BATCH; n++) {
+    viperfx_task *task;
+
+    g_mutex_lock (&strand->lock);
+    task = g_queue_pop_head (&strand->tasks);
+    if (task == NULL) {
+      strand->scheduled = FALSE;
+      g_cond_broadcast (&strand->cond);
+      g_mutex_unlock (&strand->lock);
+      return;
+    }
+    g_mutex_unlock (&strand->lock);
+
+    task->func (task->data);
+
+    if (task->done != NULL) {
+      g_mutex_lock (&strand->lock);
+      *task->done = TRUE;
+      g_cond_broadcast (&strand->cond);
+      g_mutex_unlock (&strand->lock);
+    } else {
+      g_free (task);
+    }
+  }
+
+  // more queued, behind the other streams of this worker
+  workpool_schedule (strand);
+}
+
+static gpointer workpool_worker (gpointer data)
+{
+  guint self = GPOINTER_TO_UINT (data);
+
+  g_private_set (&current_worker, GUINT_TO_POINTER (self + 1));
+  for (;;) {
+    viperfx_strand *strand = workpool_take (self);
+
+    if (strand != NULL) {
+      workpool_run_strand (strand);
+      continue;
+    }
+
+    g_mutex_lock (&pool.lock);
+    pool.sleeping++;
+    while (g_atomic_int_get (&pool.queued) == 0)
+      g_cond_wait (&pool.wake, &pool.lock);
+    pool.sleeping--;
+    g_mutex_unlock (&pool.lock);
+  }
+  return NULL;
+}
+
+static void workpool_init (void)
+{
+  static gsize started = 0;
+  guint i;
+
+  if (!g_once_init_enter (&started))
+    return;
+
+  pool.n_workers = env_uint ("VIPERFX_WORKERS", g_get_num_processors ());
+  if (pool.n_workers == 0)
+    pool.n_workers = 1;
+  pool.deques = g_new0 (viperfx_deque, pool.n_workers);
+  g_mutex_init (&pool.lock);
+  g_cond_init (&pool.wake);
+  for (i = 0; i < pool.n_workers; i++) {
+    g_mutex_init (&pool.deques[i].lock);
+    g_queue_init (&pool.deques[i].strands);
+  }
+  // workers steal from every deque as soon as they run
+  for (i = 0; i < pool.n_workers; i++) {
+    gchar *name = g_strdup_printf ("viperfx-pool-%u", i);
+
+    g_thread_unref (g_thread_new (name, workpool_worker,
+        GUINT_TO_POINTER (i)));
+    g_free (name);
+  }
+
+  g_once_init_leave (&started, 1);
+}
+
+guint viperfx_workpool_size (void)
+{
+  workpool_init ();
+  return pool.n_workers;
+}
+
+viperfx_strand * viperfx_strand_new (void)
+{
+  viperfx_strand *strand = g_new0 (viperfx_strand, 1);
+
+  workpool_init ();
+  g_mutex_init (&strand->lock);
+  g_cond_init (&strand->cond);
+  g_queue_init (&strand->tasks);
+  return strand;
+}
+
+void viperfx_strand_free (viperfx_strand * strand)
+{
+  if (strand == NULL)
+    return;
+
+  g_mutex_lock (&strand->lock);
+  while (strand->scheduled)
+    g_cond_wait (&strand->cond, &strand->lock);
+  g_mutex_unlock (&strand->lock);
+
+  g_mutex_clear (&strand->lock);
+  g_cond_clear (&strand->cond);
+  g_free (strand);
+}
+
+static void strand_submit (viperfx_strand * strand, viperfx_task * task)
+{
+  gboolean schedule;
+
+  g_mutex_lock (&strand->lock);
+  g_queue_push_tail (&strand->tasks, task);
+  schedule = !strand->scheduled;
+  strand->scheduled = TRUE;
+  g_mutex_unlock (&strand->lock);
+
+  // the worker that has it runs the new task after the ones before
+  if (schedule)
+    workpool_schedule (strand);
+}
+
+void viperfx_strand_push (viperfx_strand * strand, viperfx_task_func func,
+    gpointer data)
+{
+  viperfx_task *task = g_new (viperfx_task, 1);
+
+  task->func = func;
+  task->data = data;
+  task->done = NULL;
+  strand_submit (strand, task);
+}
+
+void viperfx_strand_run (viperfx_strand * strand, viperfx_task_func func,
+    gpointer data)
+{
+  gboolean done = FALSE;
+  viperfx_task task = { func, data, &done };
+
+  strand_submit (strand, &task);
+
+  g_mutex_lock (&strand->lock);
+  while (!done)
+    g_cond_wait (&strand->cond, &strand->lock);
+  g_mutex_unlock (&strand->lock);
+}
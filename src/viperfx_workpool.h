@@ -0,0 +1,42 @@
+#ifndef _VIPERFX_WORKPOOL_H
+#define _VIPERFX_WORKPOOL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* plugin-wide work-stealing pool for core calls
+ *
+ * one worker per cpu (VIPERFX_WORKERS overrides it), started with the
+ * first strand and kept for the life of the process. every worker has
+ * a deque of strands, takes from its head and steals from the tail of
+ * the others when it runs dry.
+ *
+ * a strand is one stream's serial queue: its tasks run in submission
+ * order, one at a time, on whichever worker has the strand. a strand
+ * sits on at most one deque, so a stream's core is never touched from
+ * two workers at once.
+ */
+
+/* tasks a worker runs from one strand before it lets others go first */
+#define VIPERFX_WORKPOOL_BATCH 4
+
+typedef void (*viperfx_task_func) (gpointer data);
+
+typedef struct _viperfx_strand viperfx_strand;
+
+viperfx_strand * viperfx_strand_new (void);
+/* waits for the tasks still queued */
+void viperfx_strand_free (viperfx_strand * strand);
+
+void viperfx_strand_push (viperfx_strand * strand, viperfx_task_func func,
+    gpointer data);
+/* push and wait until the task ran, never from a task */
+void viperfx_strand_run (viperfx_strand * strand, viperfx_task_func func,
+    gpointer data);
+
+guint viperfx_workpool_size (void);
+
+G_END_DECLS
+
+#endif
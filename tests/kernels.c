@@ -0,0 +1,242 @@
+/* every sample kernel variant against the scalar reference
+ *
+ * the vector variants must be bit-exact with scalar, over odd lengths,
+ * misaligned pointers and, where the kernel allows it, src == dst.
+ * variants not built in or not supported by the cpu are skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "viperfx_kernels.h"
+
+/* longest run, room for the largest offset on top */
+#define MAX_COUNT 4099
+#define MAX_OFFSET 7
+#define BUFFER (MAX_COUNT + MAX_OFFSET + 8)
+
+static const size_t counts[] = {
+  0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 127, 255, 1023,
+  MAX_COUNT
+};
+static const size_t offsets[] = { 0, 1, 3, MAX_OFFSET };
+
+#define N_COUNTS (sizeof(counts) / sizeof(counts[0]))
+#define N_OFFSETS (sizeof(offsets) / sizeof(offsets[0]))
+
+static int failures = 0;
+
+static void fail (const viperfx_kernels * k, const char * kernel,
+    size_t count, size_t offset, const char * how)
+{
+  fprintf (stderr, "FAIL %s %s count %zu offset %zu%s%s\n", k->name, kernel,
+      count, offset, how[0] != '\0' ? " " : "", how);
+  failures++;
+}
+
+/* xorshift, the same data on every run */
+static uint32_t rand_state = 0x9e3779b9u;
+
+static uint32_t next_rand (void)
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static int16_t s16_in[BUFFER], s16_src[BUFFER];
+static int32_t s32_in[BUFFER];
+static float f32_in[BUFFER], f32_b[BUFFER];
+static int16_t s16_ref[BUFFER], s16_out[BUFFER];
+static int32_t s32_ref[BUFFER], s32_out[BUFFER];
+static float f32_ref[BUFFER], f32_out[BUFFER];
+
+static void fill_inputs (void)
+{
+  size_t i;
+
+  for (i = 0; i < BUFFER; i++) {
+    s16_in[i] = (int16_t) next_rand ();
+    s16_src[i] = (int16_t) next_rand ();
+    s32_in[i] = (int32_t) next_rand ();
+    // past full scale both ways, to exercise the clamps
+    f32_in[i] = ((float) (next_rand () % 50001) - 25000.0f) / 20000.0f;
+    f32_b[i] = ((float) (next_rand () % 20001) - 10000.0f) / 10000.0f;
+  }
+  // the extremes
+  s16_in[0] = -32768;
+  s16_in[1] = 32767;
+  s32_in[0] = INT32_MIN;
+  s32_in[1] = INT32_MAX;
+  f32_in[0] = 1.0f;
+  f32_in[1] = -1.0f;
+  f32_in[2] = NAN;
+  f32_in[3] = INFINITY;
+  f32_in[4] = -INFINITY;
+}
+
+static void check_headroom (const viperfx_kernels * k,
+    const viperfx_kernels * s, size_t count, size_t off)
+{
+  s->headroom_s16 (s16_in + off, s16_ref, count);
+  k->headroom_s16 (s16_in + off, s16_out + off, count);
+  if (memcmp (s16_ref, s16_out + off, count * sizeof(int16_t)) != 0)
+    fail (k, "headroom_s16", count, off, "");
+
+  // in place
+  memcpy (s16_out + off, s16_in + off, count * sizeof(int16_t));
+  k->headroom_s16 (s16_out + off, s16_out + off, count);
+  if (memcmp (s16_ref, s16_out + off, count * sizeof(int16_t)) != 0)
+    fail (k, "headroom_s16", count, off, "aliased");
+
+  // s16_in has both extremes, where the doubling saturates
+  s->makeup_s16 (s16_in + off, s16_ref, count);
+  k->makeup_s16 (s16_in + off, s16_out + off, count);
+  if (memcmp (s16_ref, s16_out + off, count * sizeof(int16_t)) != 0)
+    fail (k, "makeup_s16", count, off, "");
+
+  memcpy (s16_out + off, s16_in + off, count * sizeof(int16_t));
+  k->makeup_s16 (s16_out + off, s16_out + off, count);
+  if (memcmp (s16_ref, s16_out + off, count * sizeof(int16_t)) != 0)
+    fail (k, "makeup_s16", count, off, "aliased");
+}
+
+static void check_conversions (const viperfx_kernels * k,
+    const viperfx_kernels * s, size_t count, size_t off)
+{
+  s->f32_to_s16_headroom (f32_in + off, s16_ref, count);
+  k->f32_to_s16_headroom (f32_in + off, s16_out + off, count);
+  if (memcmp (s16_ref, s16_out + off, count * sizeof(int16_t)) != 0)
+    fail (k, "f32_to_s16_headroom", count, off, "");
+
+  s->s32_to_s16_headroom (s32_in + off, s16_ref, count);
+  k->s32_to_s16_headroom (s32_in + off, s16_out + off, count);
+  if (memcmp (s16_ref, s16_out + off, count * sizeof(int16_t)) != 0)
+    fail (k, "s32_to_s16_headroom", count, off, "");
+
+  s->s16_to_f32 (s16_in + off, f32_ref, count);
+  k->s16_to_f32 (s16_in + off, f32_out + off, count);
+  if (memcmp (f32_ref, f32_out + off, count * sizeof(float)) != 0)
+    fail (k, "s16_to_f32", count, off, "");
+
+  s->s16_to_s32 (s16_in + off, s32_ref, count);
+  k->s16_to_s32 (s16_in + off, s32_out + off, count);
+  if (memcmp (s32_ref, s32_out + off, count * sizeof(int32_t)) != 0)
+    fail (k, "s16_to_s32", count, off, "");
+}
+
+static void check_dot (const viperfx_kernels * k,
+    const viperfx_kernels * s, size_t count, size_t off)
+{
+  float ref, out;
+
+  // the resampler only asks for whole groups of 8
+  count -= count % 8;
+  ref = s->dot_f32 (f32_in + 8 + off, f32_b + off, count);
+  out = k->dot_f32 (f32_in + 8 + off, f32_b + off, count);
+  if (memcmp (&ref, &out, sizeof(float)) != 0)
+    fail (k, "dot_f32", count, off, "");
+}
+
+static void check_xfade (const viperfx_kernels * k,
+    const viperfx_kernels * s, size_t count, size_t off)
+{
+  size_t frames = count / 2;
+  float step = frames > 0 ? 1.0f / (float) frames : 0.0f;
+
+  memcpy (s16_ref, s16_in + off, frames * 2 * sizeof(int16_t));
+  memcpy (s16_out + off, s16_in + off, frames * 2 * sizeof(int16_t));
+  s->xfade_s16 (s16_ref, s16_src + off, frames, 0.0f, 1.0f, step, -step);
+  k->xfade_s16 (s16_out + off, s16_src + off, frames, 0.0f, 1.0f, step,
+      -step);
+  if (memcmp (s16_ref, s16_out + off, frames * 2 * sizeof(int16_t)) != 0)
+    fail (k, "xfade_s16", count, off, "");
+
+  // gains past unity, to exercise the clamps
+  memcpy (s16_ref, s16_in + off, frames * 2 * sizeof(int16_t));
+  memcpy (s16_out + off, s16_in + off, frames * 2 * sizeof(int16_t));
+  s->xfade_s16 (s16_ref, s16_src + off, frames, 1.5f, 1.5f, step, step);
+  k->xfade_s16 (s16_out + off, s16_src + off, frames, 1.5f, 1.5f, step,
+      step);
+  if (memcmp (s16_ref, s16_out + off, frames * 2 * sizeof(int16_t)) != 0)
+    fail (k, "xfade_s16", count, off, "clamped");
+}
+
+static void check_is_zero (const viperfx_kernels * k,
+    const viperfx_kernels * s, size_t count, size_t off)
+{
+  uint8_t * bytes = (uint8_t *) s16_out;
+  size_t size = count * sizeof(int16_t);
+  size_t pos;
+
+  memset (bytes, 0, sizeof(s16_out));
+  if (k->is_zero (bytes + off, size) != s->is_zero (bytes + off, size) ||
+      !k->is_zero (bytes + off, size))
+    fail (k, "is_zero", count, off, "zeros");
+
+  // a single set bit anywhere, and just outside the range
+  for (pos = 0; pos < size; pos += (size > 64) ? 61 : 1) {
+    bytes[off + pos] = 0x10;
+    if (k->is_zero (bytes + off, size) != s->is_zero (bytes + off, size))
+      fail (k, "is_zero", count, off, "one byte set");
+    bytes[off + pos] = 0;
+  }
+  bytes[off + size] = 0x01;
+  if (k->is_zero (bytes + off, size) != s->is_zero (bytes + off, size))
+    fail (k, "is_zero", count, off, "byte past the end");
+}
+
+static void check_peak (const viperfx_kernels * k,
+    const viperfx_kernels * s, size_t count, size_t off)
+{
+  size_t pos;
+
+  if (k->peak_s16 (s16_in + off, count) != s->peak_s16 (s16_in + off, count))
+    fail (k, "peak_s16", count, off, "");
+
+  // quiet data with one full scale negative sample
+  for (pos = 0; pos < BUFFER; pos++)
+    s16_out[pos] = (int16_t) ((int) (next_rand () % 201) - 100);
+  if (count > 0)
+    s16_out[off + count - 1] = -32768;
+  if (k->peak_s16 (s16_out + off, count) != s->peak_s16 (s16_out + off, count))
+    fail (k, "peak_s16", count, off, "-32768");
+}
+
+int main (void)
+{
+  const viperfx_kernels * scalar = viperfx_kernels_get (VIPERFX_ISA_SCALAR);
+  int isa, tested = 0;
+  size_t c, o;
+
+  fill_inputs ();
+
+  for (isa = VIPERFX_ISA_SCALAR + 1; isa < VIPERFX_ISA_COUNT; isa++) {
+    const viperfx_kernels * k = viperfx_kernels_get (isa);
+
+    if (k == NULL) {
+      printf ("skip isa %d, not available\n", isa);
+      continue;
+    }
+    for (c = 0; c < N_COUNTS; c++) {
+      for (o = 0; o < N_OFFSETS; o++) {
+        check_headroom (k, scalar, counts[c], offsets[o]);
+        check_conversions (k, scalar, counts[c], offsets[o]);
+        check_dot (k, scalar, counts[c], offsets[o]);
+        check_xfade (k, scalar, counts[c], offsets[o]);
+        check_is_zero (k, scalar, counts[c], offsets[o]);
+        check_peak (k, scalar, counts[c], offsets[o]);
+      }
+    }
+    printf ("%s: %s\n", k->name, failures == 0 ? "ok" : "FAILED");
+    tested++;
+  }
+
+  // nothing but scalar here, there is nothing to compare
+  if (tested == 0)
+    return 77;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/* test fixtures for the render test
+ *
+ *   wavtool gen OUT.wav
+ *   wavtool compare REFERENCE.wav TEST.wav MAX_LSB MAX_RMS_DBFS
+ *
+ * gen writes three seconds of s16 stereo at 44.1 kHz, a sweep on the
+ * left and noise on the right, the same on every run. compare reads
+ * both files, which must be s16 with the same length, and fails when
+ * the largest difference or its rms is above the bounds, or when the
+ * reference is silent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define GEN_RATE 44100
+#define GEN_FRAMES (3 * GEN_RATE)
+
+static void put_u16 (uint8_t * p, uint32_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32 (uint8_t * p, uint32_t v)
+{
+  put_u16 (p, v & 0xffff);
+  put_u16 (p + 2, v >> 16);
+}
+
+static uint32_t get_u16 (const uint8_t * p)
+{
+  return p[0] | (uint32_t) p[1] << 8;
+}
+
+static uint32_t get_u32 (const uint8_t * p)
+{
+  return get_u16 (p) | get_u16 (p + 2) << 16;
+}
+
+static int gen (const char * path)
+{
+  uint8_t header[44];
+  uint32_t state = 0x2545f491u, data = GEN_FRAMES * 4;
+  double phase = 0.0;
+  FILE * f;
+  size_t i;
+
+  f = fopen (path, "wb");
+  if (f == NULL) {
+    perror (path);
+    return 1;
+  }
+  memcpy (header, "RIFF", 4);
+  put_u32 (header + 4, 36 + data);
+  memcpy (header + 8, "WAVEfmt ", 8);
+  put_u32 (header + 16, 16);
+  put_u16 (header + 20, 1);
+  put_u16 (header + 22, 2);
+  put_u32 (header + 24, GEN_RATE);
+  put_u32 (header + 28, GEN_RATE * 4);
+  put_u16 (header + 32, 4);
+  put_u16 (header + 34, 16);
+  memcpy (header + 36, "data", 4);
+  put_u32 (header + 40, data);
+  fwrite (header, 1, sizeof(header), f);
+
+  for (i = 0; i < GEN_FRAMES; i++) {
+    // 20 Hz to 20 kHz over the file, and xorshift noise
+    double freq = 20.0 * pow (1000.0, (double) i / GEN_FRAMES);
+    uint8_t frame[4];
+
+    phase += 2.0 * M_PI * freq / GEN_RATE;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    put_u16 (frame, (uint16_t) (int16_t) lrint (16000.0 * sin (phase)));
+    put_u16 (frame + 2, (uint16_t) (int16_t) ((int32_t) (state >> 16) / 4));
+    fwrite (frame, 1, sizeof(frame), f);
+  }
+  if (fclose (f) != 0) {
+    perror (path);
+    return 1;
+  }
+  return 0;
+}
+
+/* the samples of a 16 bit pcm file, other chunks skipped */
+static int16_t * load (const char * path, size_t * count)
+{
+  uint8_t head[12], chunk[8], fmt[16];
+  int16_t * samples = NULL;
+  int have_fmt = 0;
+  uint32_t size;
+  FILE * f;
+  size_t i;
+
+  f = fopen (path, "rb");
+  if (f == NULL) {
+    perror (path);
+    return NULL;
+  }
+  if (fread (head, 1, 12, f) != 12 || memcmp (head, "RIFF", 4) != 0 ||
+      memcmp (head + 8, "WAVE", 4) != 0)
+    goto bad;
+
+  while (fread (chunk, 1, 8, f) == 8) {
+    size = get_u32 (chunk + 4);
+    if (memcmp (chunk, "fmt ", 4) == 0 && size >= 16) {
+      if (fread (fmt, 1, 16, f) != 16 || get_u16 (fmt) != 1 ||
+          get_u16 (fmt + 14) != 16)
+        goto bad;
+      have_fmt = 1;
+      size -= 16;
+    } else if (memcmp (chunk, "data", 4) == 0 && have_fmt) {
+      // a streaming writer may leave the size open
+      if (size == 0 || size == 0xffffffffu) {
+        long here = ftell (f);
+
+        fseek (f, 0, SEEK_END);
+        size = (uint32_t) (ftell (f) - here);
+        fseek (f, here, SEEK_SET);
+      }
+      *count = size / 2;
+      samples = malloc (*count * sizeof(int16_t) + 1);
+      if (samples == NULL || fread (samples, 2, *count, f) != *count)
+        goto bad;
+      for (i = 0; i < *count; i++)
+        samples[i] = (int16_t) get_u16 ((const uint8_t *) &samples[i]);
+      fclose (f);
+      return samples;
+    }
+    if (fseek (f, size + (size & 1), SEEK_CUR) != 0)
+      goto bad;
+  }
+
+bad:
+  fprintf (stderr, "%s: not a 16 bit pcm wav file\n", path);
+  free (samples);
+  fclose (f);
+  return NULL;
+}
+
+static int compare (const char * ref_path, const char * test_path,
+    int max_lsb, double max_rms)
+{
+  int16_t * ref, * test;
+  size_t n_ref, n_test, i, where = 0;
+  double sum = 0.0, level = 0.0, rms;
+  int max = 0, ok;
+
+  ref = load (ref_path, &n_ref);
+  test = load (test_path, &n_test);
+  if (ref == NULL || test == NULL) {
+    free (ref);
+    free (test);
+    return 1;
+  }
+  if (n_ref != n_test) {
+    fprintf (stderr, "%zu samples against %zu\n", n_test, n_ref);
+    free (ref);
+    free (test);
+    return 1;
+  }
+
+  for (i = 0; i < n_ref; i++) {
+    int d = abs (test[i] - ref[i]);
+
+    if (d > max) {
+      max = d;
+      where = i;
+    }
+    sum += (double) d * d;
+    level += (double) ref[i] * ref[i];
+  }
+  free (ref);
+  free (test);
+
+  rms = sum > 0.0 ?
+      10.0 * log10 (sum / n_ref / (32768.0 * 32768.0)) : -INFINITY;
+  printf ("max %d LSB at sample %zu, rms %.1f dBFS\n", max, where, rms);
+  ok = max <= max_lsb && rms <= max_rms;
+  // a core that outputs nothing matches itself everywhere
+  if (level == 0.0) {
+    fprintf (stderr, "%s is silent\n", ref_path);
+    ok = 0;
+  }
+  return ok ? 0 : 1;
+}
+
+int main (int argc, char * argv[])
+{
+  if (argc == 3 && strcmp (argv[1], "gen") == 0)
+    return gen (argv[2]);
+  if (argc == 6 && strcmp (argv[1], "compare") == 0)
+    return compare (argv[2], argv[3], atoi (argv[4]), atof (argv[5]));
+  fprintf (stderr, "usage: %s gen OUT | compare REF TEST MAX_LSB MAX_RMS\n",
+      argv[0]);
+  return 2;
+}
@@ -0,0 +1,935 @@
+/* viperfx-render, offline batch rendering through the viperfx core
+ *
+ *   viperfx-render [-j jobs] [-o dir] [-p preset] [--segment] manifest
+ *
+ * every manifest line is one file, fields separated by tabs:
+ *
+ *   input [preset [output]]
+ *
+ * empty lines and lines starting with # are skipped, "-" reads the
+ * manifest from stdin. a missing or "-" preset renders with --preset,
+ * or the element defaults with fx_enable on. a missing output is the
+ * input name with .viperfx.wav appended, next to the input or in
+ * --output-dir. the output format follows the extension (.wav, .flac,
+ * .ogg).
+ *
+ * files are decoded to s16 stereo at 44.1 kHz or more and rendered on
+ * a pool of worker threads, each with one core instance of its own
+ * that is reconfigured for every file. throughput is reported per
+ * file as audio time over wall time.
+ *
+ * with --segment the files are rendered one after the other instead,
+ * each split into one segment per worker. a segment's core starts
+ * --preroll seconds early (by default long enough for the reverb,
+ * convolver and agc settings of the preset) and that output is
+ * dropped, neighbouring segments then overlap by --stitch milliseconds
+ * and are crossfaded. the seams are close to, not exactly, what one
+ * pass gives; --verify renders the file once more in one pass and
+ * reports the difference. a segmented file is held in memory whole.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+#include "viperfx_so.h"
+#include "viperfx_params.h"
+#include "viperfx_preset.h"
+#include "viperfx_ircache.h"
+#include "viperfx_kernels.h"
+
+/* what the core takes, lower rates are resampled up on decode */
+#define RENDER_CAPS \
+  "audio/x-raw,format=S16LE,channels=2,layout=interleaved,rate=[44100,MAX]"
+
+/* frames per core call */
+#define RENDER_CHUNK 4096
+
+/* decoded buffers waiting for a worker, and encoder input queued */
+#define RENDER_QUEUE_BUFFERS 8
+#define RENDER_QUEUE_BYTES (1 << 20)
+
+/* how often a worker looks for decoder errors while it waits */
+#define RENDER_POLL (100 * GST_MSECOND)
+
+/* --segment pre-roll in seconds: the least, with a convolver whose
+ * kernel length isn't known, and with the agc on
+ */
+#define RENDER_PREROLL_MIN 0.5
+#define RENDER_PREROLL_IR 3.0
+#define RENDER_PREROLL_AGC 5.0
+
+#define RENDER_STITCH_DEFAULT 50
+
+typedef struct _render_job {
+  guint index;
+  gchar *input;
+  gchar *preset;
+  gchar *output;
+  /* filled in by the worker */
+  gboolean done;
+  gboolean ok;
+  gchar *error;
+  gint rate;
+  guint64 frames;
+  gdouble seconds;
+} render_job;
+
+typedef struct _render_worker {
+  GThread *thread;
+  viperfx_interface *vfx;
+} render_worker;
+
+static fn_viperfx_ep entrypoint = NULL;
+static const viperfx_kernels *kernels = NULL;
+static GAsyncQueue *queue = NULL;
+static guint n_jobs = 0;
+static GMutex report_lock;
+static gboolean quiet = FALSE;
+static gdouble preroll = -1.0;
+static gint stitch = RENDER_STITCH_DEFAULT;
+static gboolean verify = FALSE;
+
+static void
+render_job_free (render_job *job)
+{
+  g_free (job->input);
+  g_free (job->preset);
+  g_free (job->output);
+  g_free (job->error);
+  g_free (job);
+}
+
+static const gchar *
+render_encoder (const gchar *path)
+{
+  if (g_str_has_suffix (path, ".flac"))
+    return "flacenc";
+  if (g_str_has_suffix (path, ".ogg"))
+    return "vorbisenc ! oggmux";
+  return "wavenc";
+}
+
+/* the core at defaults, then everything the preset sets. every value is
+ * sent, so nothing of the previous file is left over
+ */
+static gboolean
+render_configure (viperfx_interface *vfx, const viperfx_preset *preset,
+    gint rate, GError **error)
+{
+  const gchar *ir_path = "";
+  viperfx_param_store store;
+  viperfx_ir *ir = NULL;
+  GError *err = NULL;
+  gboolean ok;
+
+  if (!vfx->set_samplerate (vfx, rate) || !vfx->set_channels (vfx, 2)) {
+    g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_NEGOTIATION,
+        "core can't run at %d Hz", rate);
+    return FALSE;
+  }
+
+  viperfx_param_store_init (&store);
+  // rendering with processing off makes no sense, unless a preset says so
+  store.value[VIPERFX_PARAM_FX_ENABLE] = 1;
+  if (preset != NULL)
+    viperfx_preset_apply (preset, &store);
+  viperfx_param_store_flush (&store, &vfx, 1, TRUE, NULL);
+
+  if (preset != NULL && preset->has_ir_path) {
+    ir_path = preset->ir_path;
+    ir = viperfx_ir_cache_get (ir_path, rate, &err);
+    // the core reads files the cache can't decode itself
+    g_clear_error (&err);
+  }
+  if (ir != NULL) {
+    ok = viperfx_ir_send (ir, vfx);
+    viperfx_ir_unref (ir);
+  } else {
+    ok = viperfx_command_set_ir_path (vfx, ir_path);
+  }
+  if (!ok) {
+    g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+        "core refused impulse response %s", ir_path);
+    return FALSE;
+  }
+
+  vfx->reset (vfx);
+  return TRUE;
+}
+
+/* first error on a bus, if any */
+static gboolean
+render_bus_error (GstElement *pipeline, GstClockTime timeout, GError **error)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+
+  msg = gst_bus_timed_pop_filtered (bus, timeout, GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+  if (msg == NULL)
+    return FALSE;
+  gst_message_parse_error (msg, error, NULL);
+  gst_message_unref (msg);
+  return TRUE;
+}
+
+static GstElement *
+render_encode_pipeline (const gchar *output, GstCaps *caps, GError **error)
+{
+  GstElement *pipeline, *src, *sink;
+  gchar *desc;
+
+  desc = g_strdup_printf ("appsrc name=src format=time block=true "
+      "max-bytes=%u ! audioconvert ! %s ! filesink name=sink",
+      RENDER_QUEUE_BYTES, render_encoder (output));
+  pipeline = gst_parse_launch (desc, error);
+  g_free (desc);
+  if (pipeline == NULL)
+    return NULL;
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  gst_app_src_set_caps (GST_APP_SRC (src), caps);
+  g_object_set (sink, "location", output, NULL);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  return pipeline;
+}
+
+/* s16 stereo through the core in place, headroom included */
+static void
+render_process_pcm (viperfx_interface *vfx, gint16 *pcm, guint64 num_frames)
+{
+  guint chunk;
+
+  kernels->headroom_s16 (pcm, pcm, num_frames * 2);
+  while (num_frames > 0) {
+    chunk = MIN (num_frames, RENDER_CHUNK);
+    vfx->process (vfx, pcm, (int) chunk);
+    pcm += chunk * 2;
+    num_frames -= chunk;
+  }
+}
+
+/* a decoded buffer through the core in place, FALSE if it can't be
+ * mapped
+ */
+static gboolean
+render_process (viperfx_interface *vfx, GstBuffer *buffer, guint64 *frames)
+{
+  GstMapInfo map;
+  guint num_frames;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READWRITE))
+    return FALSE;
+  num_frames = map.size / (2 * sizeof(gint16));
+  render_process_pcm (vfx, (gint16 *) map.data, num_frames);
+  *frames += num_frames;
+  gst_buffer_unmap (buffer, &map);
+  return TRUE;
+}
+
+/* file to s16 stereo, pulled from sink */
+static GstElement *
+render_decode_pipeline (const gchar *input, GstAppSink **sink,
+    GError **error)
+{
+  GstElement *decode, *element;
+
+  decode = gst_parse_launch ("filesrc name=src ! decodebin ! audioconvert ! "
+      "audioresample ! appsink name=sink sync=false caps=" RENDER_CAPS, error);
+  if (decode == NULL)
+    return NULL;
+  element = gst_bin_get_by_name (GST_BIN (decode), "src");
+  g_object_set (element, "location", input, NULL);
+  gst_object_unref (element);
+  *sink = GST_APP_SINK (gst_bin_get_by_name (GST_BIN (decode), "sink"));
+  gst_app_sink_set_max_buffers (*sink, RENDER_QUEUE_BUFFERS);
+  gst_element_set_state (decode, GST_STATE_PLAYING);
+  return decode;
+}
+
+/* next decoded sample, NULL at the end or with error set */
+static GstSample *
+render_pull (GstElement *decode, GstAppSink *sink, GError **error)
+{
+  GstSample *sample;
+
+  for (;;) {
+    sample = gst_app_sink_try_pull_sample (sink, RENDER_POLL);
+    if (sample != NULL || gst_app_sink_is_eos (sink))
+      return sample;
+    if (render_bus_error (decode, 0, error))
+      return NULL;
+  }
+}
+
+static void
+render_decode_free (GstElement *decode, GstAppSink *sink)
+{
+  gst_element_set_state (decode, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (decode);
+}
+
+/* the file is complete once the encoder has seen the end */
+static gboolean
+render_encode_finish (GstElement *encode, GstElement *src, GError **error)
+{
+  GstBus *bus = gst_element_get_bus (encode);
+  GstMessage *msg;
+  gboolean ok = FALSE;
+
+  gst_app_src_end_of_stream (GST_APP_SRC (src));
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+    gst_message_parse_error (msg, error, NULL);
+  else
+    ok = TRUE;
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  return ok;
+}
+
+/* decode, process and encode one file on the worker's core */
+static gboolean
+render_file (render_worker *worker, render_job *job, GError **error)
+{
+  GstElement *decode, *encode = NULL, *src = NULL;
+  viperfx_preset *preset = NULL;
+  gboolean ok = FALSE;
+  GstSample *sample;
+  GstAppSink *sink;
+
+  if (job->preset != NULL) {
+    preset = viperfx_preset_load (job->preset, error);
+    if (preset == NULL)
+      return FALSE;
+  }
+
+  decode = render_decode_pipeline (job->input, &sink, error);
+  if (decode == NULL) {
+    viperfx_preset_unref (preset);
+    return FALSE;
+  }
+
+  while ((sample = render_pull (decode, sink, error)) != NULL) {
+    GstBuffer *buffer;
+
+    // the stream format is only known with the first buffer
+    if (encode == NULL) {
+      GstCaps *caps = gst_sample_get_caps (sample);
+      GstStructure *s = gst_caps_get_structure (caps, 0);
+
+      gst_structure_get_int (s, "rate", &job->rate);
+      if (!render_configure (worker->vfx, preset, job->rate, error) ||
+          (encode = render_encode_pipeline (job->output, caps,
+              error)) == NULL) {
+        gst_sample_unref (sample);
+        goto done;
+      }
+      src = gst_bin_get_by_name (GST_BIN (encode), "src");
+      gst_element_set_state (encode, GST_STATE_PLAYING);
+    }
+
+    buffer = gst_buffer_ref (gst_sample_get_buffer (sample));
+    gst_sample_unref (sample);
+    // sole owner now, normally this doesn't copy
+    buffer = gst_buffer_make_writable (buffer);
+    if (!render_process (worker->vfx, buffer, &job->frames)) {
+      g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+          "can't map a decoded buffer of %s", job->input);
+      gst_buffer_unref (buffer);
+      goto done;
+    }
+    // a failed encoder would leave the blocking push waiting for good
+    if (render_bus_error (encode, 0, error)) {
+      gst_buffer_unref (buffer);
+      goto done;
+    }
+    if (gst_app_src_push_buffer (GST_APP_SRC (src), buffer) != GST_FLOW_OK) {
+      render_bus_error (encode, 0, error);
+      goto done;
+    }
+  }
+  if (error != NULL && *error != NULL)
+    goto done;
+
+  if (encode == NULL) {
+    g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_DECODE,
+        "no audio in %s", job->input);
+    goto done;
+  }
+  ok = render_encode_finish (encode, src, error);
+
+done:
+  render_decode_free (decode, sink);
+  if (encode != NULL) {
+    gst_element_set_state (encode, GST_STATE_NULL);
+    gst_object_unref (src);
+    gst_object_unref (encode);
+  }
+  viperfx_preset_unref (preset);
+  return ok;
+}
+
+/* how far ahead of its first frame a segment starts the core, so that
+ * reverb tails, the convolver and the agc have settled by then
+ */
+static gdouble
+render_preroll (const viperfx_preset *preset, gint rate)
+{
+  viperfx_param_store store;
+  gdouble seconds = RENDER_PREROLL_MIN;
+
+  if (preroll >= 0.0)
+    return preroll;
+
+  viperfx_param_store_init (&store);
+  store.value[VIPERFX_PARAM_FX_ENABLE] = 1;
+  if (preset != NULL)
+    viperfx_preset_apply (preset, &store);
+
+  if (store.value[VIPERFX_PARAM_CONV_ENABLE]) {
+    viperfx_ir *ir = NULL;
+
+    if (preset != NULL && preset->has_ir_path)
+      ir = viperfx_ir_cache_get (preset->ir_path, rate, NULL);
+    if (ir != NULL) {
+      seconds = MAX (seconds, (gdouble) ir->frames / ir->rate +
+          RENDER_PREROLL_MIN);
+      viperfx_ir_unref (ir);
+    } else {
+      seconds = MAX (seconds, RENDER_PREROLL_IR);
+    }
+  }
+  // the room size scales the decay of the reverb
+  if (store.value[VIPERFX_PARAM_REVERB_ENABLE]) {
+    seconds = MAX (seconds, 1.0 +
+        3.0 * store.value[VIPERFX_PARAM_REVERB_ROOMSIZE] / 100.0);
+  }
+  if (store.value[VIPERFX_PARAM_AGC_ENABLE])
+    seconds = MAX (seconds, RENDER_PREROLL_AGC);
+  return seconds;
+}
+
+/* whole file as s16 stereo in memory */
+static gint16 *
+render_decode_all (const gchar *input, GstCaps **caps, gint *rate,
+    guint64 *frames, GError **error)
+{
+  GstElement *decode;
+  GstAppSink *sink;
+  GstSample *sample;
+  GByteArray *pcm;
+
+  decode = render_decode_pipeline (input, &sink, error);
+  if (decode == NULL)
+    return NULL;
+
+  pcm = g_byte_array_new ();
+  while ((sample = render_pull (decode, sink, error)) != NULL) {
+    GstBuffer *buffer = gst_sample_get_buffer (sample);
+    GstMapInfo map;
+
+    if (*caps == NULL) {
+      *caps = gst_caps_ref (gst_sample_get_caps (sample));
+      gst_structure_get_int (gst_caps_get_structure (*caps, 0), "rate", rate);
+    }
+    if (!gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+      g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+          "can't map a decoded buffer of %s", input);
+      gst_sample_unref (sample);
+      break;
+    }
+    g_byte_array_append (pcm, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+    gst_sample_unref (sample);
+  }
+  render_decode_free (decode, sink);
+
+  if ((error != NULL && *error != NULL) || pcm->len == 0) {
+    if (pcm->len == 0 && (error == NULL || *error == NULL))
+      g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_DECODE,
+          "no audio in %s", input);
+    g_byte_array_free (pcm, TRUE);
+    return NULL;
+  }
+  *frames = pcm->len / (2 * sizeof(gint16));
+  return (gint16 *) g_byte_array_free (pcm, FALSE);
+}
+
+/* one part of a file on a core of its own. the core starts at first,
+ * before the frames it is responsible for, and what comes out of it
+ * before start - overlap is thrown away
+ */
+typedef struct _render_segment {
+  GThread *thread;
+  viperfx_interface *vfx;
+  const viperfx_preset *preset;
+  gint rate;
+  const gint16 *in;
+  gint16 *out;
+  guint64 first;
+  guint64 start;
+  guint64 end;
+  guint64 overlap;
+  /* output for [start - overlap, start), faded in over the previous one */
+  gint16 *head;
+  gboolean ok;
+  GError *error;
+} render_segment;
+
+static gpointer
+render_segment_run (gpointer data)
+{
+  render_segment *seg = data;
+  guint64 frames = seg->end - seg->first;
+  gint16 *pcm;
+
+  seg->ok = render_configure (seg->vfx, seg->preset, seg->rate, &seg->error);
+  if (!seg->ok)
+    return NULL;
+
+  pcm = g_new (gint16, frames * 2);
+  memcpy (pcm, seg->in + seg->first * 2, frames * 2 * sizeof(gint16));
+  render_process_pcm (seg->vfx, pcm, frames);
+  if (seg->overlap > 0) {
+    seg->head = g_new (gint16, seg->overlap * 2);
+    memcpy (seg->head, pcm + (seg->start - seg->overlap - seg->first) * 2,
+        seg->overlap * 2 * sizeof(gint16));
+  }
+  memcpy (seg->out + seg->start * 2, pcm + (seg->start - seg->first) * 2,
+      (seg->end - seg->start) * 2 * sizeof(gint16));
+  g_free (pcm);
+  return NULL;
+}
+
+/* how far the stitched output is from rendering the file in one pass */
+static void
+render_verify (viperfx_interface *vfx, const viperfx_preset *preset,
+    const render_job *job, const gint16 *in, const gint16 *out)
+{
+  guint64 frames = job->frames, i, differ = 0, where = 0;
+  gint max = 0;
+  gdouble sum = 0.0;
+  gint16 *ref;
+  GError *err = NULL;
+
+  if (!render_configure (vfx, preset, job->rate, &err)) {
+    g_printerr ("%s: no reference render: %s\n", job->input, err->message);
+    g_error_free (err);
+    return;
+  }
+  ref = g_new (gint16, frames * 2);
+  memcpy (ref, in, frames * 2 * sizeof(gint16));
+  render_process_pcm (vfx, ref, frames);
+
+  for (i = 0; i < frames * 2; i++) {
+    gint d = ABS (out[i] - ref[i]);
+
+    if (d > max) {
+      max = d;
+      where = i / 2;
+    }
+    if (d != 0)
+      differ++;
+    sum += (gdouble) d * d;
+  }
+  g_free (ref);
+
+  g_mutex_lock (&report_lock);
+  if (max == 0) {
+    g_print ("%s: identical to a single pass\n", job->input);
+  } else {
+    g_print ("%s: against a single pass, max %d LSB (%.1f dBFS) at %.3f s, "
+        "rms %.1f dBFS, %.3f%% of samples differ\n", job->input, max,
+        20.0 * log10 (max / 32768.0), (gdouble) where / job->rate,
+        10.0 * log10 (sum / (frames * 2) / (32768.0 * 32768.0)),
+        100.0 * differ / (frames * 2));
+  }
+  g_mutex_unlock (&report_lock);
+}
+
+/* one file split across all cores, joined again with short linear
+ * crossfades. the segments see the same input around the seams and
+ * come out correlated, so the gains sum to one rather than in power
+ */
+static gboolean
+render_file_segmented (viperfx_interface **cores, guint n_cores,
+    render_job *job, GError **error)
+{
+  viperfx_preset *preset = NULL;
+  render_segment *segs;
+  GstCaps *caps = NULL;
+  GstElement *encode, *src;
+  GstBuffer *buffer;
+  gint16 *in, *out;
+  guint64 warmup, overlap, length;
+  guint n, k;
+  gboolean ok = TRUE;
+
+  if (job->preset != NULL) {
+    preset = viperfx_preset_load (job->preset, error);
+    if (preset == NULL)
+      return FALSE;
+  }
+
+  in = render_decode_all (job->input, &caps, &job->rate, &job->frames, error);
+  if (in == NULL) {
+    viperfx_preset_unref (preset);
+    return FALSE;
+  }
+
+  warmup = (guint64) (render_preroll (preset, job->rate) * job->rate);
+  overlap = (guint64) stitch * job->rate / 1000;
+  // every seam needs room for its crossfade
+  n = n_cores;
+  if (overlap > 0)
+    n = (guint) MIN ((guint64) n, MAX (job->frames / (2 * overlap), 1));
+  length = job->frames / n;
+
+  out = g_new (gint16, job->frames * 2);
+  segs = g_new0 (render_segment, n);
+  for (k = 0; k < n; k++) {
+    render_segment *seg = &segs[k];
+
+    seg->vfx = cores[k];
+    seg->preset = preset;
+    seg->rate = job->rate;
+    seg->in = in;
+    seg->out = out;
+    seg->start = k * length;
+    seg->end = k + 1 < n ? (k + 1) * length : job->frames;
+    seg->overlap = k > 0 ? overlap : 0;
+    seg->first = seg->start - seg->overlap -
+        MIN (warmup, seg->start - seg->overlap);
+    seg->thread = g_thread_new ("segment", render_segment_run, seg);
+  }
+  for (k = 0; k < n; k++) {
+    g_thread_join (segs[k].thread);
+    if (!segs[k].ok && ok) {
+      g_propagate_error (error, segs[k].error);
+      segs[k].error = NULL;
+      ok = FALSE;
+    }
+    g_clear_error (&segs[k].error);
+  }
+
+  for (k = 1; ok && k < n; k++) {
+    render_segment *seg = &segs[k];
+    gint16 *seam = out + (seg->start - overlap) * 2;
+
+    kernels->xfade_s16 (seg->head, seam, overlap, 0.0f, 1.0f,
+        1.0f / overlap, -1.0f / overlap);
+    memcpy (seam, seg->head, overlap * 2 * sizeof(gint16));
+  }
+  for (k = 0; k < n; k++)
+    g_free (segs[k].head);
+  g_free (segs);
+
+  if (ok && verify)
+    render_verify (cores[0], preset, job, in, out);
+  g_free (in);
+  viperfx_preset_unref (preset);
+  if (!ok) {
+    g_free (out);
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+
+  encode = render_encode_pipeline (job->output, caps, error);
+  gst_caps_unref (caps);
+  if (encode == NULL) {
+    g_free (out);
+    return FALSE;
+  }
+  src = gst_bin_get_by_name (GST_BIN (encode), "src");
+  gst_element_set_state (encode, GST_STATE_PLAYING);
+
+  buffer = gst_buffer_new_wrapped (out, job->frames * 2 * sizeof(gint16));
+  GST_BUFFER_PTS (buffer) = 0;
+  GST_BUFFER_DURATION (buffer) =
+      gst_util_uint64_scale_int (job->frames, GST_SECOND, job->rate);
+  if (gst_app_src_push_buffer (GST_APP_SRC (src), buffer) != GST_FLOW_OK) {
+    render_bus_error (encode, 0, error);
+    ok = FALSE;
+  } else {
+    ok = render_encode_finish (encode, src, error);
+  }
+
+  gst_element_set_state (encode, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (encode);
+  return ok;
+}
+
+static void
+render_report (const render_job *job)
+{
+  gdouble audio = job->rate > 0 ? (gdouble) job->frames / job->rate : 0.0;
+
+  g_mutex_lock (&report_lock);
+  if (!job->ok) {
+    g_printerr ("[%u/%u] %s: %s\n", job->index + 1, n_jobs, job->input,
+        job->error != NULL ? job->error : "failed");
+  } else if (!quiet) {
+    g_print ("[%u/%u] %s -> %s: %.1f s in %.2f s, %.1fx realtime\n",
+        job->index + 1, n_jobs, job->input, job->output, audio,
+        job->seconds, job->seconds > 0.0 ? audio / job->seconds : 0.0);
+  }
+  g_mutex_unlock (&report_lock);
+}
+
+static gpointer
+render_worker_run (gpointer data)
+{
+  render_worker *worker = data;
+  render_job *job;
+
+  // a core of its own for as long as there is work
+  worker->vfx = entrypoint ();
+  if (worker->vfx == NULL)
+    return NULL;
+
+  while ((job = g_async_queue_try_pop (queue)) != NULL) {
+    GError *err = NULL;
+    gint64 start = g_get_monotonic_time ();
+
+    job->ok = render_file (worker, job, &err);
+    job->seconds = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+    if (err != NULL) {
+      job->error = g_strdup (err->message);
+      g_error_free (err);
+    }
+    job->done = TRUE;
+    render_report (job);
+  }
+
+  worker->vfx->release (worker->vfx);
+  worker->vfx = NULL;
+  return NULL;
+}
+
+/* --segment, the files in turn with every core on each */
+static void
+render_segmented_run (render_worker *workers, guint n_workers)
+{
+  viperfx_interface **cores = g_new (viperfx_interface *, n_workers);
+  render_job *job;
+  guint i, n_cores = 0;
+
+  for (i = 0; i < n_workers; i++) {
+    workers[i].vfx = entrypoint ();
+    if (workers[i].vfx != NULL)
+      cores[n_cores++] = workers[i].vfx;
+  }
+
+  while (n_cores > 0 && (job = g_async_queue_try_pop (queue)) != NULL) {
+    GError *err = NULL;
+    gint64 start = g_get_monotonic_time ();
+
+    job->ok = render_file_segmented (cores, n_cores, job, &err);
+    job->seconds = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+    if (err != NULL) {
+      job->error = g_strdup (err->message);
+      g_error_free (err);
+    }
+    job->done = TRUE;
+    render_report (job);
+  }
+
+  for (i = 0; i < n_cores; i++)
+    cores[i]->release (cores[i]);
+  for (i = 0; i < n_workers; i++)
+    workers[i].vfx = NULL;
+  g_free (cores);
+}
+
+static gchar *
+render_default_output (const gchar *input, const gchar *output_dir)
+{
+  gchar *base = g_path_get_basename (input);
+  gchar *dir = output_dir != NULL ? g_strdup (output_dir) :
+      g_path_get_dirname (input);
+  gchar *name = g_strconcat (base, ".viperfx.wav", NULL);
+  gchar *path = g_build_filename (dir, name, NULL);
+
+  g_free (base);
+  g_free (dir);
+  g_free (name);
+  return path;
+}
+
+static GPtrArray *
+render_read_manifest (const gchar *manifest, const gchar *default_preset,
+    const gchar *output_dir, GError **error)
+{
+  GPtrArray *jobs;
+  gchar *contents = NULL;
+  gchar **lines;
+  guint i;
+
+  if (strcmp (manifest, "-") == 0) {
+    GIOChannel *in = g_io_channel_unix_new (0);
+    GIOStatus status = g_io_channel_read_to_end (in, &contents, NULL, error);
+
+    g_io_channel_unref (in);
+    if (status != G_IO_STATUS_NORMAL)
+      return NULL;
+  } else if (!g_file_get_contents (manifest, &contents, NULL, error)) {
+    return NULL;
+  }
+
+  jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) render_job_free);
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++) {
+    gchar **fields;
+    render_job *job;
+
+    g_strstrip (lines[i]);
+    if (lines[i][0] == '\0' || lines[i][0] == '#')
+      continue;
+
+    fields = g_strsplit (lines[i], "\t", 3);
+    job = g_new0 (render_job, 1);
+    job->index = jobs->len;
+    job->input = g_strdup (fields[0]);
+    if (fields[1] != NULL && fields[1][0] != '\0' &&
+        strcmp (fields[1], "-") != 0)
+      job->preset = g_strdup (fields[1]);
+    else if (default_preset != NULL)
+      job->preset = g_strdup (default_preset);
+    if (fields[1] != NULL && fields[2] != NULL && fields[2][0] != '\0')
+      job->output = g_strdup (fields[2]);
+    else
+      job->output = render_default_output (job->input, output_dir);
+    g_strfreev (fields);
+    g_ptr_array_add (jobs, job);
+  }
+  g_strfreev (lines);
+  g_free (contents);
+  return jobs;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint n_workers = 0;
+  gboolean segment = FALSE;
+  gchar *output_dir = NULL;
+  gchar *default_preset = NULL;
+  GOptionEntry entries[] = {
+    { "jobs", 'j', 0, G_OPTION_ARG_INT, &n_workers,
+        "Worker threads, one core each (default: one per cpu)", "N" },
+    { "output-dir", 'o', 0, G_OPTION_ARG_FILENAME, &output_dir,
+        "Directory for outputs the manifest doesn't name", "DIR" },
+    { "preset", 'p', 0, G_OPTION_ARG_FILENAME, &default_preset,
+        "Preset for files the manifest gives none", "FILE" },
+    { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet,
+        "Only report failures", NULL },
+    { "segment", 's', 0, G_OPTION_ARG_NONE, &segment,
+        "Split every file across all workers", NULL },
+    { "preroll", 0, 0, G_OPTION_ARG_DOUBLE, &preroll,
+        "Seconds a segment's core runs ahead (default: from the preset)",
+        "SECONDS" },
+    { "stitch", 0, 0, G_OPTION_ARG_INT, &stitch,
+        "Crossfade between segments (default: 50)", "MS" },
+    { "verify", 0, 0, G_OPTION_ARG_NONE, &verify,
+        "Compare segmented files against a single pass", NULL },
+    { NULL }
+  };
+  GOptionContext *ctx;
+  render_worker *workers;
+  GPtrArray *jobs;
+  GError *err = NULL;
+  gdouble audio = 0.0, seconds;
+  gint64 start;
+  guint i, failed = 0;
+
+  ctx = g_option_context_new ("MANIFEST - render files through the viperfx core");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    return 2;
+  }
+  g_option_context_free (ctx);
+  if (argc != 2) {
+    g_printerr ("usage: %s [OPTION...] MANIFEST\n", argv[0]);
+    return 2;
+  }
+
+  jobs = render_read_manifest (argv[1], default_preset, output_dir, &err);
+  if (jobs == NULL) {
+    g_printerr ("%s: %s\n", argv[1], err->message);
+    return 1;
+  }
+  n_jobs = jobs->len;
+  if (n_jobs == 0)
+    return 0;
+
+  entrypoint = viperfx_library_ref ();
+  if (entrypoint == NULL) {
+    g_printerr ("viperfx core unavailable: %s\n", viperfx_library_error ());
+    return 1;
+  }
+  kernels = viperfx_kernels_best ();
+
+  if (n_workers <= 0)
+    n_workers = (gint) g_get_num_processors ();
+  if (!segment)
+    n_workers = MIN ((guint) n_workers, n_jobs);
+  stitch = CLAMP (stitch, 0, 1000);
+
+  queue = g_async_queue_new ();
+  for (i = 0; i < n_jobs; i++)
+    g_async_queue_push (queue, g_ptr_array_index (jobs, i));
+
+  start = g_get_monotonic_time ();
+  workers = g_new0 (render_worker, n_workers);
+  if (segment) {
+    render_segmented_run (workers, n_workers);
+  } else {
+    for (i = 0; i < (guint) n_workers; i++) {
+      gchar *name = g_strdup_printf ("render-%u", i);
+
+      workers[i].thread = g_thread_new (name, render_worker_run, &workers[i]);
+      g_free (name);
+    }
+    for (i = 0; i < (guint) n_workers; i++)
+      g_thread_join (workers[i].thread);
+  }
+  seconds = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  for (i = 0; i < n_jobs; i++) {
+    render_job *job = g_ptr_array_index (jobs, i);
+
+    // left over when no worker could create a core
+    if (!job->done) {
+      job->error = g_strdup ("no core instance to render on");
+      render_report (job);
+    }
+    if (job->ok && job->rate > 0)
+      audio += (gdouble) job->frames / job->rate;
+    else
+      failed++;
+  }
+  if (!quiet) {
+    g_print ("%u files, %u failed, %.1f s of audio in %.2f s on %d workers, "
+        "%.1fx realtime\n", n_jobs, failed, audio, seconds, n_workers,
+        seconds > 0.0 ? audio / seconds : 0.0);
+  }
+
+  g_free (workers);
+  g_async_queue_unref (queue);
+  g_ptr_array_unref (jobs);
+  g_free (output_dir);
+  g_free (default_preset);
+  viperfx_library_unref ();
+  return failed > 0 ? 1 : 0;
+}